@@ -0,0 +1,528 @@
+///
+/// gta3sc-bench
+///
+/// Benchmarks the compiler and decompiler over a synthetic corpus, printing the results as JSON.
+///
+#include <stdinc.h>
+#include "program.hpp"
+#include "cmdline.hpp"
+#include "symtable.hpp"
+#include "cpp/argv.hpp"
+#include "corpus.hpp"
+#include <chrono>
+
+const char* GTA3SC_BENCH_HELP_MESSAGE =
+R"(Usage: gta3sc-bench --config=<name> [options] [gta3sc options]
+Options:
+  --help                   Display this information.
+  -o <file>                Place the JSON results into <file> instead of the
+                           standard output.
+  --missions=<n>           Number of missions in the corpus. Defaults to 16.
+  --statements=<n>         Number of statements in the main script and in each
+                           mission. Defaults to 200.
+  --seed=<n>               Seed of the corpus generator. Defaults to 1.
+  --repeat=<n>             Number of runs of each benchmark. Defaults to 5.
+  --scaling=<n>            Number of points in the scaling curves, each having
+                           twice the missions of the previous one. Defaults to 4.
+  --filter=<text>          Runs only the benchmarks whose name contains <text>.
+  --workdir=<dir>          Where the corpus is written into. Defaults to a
+                           directory in the temporary path.
+
+Any other option is given to the compiler and decompiler as in gta3sc.
+)";
+
+namespace
+{
+
+/// Timings of the runs of a benchmark, in microseconds.
+struct Samples
+{
+    std::vector<uint64_t> times;
+
+    uint64_t best() const
+    {
+        return times.empty()? 0 : *std::min_element(times.begin(), times.end());
+    }
+
+    uint64_t median() const
+    {
+        if(times.empty())
+            return 0;
+        auto sorted = times;
+        std::sort(sorted.begin(), sorted.end());
+        return sorted[sorted.size() / 2];
+    }
+};
+
+/// Runs of a benchmark and the amount of work done by each run, for computing its throughput.
+struct BenchResult
+{
+    std::string name;
+    Samples     samples;
+    size_t      lines = 0;      //< Lines of source processed in each run.
+    size_t      bytes = 0;      //< Bytes of input processed in each run.
+    size_t      items = 0;      //< Benchmark specific items (e.g. commands matched) processed in each run.
+};
+
+class Bench
+{
+public:
+    explicit Bench(const ProgramContext& program, const fs::path& workdir, uint32_t repeat) :
+        program(program), workdir(workdir), repeat(repeat)
+    {}
+
+    /// Whether benchmarks whose name contains `filter` shall run.
+    optional<std::string> filter;
+
+    /// \returns whether a benchmark named `name` shall run.
+    bool enabled(const string_view& name) const
+    {
+        return !filter || name.find(*filter) != string_view::npos;
+    }
+
+    /// \returns a context for a single run, which doesn't log anything.
+    std::unique_ptr<ProgramContext> make_context(Options opt, std::string& messages) const
+    {
+        return std::make_unique<ProgramContext>(this->program, std::move(opt), [&messages](const std::string& msg) {
+            (messages += msg) += '\n';
+        });
+    }
+
+    /// Times `repeat` runs of `fun`.
+    template<typename Functor>
+    Samples measure(Functor fun) const
+    {
+        Samples samples;
+        for(uint32_t i = 0; i < this->repeat; ++i)
+        {
+            auto begin = std::chrono::steady_clock::now();
+            fun();
+            auto elapsed = std::chrono::steady_clock::now() - begin;
+            samples.times.emplace_back(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+        }
+        return samples;
+    }
+
+    /// Compiles `input` into `output`.
+    /// \returns the time taken by the whole compilation and by the phases in `phases`, or nullopt on failure.
+    optional<std::vector<uint64_t>> compile(const fs::path& input, const fs::path& output,
+                                            const std::vector<const char*>& phases) const
+    {
+        return run(false, input, output, phases);
+    }
+
+    /// Decompiles `input` into IR2 at `output`.
+    /// \returns the time taken by the whole decompilation and by the phases in `phases`, or nullopt on failure.
+    optional<std::vector<uint64_t>> decompile(const fs::path& input, const fs::path& output,
+                                              const std::vector<const char*>& phases) const
+    {
+        return run(true, input, output, phases);
+    }
+
+private:
+    optional<std::vector<uint64_t>> run(bool decompile, const fs::path& input, const fs::path& output,
+                                        const std::vector<const char*>& phases) const
+    {
+        auto opt = this->program.opt;
+        opt.emit_ir2 = decompile;
+
+        // The time trace is shared by every context, thus the phases are measured by the difference of its totals.
+        auto& trace = *this->program.time_trace;
+        std::vector<uint64_t> before;
+        for(auto& phase : phases)
+            before.emplace_back(trace.total_time(phase).first);
+
+        std::string messages;
+        auto context = make_context(std::move(opt), messages);
+
+        auto begin = std::chrono::steady_clock::now();
+        bool succeeded = decompile? decompile_file(input, output, *context) : compile_file(input, output, *context);
+        auto elapsed = std::chrono::steady_clock::now() - begin;
+
+        if(!succeeded)
+        {
+            fprintf(stderr, "%sgta3sc-bench: error: %s of '%s' failed\n", messages.c_str(),
+                    decompile? "decompilation" : "compilation", input.generic_u8string().c_str());
+            return nullopt;
+        }
+
+        std::vector<uint64_t> times;
+        times.emplace_back(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+        for(size_t i = 0; i < phases.size(); ++i)
+            times.emplace_back(trace.total_time(phases[i]).first - before[i]);
+        return times;
+    }
+
+public:
+    const ProgramContext& program;
+    const fs::path        workdir;
+    const uint32_t        repeat;
+};
+
+std::string json_string(const string_view& s)
+{
+    std::string result = "\"";
+    for(char c : s)
+    {
+        if(c == '"' || c == '\\')
+            (result += '\\') += c;
+        else if(static_cast<unsigned char>(c) < 0x20)
+            result += fmt::format("\\u{:04x}", unsigned(c));
+        else
+            result += c;
+    }
+    return result += '"';
+}
+
+/// \returns `amount` per second, given it was processed in `time` microseconds.
+double per_second(size_t amount, uint64_t time)
+{
+    return time? double(amount) * 1000000.0 / double(time) : 0.0;
+}
+
+std::string to_json(const BenchResult& result)
+{
+    auto best = result.samples.best();
+    auto json = fmt::format("{{\"name\": {}, \"runs\": {}, \"best_us\": {}, \"median_us\": {}",
+                            json_string(result.name), result.samples.times.size(), best, result.samples.median());
+    if(result.lines)
+        json += fmt::format(", \"lines_per_second\": {:.1f}", per_second(result.lines, best));
+    if(result.bytes)
+        json += fmt::format(", \"bytes_per_second\": {:.1f}", per_second(result.bytes, best));
+    if(result.items)
+        json += fmt::format(", \"items_per_second\": {:.1f}", per_second(result.items, best));
+    return json += "}";
+}
+
+/// Benchmarks the steps of the compiler which can be called on their own.
+bool run_micro_benchmarks(const Bench& bench, const Corpus& corpus, const fs::path& main_path,
+                          std::vector<BenchResult>& results)
+{
+    std::vector<const CorpusScript*> scripts = { &corpus.main };
+    for(auto& mission : corpus.missions)
+        scripts.emplace_back(&mission);
+
+    std::string messages;
+    auto context = bench.make_context(bench.program.opt, messages);
+    auto& program = *context;
+
+    if(bench.enabled("TokenStream::tokenize"))
+    {
+        BenchResult result { "TokenStream::tokenize" };
+        result.lines = corpus.lines();
+        result.bytes = corpus.bytes();
+        result.samples = bench.measure([&] {
+            for(auto& script : scripts)
+                TokenStream::tokenize(program, script->text, script->filename.c_str());
+        });
+        results.emplace_back(std::move(result));
+    }
+
+    if(bench.enabled("SyntaxTree::compile"))
+    {
+        std::vector<shared_ptr<TokenStream>> tstreams;
+        for(auto& script : scripts)
+            tstreams.emplace_back(TokenStream::tokenize(program, script->text, script->filename.c_str()));
+
+        BenchResult result { "SyntaxTree::compile" };
+        result.lines = corpus.lines();
+        result.bytes = corpus.bytes();
+        result.samples = bench.measure([&] {
+            for(auto& tstream : tstreams)
+            {
+                if(tstream) SyntaxTree::compile(program, *tstream);
+            }
+        });
+        results.emplace_back(std::move(result));
+    }
+
+    if(bench.enabled("Commands::match"))
+    {
+        // Only the main script is matched, since it doesn't need any scope to be set up.
+        auto script = Script::create(main_path, ScriptType::Main, program);
+        if(!script)
+        {
+            fprintf(stderr, "%sgta3sc-bench: error: failed to read '%s'\n", messages.c_str(), main_path.generic_u8string().c_str());
+            return false;
+        }
+
+        auto symbols = SymTable::from_script(*script, program);
+
+        std::vector<const SyntaxTree*> command_nodes;
+        script->tree->depth_first([&](const SyntaxTree& node) {
+            if(node.type() == NodeType::Command)
+                command_nodes.emplace_back(&node);
+            return true;
+        });
+
+        size_t num_matched = 0;
+        BenchResult result { "Commands::match" };
+        result.items = command_nodes.size();
+        result.samples = bench.measure([&] {
+            num_matched = 0;
+            for(auto& node : command_nodes)
+                num_matched += bool(program.commands.match(*node, symbols, nullptr, program.opt));
+        });
+        results.emplace_back(std::move(result));
+    }
+
+    return true;
+}
+
+/// Benchmarks the whole compilation and decompilation of the corpus, and the phases which can only run as part of them.
+bool run_pipeline_benchmarks(const Bench& bench, const Corpus& corpus, const fs::path& main_path,
+                             std::vector<BenchResult>& results)
+{
+    auto scm_path = fs::path(main_path).replace_extension(".scm");
+    auto ir2_path = fs::path(main_path).replace_extension(".ir2");
+
+    const std::vector<const char*> compile_phases = { "CompilerContext::compile", "CodeGenerator::generate" };
+    const std::vector<const char*> decompile_phases = { "Disassembler::run_analyzer", "Disassembler::disassembly", "write output" };
+
+    // Phase results are named after the classes doing the work.
+    const std::vector<const char*> compile_names = { "compile", "CompilerContext::compile", "CodeGenerator::generate" };
+    const std::vector<const char*> decompile_names = { "decompile", "Disassembler::run_analyzer", "Disassembler::disassembly", "DecompilerIR2" };
+
+    // The decompiler benchmarks need the compiled corpus, so the compilation always runs at least once.
+    if(!bench.compile(main_path, scm_path, compile_phases))
+        return false;
+
+    std::error_code ec;
+    auto scm_size = size_t(fs::file_size(scm_path, ec));
+
+    auto run = [&](bool decompile, const std::vector<const char*>& phases, const std::vector<const char*>& names) {
+        if(std::none_of(names.begin(), names.end(), [&](const char* name) { return bench.enabled(name); }))
+            return true;
+
+        std::vector<BenchResult> phase_results(names.size());
+        for(uint32_t i = 0; i < bench.repeat; ++i)
+        {
+            auto times = decompile? bench.decompile(scm_path, ir2_path, phases) : bench.compile(main_path, scm_path, phases);
+            if(!times)
+                return false;
+            for(size_t k = 0; k < names.size(); ++k)
+                phase_results[k].samples.times.emplace_back((*times)[k]);
+        }
+
+        for(size_t k = 0; k < names.size(); ++k)
+        {
+            if(!bench.enabled(names[k]))
+                continue;
+
+            auto& result = phase_results[k];
+            result.name = names[k];
+            if(decompile)
+            {
+                result.bytes = scm_size;
+            }
+            else
+            {
+                result.lines = corpus.lines();
+                result.bytes = corpus.bytes();
+            }
+            results.emplace_back(std::move(result));
+        }
+        return true;
+    };
+
+    return run(false, compile_phases, compile_names) && run(true, decompile_phases, decompile_names);
+}
+
+/// Compiles and decompiles corpora of increasing size.
+bool run_scaling(const Bench& bench, const CorpusGenerator& generator, uint32_t seed, size_t num_missions,
+                 size_t num_statements, uint32_t num_points, std::vector<std::string>& points)
+{
+    for(uint32_t i = 0; i < num_points; ++i)
+    {
+        auto missions = num_missions << i;
+        auto corpus = generator.generate(seed, missions, num_statements);
+        auto dir = bench.workdir / fmt::format("scaling{}", i);
+
+        auto main_path = corpus.write(dir);
+        if(!main_path)
+        {
+            fprintf(stderr, "gta3sc-bench: error: failed to write the corpus into '%s'\n", dir.generic_u8string().c_str());
+            return false;
+        }
+
+        auto scm_path = fs::path(*main_path).replace_extension(".scm");
+        auto ir2_path = fs::path(*main_path).replace_extension(".ir2");
+
+        Samples compile, decompile;
+        for(uint32_t r = 0; r < bench.repeat; ++r)
+        {
+            auto compile_times = bench.compile(*main_path, scm_path, {});
+            auto decompile_times = compile_times? bench.decompile(scm_path, ir2_path, {}) : nullopt;
+            if(!decompile_times)
+                return false;
+            compile.times.emplace_back(compile_times->front());
+            decompile.times.emplace_back(decompile_times->front());
+        }
+
+        std::error_code ec;
+        auto scm_size = size_t(fs::file_size(scm_path, ec));
+
+        points.emplace_back(fmt::format("{{\"missions\": {}, \"lines\": {}, \"bytes\": {}, \"scm_bytes\": {}, "
+                                        "\"compile_us\": {}, \"compile_lines_per_second\": {:.1f}, "
+                                        "\"decompile_us\": {}, \"decompile_bytes_per_second\": {:.1f}}}",
+                                        missions, corpus.lines(), corpus.bytes(), scm_size,
+                                        compile.best(), per_second(corpus.lines(), compile.best()),
+                                        decompile.best(), per_second(scm_size, decompile.best())));
+    }
+    return true;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    fs::path output, workdir;
+    fs::path compiler_input, compiler_output;
+    DataInfo data;
+    ConfigInfo conf;
+    Options options;
+
+    uint32_t num_missions = 16, num_statements = 200, seed = 1, repeat = 5, scaling = 4;
+    optional<std::string> filter;
+    bool help = false;
+
+    // Options of the benchmark are taken out, the remaining ones are given to the compiler.
+    std::vector<char*> compiler_args;
+    try
+    {
+        int32_t temp_i32;
+        auto optuint = [&](char**& argv, const char* name, uint32_t& value) {
+            if(!optint(argv, name, &temp_i32))
+                return false;
+            if(temp_i32 < 0)
+                throw invalid_opt(fmt::format("argument to '{}' must not be negative.", name));
+            value = uint32_t(temp_i32);
+            return true;
+        };
+
+        for(++argv; *argv; )
+        {
+            if(optget(argv, nullptr, "--help", 0))
+                help = true;
+            else if(const char* path = optget(argv, "-o", nullptr, 1))
+                output = path;
+            else if(const char* path = optget(argv, nullptr, "--workdir", 1))
+                workdir = path;
+            else if(const char* text = optget(argv, nullptr, "--filter", 1))
+                filter = std::string(text);
+            else if(optuint(argv, "--missions", num_missions)) {}
+            else if(optuint(argv, "--statements", num_statements)) {}
+            else if(optuint(argv, "--seed", seed)) {}
+            else if(optuint(argv, "--repeat", repeat)) {}
+            else if(optuint(argv, "--scaling", scaling)) {}
+            else
+                compiler_args.emplace_back(*argv++);
+        }
+    }
+    catch(const invalid_opt& e)
+    {
+        fprintf(stderr, "gta3sc-bench: error: %s\n", e.what());
+        return EXIT_FAILURE;
+    }
+
+    if(help)
+    {
+        fprintf(stdout, "%s", GTA3SC_BENCH_HELP_MESSAGE);
+        return EXIT_SUCCESS;
+    }
+
+    compiler_args.emplace_back(nullptr);
+    char** compiler_argv = compiler_args.data();
+    if(!parse_args(compiler_argv, compiler_input, compiler_output, data, conf, options) || !check_options(options))
+        return EXIT_FAILURE;
+
+    if(!compiler_input.empty())
+    {
+        fprintf(stderr, "gta3sc-bench: error: no input file is taken, the corpus is generated\n");
+        return EXIT_FAILURE;
+    }
+
+    if(conf.config_name.empty())
+    {
+        fprintf(stderr, "gta3sc-bench: error: no game config specified [--config=<name>]\n");
+        return EXIT_FAILURE;
+    }
+
+    if(repeat == 0)
+        repeat = 1;
+
+    if(workdir.empty())
+        workdir = fs::temp_directory_path() / "gta3sc-bench";
+
+    optional<ProgramContext> program;
+    try
+    {
+        ModelTable default_models, level_models;
+        if(!data.datadir.empty())
+            std::tie(default_models, level_models) = load_models(data.datadir, data.levelfile, data.models_cache);
+
+        Commands commands = load_commands(conf, data, options, default_models);
+
+        // The phases are timed by the means of the time trace, which is created for the time report.
+        options.time_report = true;
+        program.emplace(std::move(options), std::move(commands), nullptr);
+        program->setup_models(std::move(default_models), std::move(level_models));
+    }
+    catch(const ConfigError& e)
+    {
+        fprintf(stderr, "gta3sc-bench: error: %s\n", e.what());
+        return EXIT_FAILURE;
+    }
+
+    CorpusGenerator generator(program->commands);
+    auto corpus = generator.generate(seed, num_missions, num_statements);
+
+    auto main_path = corpus.write(workdir / "corpus");
+    if(!main_path)
+    {
+        fprintf(stderr, "gta3sc-bench: error: failed to write the corpus into '%s'\n", workdir.generic_u8string().c_str());
+        return EXIT_FAILURE;
+    }
+
+    Bench bench(*program, workdir, repeat);
+    bench.filter = filter;
+
+    std::vector<BenchResult> results;
+    std::vector<std::string> scaling_points;
+
+    if(!run_micro_benchmarks(bench, corpus, *main_path, results)
+    || !run_pipeline_benchmarks(bench, corpus, *main_path, results))
+        return EXIT_FAILURE;
+
+    if(bench.enabled("scaling") && !run_scaling(bench, generator, seed, num_missions, num_statements, scaling, scaling_points))
+        return EXIT_FAILURE;
+
+    FILE* stream = output.empty()? stdout : u8fopen(output, "wb");
+    if(!stream)
+    {
+        fprintf(stderr, "gta3sc-bench: error: could not open file '%s' for writing\n", output.generic_u8string().c_str());
+        return EXIT_FAILURE;
+    }
+
+    auto guard = make_scope_guard([&] {
+        if(stream != stdout) fclose(stream);
+    });
+
+    text_sink sink(stream, false);
+    sink.line("{");
+    sink.line(fmt::format("  \"config\": {},", json_string(conf.config_name)));
+    sink.line(fmt::format("  \"seed\": {},", seed));
+    sink.line(fmt::format("  \"corpus\": {{\"missions\": {}, \"statements\": {}, \"commands\": {}, \"lines\": {}, \"bytes\": {}}},",
+                          num_missions, num_statements, generator.num_commands(), corpus.lines(), corpus.bytes()));
+    sink.line("  \"benchmarks\": [");
+    for(size_t i = 0; i < results.size(); ++i)
+        sink.line(fmt::format("    {}{}", to_json(results[i]), i + 1 != results.size()? "," : ""));
+    sink.line("  ],");
+    sink.line("  \"scaling\": [");
+    for(size_t i = 0; i < scaling_points.size(); ++i)
+        sink.line(fmt::format("    {}{}", scaling_points[i], i + 1 != scaling_points.size()? "," : ""));
+    sink.line("  ]");
+    sink.line("}");
+
+    return sink.flush()? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,287 @@
+///
+/// Synthetic Corpus
+///
+/// Generates a multifile script made of a main script and its missions, whose statements are calls to the commands
+/// of a game configuration, expressions and control flow blocks. The same seed always generates the same corpus,
+/// no matter the platform, so that benchmark results can be compared over time.
+///
+#pragma once
+#include <stdinc.h>
+#include <random>
+#include "commands.hpp"
+
+/// A generated script file.
+struct CorpusScript
+{
+    std::string filename;
+    std::string text;
+    size_t      lines = 0;
+};
+
+/// A generated multifile script.
+struct Corpus
+{
+    CorpusScript              main;
+    std::vector<CorpusScript> missions;
+
+    /// \returns the number of lines in every script.
+    size_t lines() const
+    {
+        size_t lines = main.lines;
+        for(auto& mission : missions) lines += mission.lines;
+        return lines;
+    }
+
+    /// \returns the number of bytes in every script.
+    size_t bytes() const
+    {
+        size_t bytes = main.text.size();
+        for(auto& mission : missions) bytes += mission.text.size();
+        return bytes;
+    }
+
+    /// Writes the main script into `dir`, and the missions into its subdirectory.
+    /// \returns the path to the main script, or nullopt on failure.
+    optional<fs::path> write(const fs::path& dir) const
+    {
+        auto main_path = dir / main.filename;
+        auto subdir = fs::path(main_path).replace_extension();
+
+        std::error_code ec;
+        fs::create_directories(subdir, ec);
+
+        if(!write_file(main_path, main.text.data(), main.text.size()))
+            return nullopt;
+
+        for(auto& mission : missions)
+        {
+            if(!write_file(subdir / mission.filename, mission.text.data(), mission.text.size()))
+                return nullopt;
+        }
+
+        return main_path;
+    }
+};
+
+class CorpusGenerator
+{
+public:
+    /// Variables declared by every script.
+    static constexpr size_t num_vars = 8;
+
+    /// Picks the commands which can be called with the variables and constants the generator knows about.
+    /// Commands with special meaning to the compiler (e.g. `SCRIPT_NAME`, `RETURN`) or to the script structure
+    /// are never picked, neither are commands taking labels, strings or entities.
+    explicit CorpusGenerator(const Commands& commands)
+    {
+        static const char* excluded_commands[] = {
+            "ANDOR", "RETURN", "TERMINATE_THIS_SCRIPT", "TERMINATE_THIS_CUSTOM_SCRIPT", "MISSION_START", "MISSION_END",
+            "SCRIPT_NAME", "SET_PROGRESS_TOTAL", "SET_TOTAL_NUMBER_OF_MISSIONS", "SET_COLLECTABLE1_TOTAL",
+            "REGISTER_MISSION_PASSED", "REGISTER_ODDJOB_MISSION_PASSED", "CREATE_COLLECTABLE1", "PLAYER_MADE_PROGRESS",
+            "SET_MISSION_RESPECT_TOTAL", "AWARD_PLAYER_MISSION_RESPECT", "SAVE_STRING_TO_DEBUG_FILE",
+            "SKIP_CUTSCENE_START", "SKIP_CUTSCENE_END", "CLEO_RETURN",
+        };
+
+        for(auto& command : commands.get_commands())
+        {
+            if(!command.supported || command.internal || command.extension || !command.id || command.has_optional())
+                continue;
+
+            auto is_excluded = std::any_of(std::begin(excluded_commands), std::end(excluded_commands), [&](const char* name) {
+                return iequal_to()(command.name, name);
+            });
+
+            auto can_generate = std::all_of(command.args.begin(), command.args.end(), [](const Command::Arg& arg) {
+                if(arg.entity_type != 0)
+                    return false;
+                if(arg.type == ArgType::Integer || arg.type == ArgType::Float)
+                    return (arg.allow_constant && !arg.is_output) || arg.allow_global_var;
+                if(arg.type == ArgType::TextLabel)
+                    return arg.allow_constant && !arg.is_output;
+                return false;
+            });
+
+            if(!is_excluded && can_generate)
+                this->pool.emplace_back(&command);
+        }
+    }
+
+    /// \returns the number of commands which may be called by the generated scripts.
+    size_t num_commands() const { return this->pool.size(); }
+
+    /// Generates a main script with `num_statements` statements, followed by `num_missions` missions,
+    /// each with `num_statements` statements.
+    Corpus generate(uint32_t seed, size_t num_missions, size_t num_statements) const
+    {
+        State state(seed);
+        Corpus corpus;
+
+        corpus.main.filename = "bench.sc";
+        state.line(fmt::format("// Generated by gta3sc-bench (seed {}, {} missions, {} statements)", seed,
+                               num_missions, num_statements));
+        state.line(declaration("VAR_INT", "bench_i"));
+        state.line(declaration("VAR_FLOAT", "bench_f"));
+        for(size_t i = 0; i < num_statements; ++i)
+            this->statement(state, false, 0);
+        for(size_t i = 0; i < num_missions; ++i)
+            state.line(fmt::format("LOAD_AND_LAUNCH_MISSION bench_mission{}.sc", i));
+        state.line("TERMINATE_THIS_SCRIPT");
+        state.take(corpus.main);
+
+        for(size_t m = 0; m < num_missions; ++m)
+        {
+            CorpusScript mission;
+            mission.filename = fmt::format("bench_mission{}.sc", m);
+            state.line("MISSION_START");
+            state.line("{");
+            state.line(declaration("LVAR_INT", "lvar_i"));
+            state.line(declaration("LVAR_FLOAT", "lvar_f"));
+            for(size_t i = 0; i < num_statements; ++i)
+                this->statement(state, true, 0);
+            state.line("}");
+            state.line("MISSION_END");
+            state.take(mission);
+            corpus.missions.emplace_back(std::move(mission));
+        }
+
+        return corpus;
+    }
+
+private:
+    struct State
+    {
+        std::mt19937 rng;   //< Its output (unlike of the standard distributions) is the same on every platform.
+        std::string  text;
+        size_t       lines = 0;
+
+        explicit State(uint32_t seed) : rng(seed) {}
+
+        /// \returns a random integer in the range [0, bound).
+        uint32_t next(uint32_t bound) { return uint32_t(rng() % bound); }
+
+        void line(const string_view& s)
+        {
+            text.append(s.data(), s.size());
+            text.push_back('\n');
+            ++lines;
+        }
+
+        void take(CorpusScript& script)
+        {
+            script.text = std::move(text);
+            script.lines = lines;
+            text.clear();
+            lines = 0;
+        }
+    };
+
+    static std::string declaration(const char* command, const char* prefix)
+    {
+        std::string s = command;
+        for(size_t i = 0; i < num_vars; ++i)
+            s += fmt::format(" {}{}", prefix, i);
+        return s;
+    }
+
+    static std::string var(State& state, bool local, char type)
+    {
+        return fmt::format("{}{}{}", local? "lvar_" : "bench_", type, state.next(num_vars));
+    }
+
+    /// Generates a statement, which may be a block containing other statements.
+    void statement(State& state, bool in_mission, size_t depth) const
+    {
+        auto kind = (depth < 2? state.next(20) : 0);
+        auto local = [&] { return in_mission && state.next(2) == 0; };
+
+        if(kind < 13 && !this->pool.empty())
+        {
+            state.line(this->command(state, in_mission));
+        }
+        else if(kind < 16)
+        {
+            // Expressions are compiled into the SET/ADD/SUB/MULT commands.
+            static const char* operators[] = { "=", "+=", "-=", "*=" };
+            auto type = (state.next(2)? 'i' : 'f');
+            auto lhs = var(state, local(), type);
+            auto rhs = (state.next(2)? var(state, local(), type) : constant(state, type));
+            state.line(fmt::format("{} {} {}", lhs, operators[state.next(4)], rhs));
+        }
+        else if(kind < 18)
+        {
+            state.line(fmt::format("IF {}", condition(state, local())));
+            block(state, in_mission, depth);
+            if(state.next(2))
+            {
+                state.line("ELSE");
+                block(state, in_mission, depth);
+            }
+            state.line("ENDIF");
+        }
+        else
+        {
+            auto counter = var(state, local(), 'i');
+            state.line(fmt::format("{} = 0", counter));
+            state.line(fmt::format("WHILE {} < {}", counter, 1 + state.next(100)));
+            block(state, in_mission, depth);
+            state.line(fmt::format("{} += 1", counter));
+            state.line("ENDWHILE");
+        }
+    }
+
+    void block(State& state, bool in_mission, size_t depth) const
+    {
+        for(auto n = 1 + state.next(3); n != 0; --n)
+            this->statement(state, in_mission, depth + 1);
+    }
+
+    static std::string condition(State& state, bool local)
+    {
+        static const char* operators[] = { ">", ">=", "<", "<=", "=" };
+        // The order of evaluation of function arguments is unspecified, so every random value is taken beforehand.
+        auto type = (state.next(2)? 'i' : 'f');
+        auto lhs = var(state, local, type);
+        auto op = operators[state.next(5)];
+        return fmt::format("{} {} {}", lhs, op, constant(state, type));
+    }
+
+    static std::string constant(State& state, char type)
+    {
+        if(type == 'i')
+            return std::to_string(int32_t(state.next(2000)) - 1000);
+        auto integral = int32_t(state.next(2000)) - 1000;
+        return fmt::format("{}.{}", integral, state.next(10));
+    }
+
+    std::string command(State& state, bool in_mission) const
+    {
+        auto& command = *this->pool[state.next(uint32_t(this->pool.size()))];
+
+        std::string s = command.name;
+        for(auto& arg : command.args)
+        {
+            auto type = (arg.type == ArgType::Float? 'f' : 'i');
+            auto use_var = arg.is_output || !arg.allow_constant || (arg.allow_global_var && state.next(4) == 0);
+
+            s.push_back(' ');
+
+            if(arg.type == ArgType::TextLabel)
+            {
+                static const char charset[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+                s += "BN";
+                for(size_t i = 0; i < 5; ++i)
+                    s.push_back(charset[state.next(sizeof(charset) - 1)]);
+            }
+            else if(!use_var)
+                s += constant(state, type);
+            else if(in_mission && arg.allow_local_var && (!arg.allow_global_var || state.next(2)))
+                s += var(state, true, type);
+            else
+                s += var(state, false, type);
+        }
+        return s;
+    }
+
+private:
+    std::vector<const Command*> pool;
+};
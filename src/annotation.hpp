@@ -45,8 +45,9 @@ struct RepeatAnnotation
 
 struct SwitchAnnotation
 {
-    size_t num_cases;
-    bool   has_default;
+    size_t         num_cases;
+    bool           has_default;
+    const Command* is_var_gt_int; // `nullptr` unless the SWITCH may be lowered into a decision tree.
 };
 
 struct SwitchCaseAnnotation
@@ -0,0 +1,311 @@
+///
+/// Binary IR (BIR)
+///
+/// A versioned binary serialization of the IR of a whole SCM, as seen by the disassembler. It's made of tables of
+/// fixed-size records, which are laid out to be memory-mapped and read in place without any parsing.
+///
+/// The file starts with a `BirHeader`, which points to the tables. Every table is 4 bytes aligned and every
+/// value is in the byte order of the host which wrote the file, so that it can be read in place. Files written by
+/// a host of the other byte order are rejected by `BirReader`. Strings are stored in a string pool, without null
+/// terminators.
+///
+/// This header has no dependency on the rest of the program, so that it can be used by external tools.
+///
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/// Version of the format. Bumped whenever the layout of any record changes.
+/// It must not read the same in both byte orders, so that files of the other byte order fail the version check.
+static constexpr uint32_t bir_version = 1;
+
+/// Location of a table in the file.
+struct BirTable
+{
+    uint32_t offset;        //< File offset of the first record.
+    uint32_t count;         //< Number of records (or bytes, for the string pool).
+};
+
+/// Location of a string in the string pool.
+struct BirString
+{
+    uint32_t offset;
+    uint32_t size;
+};
+
+struct BirHeader
+{
+    char     magic[4];      //< Always "GBIR".
+    uint32_t version;       //< Always `bir_version`.
+    BirTable blocks;        //< Table of `BirBlock`.
+    BirTable instructions;  //< Table of `BirInstruction`, grouped by block.
+    BirTable args;          //< Table of `BirArg`, grouped by instruction.
+    BirTable labels;        //< Table of `BirLabel`, grouped by block.
+    BirTable models;        //< Table of `BirString`, the models of the SCM header.
+    BirTable streams;       //< Table of `BirString`, the streamed scripts of the SCM header.
+    BirTable strings;       //< String pool.
+};
+
+enum class BirBlockKind : uint8_t
+{
+    Main,
+    Mission,
+    Stream,
+};
+
+/// A code segment, such as the main segment or a mission.
+struct BirBlock
+{
+    uint8_t  kind;              //< A `BirBlockKind`.
+    uint8_t  reserved[3];
+    uint32_t id;                //< Mission or streamed script id, zero for the main segment.
+    uint32_t size;              //< Size of the segment.
+    uint32_t first_instruction;
+    uint32_t num_instructions;
+    uint32_t first_label;
+    uint32_t num_labels;
+};
+
+enum class BirInstructionKind : uint8_t
+{
+    Command,
+    Hex,        //< Data which could not be disassembled.
+};
+
+struct BirInstruction
+{
+    uint32_t offset;        //< Local offset of the instruction.
+    uint16_t opcode;        //< Command id, without the not flag.
+    uint8_t  kind;          //< A `BirInstructionKind`.
+    uint8_t  not_flag;
+    uint32_t first;         //< First argument, or the string pool offset of the hex data.
+    uint32_t count;         //< Number of arguments, or the size of the hex data.
+};
+
+enum class BirArgType : uint8_t
+{
+    EOAL,
+    Int8,
+    Int16,
+    Int32,
+    Float,
+    Var,
+    VarArray,
+    String,
+};
+
+enum class BirVarType : uint8_t
+{
+    Int,            //< Also used for floating point variables, which cannot be told apart.
+    Float,
+    TextLabel,
+    TextLabel16,
+};
+
+enum class BirElemType : uint8_t
+{
+    None,
+    Int,
+    Float,
+    TextLabel,
+    TextLabel16,
+};
+
+enum class BirStringType : uint8_t
+{
+    TextLabel8,
+    TextLabel16,
+    String128,
+    StringVar,
+};
+
+struct BirArg
+{
+    uint8_t  type;          //< A `BirArgType`.
+    uint8_t  subtype;       //< A `BirVarType` for variables and arrays, or a `BirStringType` for strings.
+    uint8_t  elem_type;     //< A `BirElemType` for arrays.
+    uint8_t  array_size;    //< Size of arrays.
+    uint8_t  global;        //< Whether the variable (or array) is global.
+    uint8_t  index_global;  //< Whether the index variable of arrays is global.
+    uint8_t  reserved[2];
+    uint32_t value;         //< Integer value, float bits, variable offset, or string pool offset.
+    uint32_t aux;           //< Index variable offset for arrays, or string size.
+};
+
+/// A label definition.
+struct BirLabel
+{
+    uint32_t offset;        //< Local offset of the label.
+};
+
+static_assert(sizeof(BirHeader) == 64 && sizeof(BirBlock) == 28 && sizeof(BirInstruction) == 16
+           && sizeof(BirArg) == 16 && sizeof(BirLabel) == 4 && sizeof(BirString) == 8,
+              "BIR records must have no padding.");
+
+/// A view over a contiguous range of records.
+template<typename T>
+struct BirSpan
+{
+    const T* ptr   = nullptr;
+    size_t   count = 0;
+
+    const T* begin() const { return ptr; }
+    const T* end() const { return ptr + count; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    const T& operator[](size_t i) const { return ptr[i]; }
+};
+
+/// Reads a BIR file in place.
+///
+/// The whole file is validated on construction, thus the accessors never go out of bounds. The file must be
+/// 4 bytes aligned in memory (as any memory-mapped file is) and must outlive the reader.
+class BirReader
+{
+public:
+    explicit BirReader(const void* bytes, size_t size) :
+        bytes(static_cast<const uint8_t*>(bytes)), size(size)
+    {
+        this->is_valid = this->validate();
+    }
+
+    /// \returns whether the file is a valid BIR file of this version.
+    bool valid() const { return this->is_valid; }
+
+    const BirHeader& header() const { return *reinterpret_cast<const BirHeader*>(bytes); }
+
+    BirSpan<BirBlock> blocks() const        { return table<BirBlock>(header().blocks); }
+    BirSpan<BirString> models() const       { return table<BirString>(header().models); }
+    BirSpan<BirString> streams() const      { return table<BirString>(header().streams); }
+
+    BirSpan<BirInstruction> instructions(const BirBlock& block) const
+    {
+        return slice(table<BirInstruction>(header().instructions), block.first_instruction, block.num_instructions);
+    }
+
+    BirSpan<BirLabel> labels(const BirBlock& block) const
+    {
+        return slice(table<BirLabel>(header().labels), block.first_label, block.num_labels);
+    }
+
+    /// \returns the arguments of a command instruction.
+    BirSpan<BirArg> args(const BirInstruction& instruction) const
+    {
+        if(instruction.kind != uint8_t(BirInstructionKind::Command))
+            return BirSpan<BirArg>();
+        return slice(table<BirArg>(header().args), instruction.first, instruction.count);
+    }
+
+    /// \returns the data of a hex instruction.
+    BirSpan<char> hex(const BirInstruction& instruction) const
+    {
+        if(instruction.kind != uint8_t(BirInstructionKind::Hex))
+            return BirSpan<char>();
+        return string(instruction.first, instruction.count);
+    }
+
+    /// \returns the characters of a string argument.
+    BirSpan<char> string(const BirArg& arg) const
+    {
+        if(arg.type != uint8_t(BirArgType::String))
+            return BirSpan<char>();
+        return string(arg.value, arg.aux);
+    }
+
+    BirSpan<char> string(const BirString& str) const
+    {
+        return string(str.offset, str.size);
+    }
+
+private:
+    template<typename T>
+    BirSpan<T> table(const BirTable& table) const
+    {
+        return BirSpan<T> { reinterpret_cast<const T*>(bytes + table.offset), table.count };
+    }
+
+    template<typename T>
+    static BirSpan<T> slice(const BirSpan<T>& span, size_t first, size_t count)
+    {
+        return BirSpan<T> { span.ptr + first, count };
+    }
+
+    BirSpan<char> string(size_t offset, size_t count) const
+    {
+        return BirSpan<char> { reinterpret_cast<const char*>(bytes + header().strings.offset + offset), count };
+    }
+
+    bool validate() const
+    {
+        if(size < sizeof(BirHeader) || reinterpret_cast<uintptr_t>(bytes) % 4 != 0)
+            return false;
+
+        auto& hdr = header();
+        if(std::memcmp(hdr.magic, "GBIR", 4) != 0 || hdr.version != bir_version)
+            return false;
+
+        auto check_table = [&](const BirTable& table, size_t record_size) {
+            return table.offset % 4 == 0 && table.offset <= size
+                && table.count <= (size - table.offset) / record_size;
+        };
+
+        if(!check_table(hdr.blocks, sizeof(BirBlock)) || !check_table(hdr.instructions, sizeof(BirInstruction))
+        || !check_table(hdr.args, sizeof(BirArg)) || !check_table(hdr.labels, sizeof(BirLabel))
+        || !check_table(hdr.models, sizeof(BirString)) || !check_table(hdr.streams, sizeof(BirString))
+        || !check_table(hdr.strings, 1))
+            return false;
+
+        auto in_range = [](size_t first, size_t count, size_t total) {
+            return first <= total && count <= total - first;
+        };
+
+        auto check_string = [&](const BirString& str) {
+            return in_range(str.offset, str.size, hdr.strings.count);
+        };
+
+        for(auto& str : models()) if(!check_string(str)) return false;
+        for(auto& str : streams()) if(!check_string(str)) return false;
+
+        for(auto& block : blocks())
+        {
+            if(block.kind > uint8_t(BirBlockKind::Stream)
+            || !in_range(block.first_instruction, block.num_instructions, hdr.instructions.count)
+            || !in_range(block.first_label, block.num_labels, hdr.labels.count))
+                return false;
+        }
+
+        for(auto& instruction : table<BirInstruction>(hdr.instructions))
+        {
+            if(instruction.kind == uint8_t(BirInstructionKind::Command))
+            {
+                if(!in_range(instruction.first, instruction.count, hdr.args.count))
+                    return false;
+            }
+            else if(instruction.kind == uint8_t(BirInstructionKind::Hex))
+            {
+                if(!in_range(instruction.first, instruction.count, hdr.strings.count))
+                    return false;
+            }
+            else
+            {
+                return false;
+            }
+        }
+
+        for(auto& arg : table<BirArg>(hdr.args))
+        {
+            if(arg.type > uint8_t(BirArgType::String))
+                return false;
+            if(arg.type == uint8_t(BirArgType::String) && !in_range(arg.value, arg.aux, hdr.strings.count))
+                return false;
+        }
+
+        return true;
+    }
+
+private:
+    const uint8_t* bytes;
+    size_t         size;
+    bool           is_valid;
+};
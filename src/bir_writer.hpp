@@ -0,0 +1,289 @@
+///
+/// BIR Writer
+///
+/// This transforms data given by the disassembler (vector of pseudo-instructions) into BIR,
+/// a binary IR which can be read in place by the means of `BirReader`.
+///
+#pragma once
+#include <stdinc.h>
+#include "disassembler.hpp"
+#include "bir.hpp"
+
+class BirWriter
+{
+public:
+    void add_model(const string_view& name)
+    {
+        this->models.emplace_back(this->add_string(name));
+    }
+
+    void add_stream(const string_view& name)
+    {
+        this->streams.emplace_back(this->add_string(name));
+    }
+
+    /// Adds a code segment of `size` bytes, whose content was disassembled into `data`.
+    void add_block(BirBlockKind kind, size_t id, size_t size, const std::vector<DecompiledData>& data)
+    {
+        BirBlock block {};
+        block.kind = uint8_t(kind);
+        block.id = uint32_t(id);
+        block.size = uint32_t(size);
+        block.first_instruction = uint32_t(this->instructions.size());
+        block.first_label = uint32_t(this->labels.size());
+
+        for(auto& d : data)
+        {
+            if(is<DecompiledLabelDef>(d.data))
+            {
+                this->labels.push_back(BirLabel { uint32_t(d.offset) });
+            }
+            else if(is<DecompiledCommand>(d.data))
+            {
+                auto& ccmd = get<DecompiledCommand>(d.data);
+
+                BirInstruction instruction {};
+                instruction.offset = uint32_t(d.offset);
+                instruction.opcode = ccmd.command.id.value();
+                instruction.kind = uint8_t(BirInstructionKind::Command);
+                instruction.not_flag = ccmd.not_flag;
+                instruction.first = uint32_t(this->args.size());
+                instruction.count = uint32_t(ccmd.args.size());
+                this->instructions.push_back(instruction);
+
+                for(auto& arg : ccmd.args)
+                    this->args.push_back(this->make_arg(arg));
+            }
+            else if(is<DecompiledHex>(d.data))
+            {
+                auto& hex = get<DecompiledHex>(d.data).data;
+                auto str = this->add_string(string_view(reinterpret_cast<const char*>(hex.data()), hex.size()));
+
+                BirInstruction instruction {};
+                instruction.offset = uint32_t(d.offset);
+                instruction.kind = uint8_t(BirInstructionKind::Hex);
+                instruction.first = str.offset;
+                instruction.count = str.size;
+                this->instructions.push_back(instruction);
+            }
+            else
+            {
+                Unreachable();
+            }
+        }
+
+        block.num_instructions = uint32_t(this->instructions.size() - block.first_instruction);
+        block.num_labels = uint32_t(this->labels.size() - block.first_label);
+        this->blocks.push_back(block);
+    }
+
+    /// Writes the BIR file into `sink`.
+    void write(text_sink& sink) const
+    {
+        BirHeader header {};
+        std::memcpy(header.magic, "GBIR", 4);
+        header.version = bir_version;
+
+        uint32_t offset = sizeof(BirHeader);
+        auto place = [&](BirTable& table, size_t count, size_t record_size) {
+            table.offset = offset;
+            table.count = uint32_t(count);
+            offset += uint32_t((count * record_size + 3) & ~size_t(3));
+        };
+
+        place(header.blocks, blocks.size(), sizeof(BirBlock));
+        place(header.instructions, instructions.size(), sizeof(BirInstruction));
+        place(header.args, args.size(), sizeof(BirArg));
+        place(header.labels, labels.size(), sizeof(BirLabel));
+        place(header.models, models.size(), sizeof(BirString));
+        place(header.streams, streams.size(), sizeof(BirString));
+        place(header.strings, strings.size(), 1);
+
+        auto put_records = [&](const void* records, size_t size) {
+            static const char padding[4] = {};
+            sink.put(static_cast<const char*>(records), size);
+            sink.put(padding, (4 - size % 4) % 4);
+        };
+
+        put_records(&header, sizeof(header));
+        put_records(blocks.data(), blocks.size() * sizeof(BirBlock));
+        put_records(instructions.data(), instructions.size() * sizeof(BirInstruction));
+        put_records(args.data(), args.size() * sizeof(BirArg));
+        put_records(labels.data(), labels.size() * sizeof(BirLabel));
+        put_records(models.data(), models.size() * sizeof(BirString));
+        put_records(streams.data(), streams.size() * sizeof(BirString));
+        put_records(strings.data(), strings.size());
+    }
+
+private:
+    BirString add_string(const string_view& s)
+    {
+        BirString str { uint32_t(this->strings.size()), uint32_t(s.size()) };
+        this->strings.insert(this->strings.end(), s.begin(), s.end());
+        return str;
+    }
+
+    BirArg make_arg(const ArgVariant2& varg)
+    {
+        static_assert(uint8_t(VarType::TextLabel16) == uint8_t(BirVarType::TextLabel16)
+                   && uint8_t(DecompiledVarArray::ElemType::TextLabel16) == uint8_t(BirElemType::TextLabel16)
+                   && uint8_t(DecompiledString::Type::StringVar) == uint8_t(BirStringType::StringVar),
+                      "BIR enumerations must match the IR ones.");
+
+        BirArg arg {};
+
+        if(is<EOAL>(varg))
+        {
+            arg.type = uint8_t(BirArgType::EOAL);
+        }
+        else if(is<int8_t>(varg))
+        {
+            arg.type = uint8_t(BirArgType::Int8);
+            arg.value = uint32_t(int32_t(get<int8_t>(varg)));
+        }
+        else if(is<int16_t>(varg))
+        {
+            arg.type = uint8_t(BirArgType::Int16);
+            arg.value = uint32_t(int32_t(get<int16_t>(varg)));
+        }
+        else if(is<int32_t>(varg))
+        {
+            arg.type = uint8_t(BirArgType::Int32);
+            arg.value = uint32_t(get<int32_t>(varg));
+        }
+        else if(is<float>(varg))
+        {
+            arg.type = uint8_t(BirArgType::Float);
+            std::memcpy(&arg.value, &get<float>(varg), sizeof(arg.value));
+        }
+        else if(is<DecompiledVar>(varg))
+        {
+            auto& var = get<DecompiledVar>(varg);
+            arg.type = uint8_t(BirArgType::Var);
+            arg.subtype = uint8_t(var.type);
+            arg.global = var.global;
+            arg.value = var.offset;
+        }
+        else if(is<DecompiledVarArray>(varg))
+        {
+            auto& array = get<DecompiledVarArray>(varg);
+            arg.type = uint8_t(BirArgType::VarArray);
+            arg.subtype = uint8_t(array.base.type);
+            arg.elem_type = uint8_t(array.elem_type);
+            arg.array_size = array.array_size;
+            arg.global = array.base.global;
+            arg.index_global = array.index.global;
+            arg.value = array.base.offset;
+            arg.aux = array.index.offset;
+        }
+        else if(is<DecompiledString>(varg))
+        {
+            auto& dstr = get<DecompiledString>(varg);
+            auto str = this->add_string(dstr.storage);
+            arg.type = uint8_t(BirArgType::String);
+            arg.subtype = uint8_t(dstr.type);
+            arg.value = str.offset;
+            arg.aux = str.size;
+        }
+        else
+        {
+            Unreachable();
+        }
+
+        return arg;
+    }
+
+private:
+    std::vector<BirBlock>       blocks;
+    std::vector<BirInstruction> instructions;
+    std::vector<BirArg>         args;
+    std::vector<BirLabel>       labels;
+    std::vector<BirString>      models;
+    std::vector<BirString>      streams;
+    std::vector<char>           strings;
+};
+
+/// Converts the instructions of a BIR block back into the data given by the disassembler.
+///
+/// \returns nullopt if any opcode isn't a known command.
+inline optional<std::vector<DecompiledData>> read_bir_block(const BirReader& reader, const BirBlock& block,
+                                                            const Commands& commands)
+{
+    std::vector<DecompiledData> output;
+    output.reserve(block.num_instructions + block.num_labels);
+
+    auto labels = reader.labels(block);
+    auto it_label = labels.begin();
+
+    for(auto& instruction : reader.instructions(block))
+    {
+        for(; it_label != labels.end() && it_label->offset <= instruction.offset; ++it_label)
+            output.emplace_back(DecompiledLabelDef { it_label->offset });
+
+        if(instruction.kind == uint8_t(BirInstructionKind::Hex))
+        {
+            auto hex = reader.hex(instruction);
+            output.emplace_back(instruction.offset, std::vector<uint8_t>(hex.begin(), hex.end()));
+            continue;
+        }
+
+        auto command = commands.find_command(instruction.opcode);
+        if(!command)
+            return nullopt;
+
+        DecompiledCommand ccmd { instruction.not_flag != 0, *command };
+        ccmd.args.reserve(instruction.count);
+
+        for(auto& arg : reader.args(instruction))
+        {
+            switch(BirArgType(arg.type))
+            {
+                case BirArgType::EOAL:
+                    ccmd.args.emplace_back(EOAL{});
+                    break;
+                case BirArgType::Int8:
+                    ccmd.args.emplace_back(int8_t(arg.value));
+                    break;
+                case BirArgType::Int16:
+                    ccmd.args.emplace_back(int16_t(arg.value));
+                    break;
+                case BirArgType::Int32:
+                    ccmd.args.emplace_back(int32_t(arg.value));
+                    break;
+                case BirArgType::Float:
+                {
+                    float value;
+                    std::memcpy(&value, &arg.value, sizeof(value));
+                    ccmd.args.emplace_back(value);
+                    break;
+                }
+                case BirArgType::Var:
+                    ccmd.args.emplace_back(DecompiledVar { arg.global != 0, VarType(arg.subtype), arg.value });
+                    break;
+                case BirArgType::VarArray:
+                    ccmd.args.emplace_back(DecompiledVarArray {
+                        DecompiledVar { arg.global != 0, VarType(arg.subtype), arg.value },
+                        DecompiledVar { arg.index_global != 0, VarType::Int, arg.aux },
+                        arg.array_size,
+                        DecompiledVarArray::ElemType(arg.elem_type),
+                    });
+                    break;
+                case BirArgType::String:
+                {
+                    auto str = reader.string(arg);
+                    ccmd.args.emplace_back(DecompiledString { DecompiledString::Type(arg.subtype), std::string(str.begin(), str.end()) });
+                    break;
+                }
+                default:
+                    Unreachable();
+            }
+        }
+
+        output.emplace_back(instruction.offset, std::move(ccmd));
+    }
+
+    for(; it_label != labels.end(); ++it_label)
+        output.emplace_back(DecompiledLabelDef { it_label->offset });
+
+    return output;
+}
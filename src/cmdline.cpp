@@ -0,0 +1,511 @@
+#include <stdinc.h>
+#include "cmdline.hpp"
+#include "system.hpp"
+#include "cpp/argv.hpp"
+
+bool parse_args(char**& argv, fs::path& input, fs::path& output, DataInfo& data, ConfigInfo& conf, Options& options)
+{
+    try
+    {
+        bool flag;
+        int32_t temp_i32;
+
+        while(*argv)
+        {
+            if(**argv != '-')
+            {
+                if(!input.empty())
+                {
+                    fprintf(stderr, "gta3sc: error: input file appears twice\n");
+                    return false;
+                }
+
+                input = *argv;
+                ++argv;
+            }
+            else if(optget(argv, "-h", "--help", 0))
+            {
+                options.help = true;
+                return true;
+            }
+            else if(optget(argv, nullptr, "--version", 0))
+            {
+                options.version = true;
+                return true;
+            }
+            else if(const char* o = optget(argv, "-o", nullptr, 1))
+            {
+                output = o;
+            }
+            else if(optget(argv, nullptr, "--batch", 0))
+            {
+                options.batch = true;
+            }
+            else if(const char* n = optget(argv, "-j", "--jobs", 1))
+            {
+                char* n_end;
+                long num_jobs = strtol(n, &n_end, 10);
+                if(*n_end != '\0' || num_jobs <= 0)
+                {
+                    fprintf(stderr, "gta3sc: error: invalid number of jobs '%s'\n", n);
+                    return false;
+                }
+                options.num_jobs = static_cast<uint32_t>(num_jobs);
+            }
+            else if(optget(argv, nullptr, "-pedantic-errors", 0))
+            {
+                options.pedantic = true;
+                options.pedantic_errors = true;
+            }
+            else if(optget(argv, nullptr, "-pedantic", 0))
+            {
+                options.pedantic = true;
+            }
+            else if(optget(argv, nullptr, "--guesser", 0))
+            {
+                options.guesser = true;
+            }
+            else if(const char* info = optget(argv, nullptr, "--expect-var", 1))
+            {
+                if(!options.push_expect_var(info))
+                {
+                    fprintf(stderr, "gta3sc: error: failed to parse --expect-var entry\n");
+                    return false;
+                }
+            }
+            else if(optget(argv, nullptr, "--recursive-traversal", 0))
+            {
+                options.linear_sweep = false;
+            }
+            else if(optflag(argv, "-ftime-report", &flag))
+            {
+                options.time_report = flag;
+            }
+            else if(optflag(argv, "-fmem-report", &flag))
+            {
+                options.mem_report = flag;
+            }
+            else if(optflag(argv, "-fopt-stats", &flag))
+            {
+                options.opt_stats = flag;
+            }
+            else if(const char* trace_path = optget(argv, nullptr, "-ftime-trace", 1))
+            {
+                options.time_trace = fs::path(trace_path);
+            }
+            else if(optget(argv, nullptr, "--emit-bir", 0))
+            {
+                options.emit_bir = true;
+            }
+            else if(optget(argv, nullptr, "--emit-xrefs", 0))
+            {
+                options.emit_xrefs = true;
+            }
+            else if(const char* n = optget(argv, nullptr, "--only-mission", 1))
+            {
+                char* n_end;
+                long mission_id = strtol(n, &n_end, 10);
+                if(*n_end != '\0' || mission_id < 0)
+                {
+                    fprintf(stderr, "gta3sc: error: invalid mission number '%s'\n", n);
+                    return false;
+                }
+                options.only_mission = static_cast<uint32_t>(mission_id);
+            }
+            else if(const char* name = optget(argv, nullptr, "--only-stream", 1))
+            {
+                options.only_stream = std::string(name);
+            }
+            else if(const char* range = optget(argv, nullptr, "--range", 1))
+            {
+                // Either bound may be omitted, and may be given in hexadecimal.
+                const char* colon = strchr(range, ':');
+                char* begin_end = nullptr;
+                char* end_end = nullptr;
+                unsigned long begin = 0, end = UINT32_MAX;
+
+                if(colon != nullptr)
+                {
+                    if(colon != range) begin = strtoul(range, &begin_end, 0);
+                    if(colon[1] != '\0') end = strtoul(colon + 1, &end_end, 0);
+                }
+
+                if(colon == nullptr || (begin_end && begin_end != colon) || (end_end && *end_end != '\0')
+                    || begin > end || end > UINT32_MAX)
+                {
+                    fprintf(stderr, "gta3sc: error: invalid range '%s', expected <begin>:<end>\n", range);
+                    return false;
+                }
+
+                options.only_range = std::make_pair(static_cast<uint32_t>(begin), static_cast<uint32_t>(end));
+            }
+            else if(const char* name = optget(argv, nullptr, "--config", 1))
+            {
+                // avoid infinite recursion of parse_args(...) calls
+                if(iequal_to()(conf.config_name, name))
+                    continue;
+
+                conf.config_name = name;
+
+                if(auto opt_cmdline = read_file_utf8(config_path() / conf.config_name / "commandline.txt"))
+                {
+                    auto& cmdline = *opt_cmdline;
+                    small_vector<char*, 128> args;
+
+                    auto it = !cmdline.empty()? &cmdline[0] : nullptr;
+                    auto end = it + cmdline.size();
+                    for(; it != end; )
+                    {
+                        it = std::find_if_not(it, end, ::isspace);
+                        args.emplace_back(it);
+                        it = std::find_if(it, end, ::isspace);
+                        if(it != end) *it++ = '\0';
+                    }
+                    args.emplace_back(nullptr);
+
+                    char** argv2 = args.data();
+                    if(!parse_args(argv2, input, output, data, conf, options))
+                        return false;
+                }
+                else
+                {
+                    fprintf(stderr, "gta3sc: error: config path is missing commandline.txt file\n");
+                    return false;
+                }
+            }
+            else if(const char* path = optget(argv, nullptr, "--add-config", 1))
+            {
+                conf.add_config_files.emplace_back(path);
+            }
+            else if(const char* path = optget(argv, nullptr, "--datadir", 1))
+            {
+                data.datadir = path;
+            }
+            else if(const char* name = optget(argv, nullptr, "--levelfile", 1))
+            {
+                data.levelfile = name;
+            }
+            else if(const char* path = optget(argv, nullptr, "--models-cache", 1))
+            {
+                data.models_cache = path;
+            }
+            else if(const char* name = optget(argv, nullptr, "--error-format", 1))
+            {
+                if(!strcmp(name, "default"))
+                    options.error_format = Options::ErrorFormat::Default;
+                else if(!strcmp(name, "json"))
+                    options.error_format = Options::ErrorFormat::JSON;
+                else
+                {
+                    fprintf(stderr, "gta3sc: error: invalid error-format\n");
+                    return false;
+                }
+            }
+            else if(const char* ver = optget(argv, nullptr, "-mheader", 1))
+            {
+                if(!strcmp(ver, "gta3"))
+                    options.header = Options::HeaderVersion::GTA3;
+                else if(!strcmp(ver, "gtavc"))
+                    options.header = Options::HeaderVersion::GTAVC;
+                else if(!strcmp(ver, "gtasa"))
+                    options.header = Options::HeaderVersion::GTASA;
+                else
+                {
+                    fprintf(stderr, "gta3sc: error: invalid header version, must be 'gta3', 'gtavc' or 'gtasa'\n");
+                    return false;
+                }
+            }
+            else if(optflag(argv, "-mno-header", nullptr))
+            {
+                options.headerless = true;
+            }
+            else if(optflag(argv, "-moatc", &flag))
+            {
+                options.oatc = flag;
+            }
+            else if(optflag(argv, "-mq11.4", &flag))
+            {
+                options.use_half_float = flag;
+            }
+            else if(optflag(argv, "-mtyped-text-label", &flag))
+            {
+                options.has_text_label_prefix = flag;
+            }
+            else if(optflag(argv, "-moptimize-andor", &flag))
+            {
+                options.optimize_andor = flag;
+            }
+            else if(optflag(argv, "-moptimize-zero", &flag))
+            {
+                options.optimize_zero_floats = flag;
+            }
+            else if(!strncmp(*argv, "-O", 2))
+            {
+                if(!options.set_optimize_level(*argv + 2))
+                {
+                    fprintf(stderr, "gta3sc: error: invalid optimization level '%s'\n", *argv);
+                    return false;
+                }
+                ++argv;
+            }
+            else if(optflag(argv, "-frotate-loops", &flag))
+            {
+                options.rotate_loops = flag;
+            }
+            else if(optflag(argv, "-fswitch-tree", &flag))
+            {
+                options.switch_tree = flag;
+            }
+            else if(optflag(argv, "-fshort-circuit", &flag))
+            {
+                options.short_circuit = flag;
+            }
+            else if(!strncmp(*argv, "-finline-gosub=", 15))
+            {
+                char* size_end;
+                long max_size = strtol(*argv + 15, &size_end, 10);
+                if(*size_end != '\0' || size_end == *argv + 15 || max_size < 0)
+                {
+                    fprintf(stderr, "gta3sc: error: invalid subroutine size '%s'\n", *argv);
+                    return false;
+                }
+                options.inline_gosub = true;
+                options.inline_gosub_max_size = static_cast<uint32_t>(max_size);
+                ++argv;
+            }
+            else if(optflag(argv, "-finline-gosub", &flag))
+            {
+                options.inline_gosub = flag;
+            }
+            else if(optflag(argv, "-fremove-unreachable-code", &flag))
+            {
+                options.remove_unreachable_code = flag;
+            }
+            else if(optflag(argv, "-ffold-identical-code", &flag))
+            {
+                options.fold_identical_code = flag;
+            }
+            else if(optflag(argv, "-fthread-jumps", &flag))
+            {
+                options.thread_jumps = flag;
+            }
+            else if(optflag(argv, "-fremove-redundant-goto", &flag))
+            {
+                options.remove_redundant_goto = flag;
+            }
+            else if(optflag(argv, "-fshare-local-vars", &flag))
+            {
+                options.share_local_vars = flag;
+            }
+            else if(optflag(argv, "-fcompact-global-vars", &flag))
+            {
+                options.compact_global_vars = flag;
+            }
+            else if(optflag(argv, "-fentity-tracking", &flag))
+            {
+                options.entity_tracking = flag;
+            }
+            else if(optflag(argv, "-fscript-name-check", &flag))
+            {
+                options.script_name_check = flag;
+            }
+            else if(optflag(argv, "-frelax-not", &flag))
+            {
+                options.relax_not = flag;
+            }
+            else if(optflag(argv, "-fswitch", &flag))
+            {
+                options.fswitch = flag;
+            }
+            else if(optflag(argv, "-fbreak-continue", nullptr))
+            {
+                options.allow_break_continue = true;
+            }
+            else if(optflag(argv, "-fscope-then-label", &flag))
+            {
+                options.scope_then_label = flag;
+            }
+            else if(optflag(argv, "-funderscore-idents", &flag))
+            {
+                options.allow_underscore_identifiers = flag;
+            }
+            else if(optflag(argv, "-farrays", &flag))
+            {
+                options.farrays = flag;
+            }
+            else if(optflag(argv, "-fconst", &flag))
+            {
+                options.fconst = flag;
+            }
+            else if(optflag(argv, "-fstreamed-scripts", &flag))
+            {
+                options.streamed_scripts = flag;
+            }
+            else if(optflag(argv, "-ftext-label-vars", &flag))
+            {
+                options.text_label_vars = flag;
+            }
+            else if(optflag(argv, "-fskip-cutscene", &flag))
+            {
+                options.skip_cutscene = flag;
+            }
+            else if(optflag(argv, "-mlocal-offsets", nullptr))
+            {
+                options.use_local_offsets = true;
+            }
+            else if(optint(argv, "-ftimer-index", &options.timer_index)) {}
+            else if(optint(argv, "-flocal-var-limit", &options.local_var_limit)) {}
+            else if(optint(argv, "-fmission-var-limit", &temp_i32))
+            {
+                options.mission_var_limit = temp_i32 < 0? nullopt : optional<uint32_t>(temp_i32);
+            }
+            else if(optint(argv, "-fmission-var-begin", &temp_i32))
+            {
+                options.mission_var_begin = std::max(0, temp_i32);
+            }
+            else if(optint(argv, "-fswitch-case-limit", &temp_i32))
+            {
+                options.switch_case_limit = temp_i32 < 0? nullopt : optional<uint32_t>(temp_i32);
+            }
+            else if(optint(argv, "-farray-elem-limit", &temp_i32))
+            {
+                options.array_elem_limit = temp_i32 < 0? nullopt : optional<uint32_t>(temp_i32);
+            }
+            else if(optflag(argv, "-fsyntax-only", nullptr))
+            {
+                options.fsyntax_only = true;
+            }
+            else if(optflag(argv, "-emit-ir2", nullptr))
+            {
+                options.emit_ir2 = true;
+            }
+            else if(optflag(argv, "-fcleo", nullptr))
+            {
+                options.cleo.emplace(0);
+            }
+            else if(optget(argv, nullptr, "--cs", 0))
+            {
+                options.cleo.emplace(0);
+                options.output_cleo = true;
+                options.mission_script = false;
+                options.headerless = true;
+                options.use_local_offsets = true;
+            }
+            else if(optget(argv, nullptr, "--cm", 0))
+            {
+                options.cleo.emplace(0);
+                options.output_cleo = true;
+                options.mission_script = true;
+                options.headerless = true;
+                options.use_local_offsets = true;
+            }
+            else if(optflag(argv, "-fmission-script", nullptr))
+            {
+                options.mission_script = true;
+            }
+            else if(optflag(argv, "-Werror", &flag))
+            {
+                options.warning_is_error = flag;
+            }
+            else if(optflag(argv, "-Wconflict-text-label-var", &flag))
+            {
+                options.warn_conflict_text_label_var = flag;
+            }
+            else if(optflag(argv, "-Wexpect-var", &flag))
+            {
+                options.warn_expect_var = flag;
+            }
+            else if(optflag(argv, "-Wunreachable-code", &flag))
+            {
+                options.warn_unreachable_code = flag;
+            }
+            else if(optflag(argv, "-Wunused-global-var", &flag))
+            {
+                options.warn_unused_global_var = flag;
+            }
+            else if(optflag(argv, "-fconstant-checks", &flag))
+            {
+                options.constant_checks = flag;
+            }
+            else if(const char* name = optget(argv, "-D", "--define", 1))
+            {
+                options.define(name);
+            }
+            else if(const char* name = optget(argv, "-U", "--undefine", 1))
+            {
+                options.undefine(name);
+            }
+            else
+            {
+                fprintf(stderr, "gta3sc: error: unregonized argument '%s'\n", *argv);
+                return false;
+            }
+        }
+
+        return true;
+    }
+    catch(const invalid_opt& e)
+    {
+        fprintf(stderr, "gta3sc: error: %s\n", e.what());
+        return false;
+    }
+}
+
+bool check_options(const Options& options)
+{
+    if(!options.guesser && options.fswitch)
+    {
+        fprintf(stderr, "gta3sc: error: use of -fswitch only available in guesser mode [--guesser]\n");
+        return false;
+    }
+
+    if(!options.guesser && options.farrays)
+    {
+        fprintf(stderr, "gta3sc: error: use of -farrays only available in guesser mode [--guesser]\n");
+        return false;
+    }
+
+    if(!options.guesser && options.fconst)
+    {
+        fprintf(stderr, "gta3sc: error: use of -fconst only available in guesser mode [--guesser]\n");
+        return false;
+    }
+
+    if(options.emit_ir2 && options.emit_bir)
+    {
+        fprintf(stderr, "gta3sc: error: -emit-ir2 and --emit-bir cannot be used together\n");
+        return false;
+    }
+
+    if(!options.guesser && options.streamed_scripts)
+    {
+        fprintf(stderr, "gta3sc: error: use of -fstreamed_scripts only available in guesser mode [--guesser]\n");
+        return false;
+    }
+
+    if(!options.guesser && options.skip_cutscene)
+    {
+        fprintf(stderr, "gta3sc: error: use of -fskip-cutscene only available in guesser mode [--guesser]\n");
+        return false;
+    }
+
+    return true;
+}
+Commands load_commands(const ConfigInfo& conf, const DataInfo& data, const Options& options,
+                       const ModelTable& default_models)
+{
+    std::vector<fs::path> config_files;
+    config_files.reserve(6 + conf.add_config_files.size());
+
+    config_files.emplace_back(config_path() / "gta3sc.xml");
+    config_files.emplace_back("alternators.xml");
+    config_files.emplace_back("commands.xml");
+    config_files.emplace_back("constants.xml");
+    if(data.datadir.empty()) config_files.emplace_back("default.xml");
+    if(options.cleo) config_files.emplace_back("cleo.xml");
+    std::copy(conf.add_config_files.begin(), conf.add_config_files.end(), std::back_inserter(config_files));
+
+    Commands commands = Commands::from_xml(conf.config_name, config_files);
+    commands.add_default_models(default_models);
+    return commands;
+}
@@ -0,0 +1,37 @@
+///
+/// Command Line
+///
+/// Parsing of the command line options, shared by the driver and the tools built on top of the compiler.
+///
+#pragma once
+#include <stdinc.h>
+#include "program.hpp"
+
+/// Where the game data files are, as given by the command line.
+struct DataInfo
+{
+    fs::path    datadir;
+    std::string levelfile;
+    fs::path    models_cache;
+};
+
+/// Which game configuration to use, as given by the command line.
+struct ConfigInfo
+{
+    std::string           config_name;
+    std::vector<fs::path> add_config_files;
+};
+
+/// Parses the options in the null terminated `argv`, printing an error if any is invalid.
+///
+/// The first non-option argument is taken as the `input`. Options of the game configuration given by `--config`
+/// are parsed as well, from its `commandline.txt` file.
+bool parse_args(char**& argv, fs::path& input, fs::path& output, DataInfo& data, ConfigInfo& conf, Options& options);
+
+/// Checks whether the combination of `options` is valid, printing an error if not.
+bool check_options(const Options& options);
+
+/// Reads the commands, constants and alternators of the game configuration `conf`.
+/// \throws ConfigError on failure.
+Commands load_commands(const ConfigInfo& conf, const DataInfo& data, const Options& options,
+                       const ModelTable& default_models);
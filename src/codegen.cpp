@@ -39,6 +39,75 @@ uint32_t CodeGenerator::compute_labels()
     return offset;
 }
 
+uint32_t CodeGenerator::compute_size() const
+{
+    uint32_t size = 0;
+    for(auto& op : this->compiled)
+        size += compiled_size(op, *this);
+    return size;
+}
+
+uint32_t CodeGenerator::compute_size(const CompiledData& data) const
+{
+    return compiled_size(data, *this);
+}
+
+uint32_t CodeGenerator::compute_size(const ArgVariant& arg) const
+{
+    return compiled_size(arg, *this);
+}
+
+bool CodeGenerator::is_local_reference(const Label& label) const
+{
+    if(!this->script->uses_local_offsets())
+        return this->program.opt.use_local_offsets;
+    return label.script.lock()->uses_local_offsets();
+}
+
+int32_t CodeGenerator::label_operand(const Label& label) const
+{
+    if(!this->is_local_reference(label))
+        return static_cast<int32_t>(label.offset());
+    else if(this->script->uses_local_offsets())
+        return -static_cast<int32_t>(label.distance_from_base());
+    else
+        return -static_cast<int32_t>(label.offset());
+}
+
+uint8_t CodeGenerator::var_datatype(const Var& var, bool var_indexed)
+{
+    switch(var.type)
+    {
+        case VarType::Int:
+        case VarType::Float:
+            return var_indexed? (var.global? 0x7 : 0x8) : (var.global? 0x2 : 0x3);
+        case VarType::TextLabel:
+            return var_indexed? (var.global? 0xC : 0xD) : (var.global? 0xA : 0xB);
+        case VarType::TextLabel16:
+            return var_indexed? (var.global? 0x12 : 0x13) : (var.global? 0x10 : 0x11);
+        default:
+            Unreachable();
+    }
+}
+
+uint16_t CodeGenerator::var_operand(const Var& var, int32_t index)
+{
+    auto actual_index = index * Var::space_taken(var.type);
+    return static_cast<uint16_t>(var.global? var.offset() + actual_index * 4 : var.index + actual_index);
+}
+
+uint8_t CodeGenerator::array_elem_type(const Var& var)
+{
+    switch(var.type)
+    {
+        case VarType::Int: return 0;
+        case VarType::Float: return 1;
+        case VarType::TextLabel: return 2;
+        case VarType::TextLabel16: return 3;
+        default: Unreachable();
+    }
+}
+
 void CodeGenerator::generate()
 {
     this->bw = BinaryWriter(this->script->code_size.value());
@@ -68,16 +137,16 @@ CustomHeaderOATC::CustomHeaderOATC(const std::vector<CodeGenerator*>& gens, Prog
             if(is<CompiledCommand>(op.data))
             {
                 auto& ccmd = get<CompiledCommand>(op.data);
-                if(ccmd.command.hash)
+                if(ccmd.command.get().hash)
                 {
                     if(!this->find_opcode(ccmd.command))
                     {
-                        this->ordinal_commands.emplace_back(&ccmd.command, (uint16_t) this->ordinal_commands.size());
+                        this->ordinal_commands.emplace_back(&ccmd.command.get(), (uint16_t) this->ordinal_commands.size());
                     }
                 }
-                else if(ccmd.command.id && this->starting_opcode < *ccmd.command.id)
+                else if(ccmd.command.get().id && this->starting_opcode < *ccmd.command.get().id)
                 {
-                    this->starting_opcode = *ccmd.command.id + 1;
+                    this->starting_opcode = *ccmd.command.get().id + 1;
                 }
             }
         }
@@ -229,32 +298,95 @@ inline size_t compiled_size(const CompiledData& data, const CodeGenerator& codeg
 
 ////////////////////////////////////////////////////////////////////////
 
+// Data type emitted before each kind of argument generated by *compiler.hpp/cpp*, or nullopt if none is.
+
+inline optional<uint8_t> datatype(const EOAL&, const CodeGenerator&)
+{
+    return 0x00;
+}
+
+inline optional<uint8_t> datatype(const int8_t&, const CodeGenerator&)
+{
+    return 0x04;
+}
+
+inline optional<uint8_t> datatype(const int16_t&, const CodeGenerator&)
+{
+    return 0x05;
+}
+
+inline optional<uint8_t> datatype(const int32_t&, const CodeGenerator&)
+{
+    return 0x01;
+}
+
+inline optional<uint8_t> datatype(const float& value, const CodeGenerator& codegen)
+{
+    if(codegen.program.opt.optimize_zero_floats && value == 0.0f)
+        return 0x04;
+    return 0x06;
+}
+
+inline optional<uint8_t> datatype(const shared_ptr<Label>&, const CodeGenerator&)
+{
+    return 0x01;
+}
+
+inline optional<uint8_t> datatype(const CompiledVar& v, const CodeGenerator&)
+{
+    return CodeGenerator::var_datatype(*v.var, v.index != nullopt && is<shared_ptr<Var>>(*v.index));
+}
+
+inline optional<uint8_t> datatype(const CompiledString& str, const CodeGenerator& codegen)
+{
+    switch(str.type)
+    {
+        case CompiledString::Type::TextLabel8:
+            if(codegen.program.opt.has_text_label_prefix)
+                return 0x09;
+            return nullopt;
+        case CompiledString::Type::TextLabel16:
+            return 0x0F;
+        case CompiledString::Type::StringVar:
+            return 0x0E;
+        case CompiledString::Type::String128:
+            return nullopt;
+        default:
+            Unreachable();
+    }
+}
+
+optional<uint8_t> CodeGenerator::datatype(const ArgVariant& arg) const
+{
+    return visit_one(arg, [&](const auto& arg) { return ::datatype(arg, *this); });
+}
+
+////////////////////////////////////////////////////////////////////////
+
 template<typename T, typename CodeGen>
 inline void generate_code(const T& x, CodeGen& codegen)
 {
     return x.generate_code(codegen);
 }
 
-inline void generate_code(const EOAL&, CodeGenerator& codegen)
+// The data type of the arguments is emitted by `generate_code(const ArgVariant&, CodeGenerator&)`.
+
+inline void generate_code(const EOAL&, CodeGenerator&)
 {
-    codegen.bw.emplace_u8(0);
 }
 
 inline void generate_code(const int8_t& value, CodeGenerator& codegen)
 {
-    codegen.bw.emplace_u8(4);
     codegen.bw.emplace_i8(value);
 }
 
 inline void generate_code(const int16_t& value, CodeGenerator& codegen)
 {
-    codegen.bw.emplace_u8(5);
     codegen.bw.emplace_i16(value);
 }
 
 inline void generate_code(const int32_t& value, CodeGenerator& codegen)
 {
-    codegen.bw.emplace_u8(1);
     codegen.bw.emplace_i32(value);
 }
 
@@ -262,65 +394,45 @@ inline void generate_code(const float& value, CodeGenerator& codegen)
 {
     if(codegen.program.opt.optimize_zero_floats && value == 0.0f)
     {
-        generate_code(static_cast<int8_t>(0), codegen);
+        codegen.bw.emplace_i8(0);
     }
     else if(codegen.program.opt.use_half_float)
     {
-        codegen.bw.emplace_u8(6);
-        codegen.bw.emplace_i16(static_cast<int16_t>(value * 16.0f));
+        codegen.bw.emplace_i16(CodeGenerator::to_half_float(value));
     }
     else
     {
         static_assert(std::numeric_limits<float>::is_iec559
             && sizeof(float) == sizeof(uint32_t), "IEEE 754 floating point expected.");
 
-        codegen.bw.emplace_u8(6);
         codegen.bw.emplace_u32(reinterpret_cast<const uint32_t&>(value));
     }
 }
 
 inline void generate_code(const shared_ptr<Label>& label_ptr, CodeGenerator& codegen)
 {
-    codegen.bw.emplace_u8(1);
+    auto& label = *label_ptr;
+    auto offset = codegen.label_operand(label);
 
-    auto emplace_local_offset = [&](int32_t offset)
+    if(codegen.script->uses_local_offsets())
     {
-        if(offset == 0)
+        if(label.script.lock()->uses_local_offsets())
         {
-            codegen.program.error(nocontext, "compiled script references a label at the zero offset");
-            codegen.program.note(nocontext, "try using SCRIPT_NAME or NOP at the very top of your script");
+            assert(label.script.lock()->on_the_same_space_as(*codegen.script));
         }
-        codegen.bw.emplace_i32(-offset);
-    };
-
-    if(!codegen.script->uses_local_offsets())
-    {
-        if(codegen.program.opt.use_local_offsets)
-        {
-            int32_t absolute_offset = static_cast<int32_t>(label_ptr->offset());
-            emplace_local_offset(absolute_offset);
-        }
-        else
+        else if(codegen.program.opt.use_local_offsets) // label is within main block
         {
-            codegen.bw.emplace_i32(label_ptr->offset());
+            codegen.program.error(*codegen.script, "cannot branch from this script into main block using local offsets [-mlocal-offsets]");
         }
     }
-    else // current script is mission/stream
-    {
-        if(label_ptr->script.lock()->uses_local_offsets())
-        {
-            assert(label_ptr->script.lock()->on_the_same_space_as(*codegen.script));
-            int32_t local_offset = static_cast<int32_t>(label_ptr->distance_from_base());
-            emplace_local_offset(local_offset);
-        }
-        else // label is within main block
-        {
-            if(codegen.program.opt.use_local_offsets)
-                codegen.program.error(*codegen.script, "cannot branch from this script into main block using local offsets [-mlocal-offsets]");
 
-            codegen.bw.emplace_i32(label_ptr->offset());
-        }
+    if(codegen.is_local_reference(label) && offset == 0)
+    {
+        codegen.program.error(nocontext, "compiled script references a label at the zero offset");
+        codegen.program.note(nocontext, "try using SCRIPT_NAME or NOP at the very top of your script");
     }
+
+    codegen.bw.emplace_i32(offset);
 }
 
 inline void generate_code(const CompiledString& str, CodeGenerator& codegen)
@@ -329,18 +441,14 @@ inline void generate_code(const CompiledString& str, CodeGenerator& codegen)
     {
         case CompiledString::Type::TextLabel8:
             assert(str.storage.size() <= 8);
-            if(codegen.program.opt.has_text_label_prefix)
-                codegen.bw.emplace_u8(9);
             codegen.bw.emplace_chars(8, str.storage.c_str(), !str.preserve_case);
             break;
         case CompiledString::Type::TextLabel16:
             assert(str.storage.size() <= 16);
-            codegen.bw.emplace_u8(0xF);
             codegen.bw.emplace_chars(16, str.storage.c_str(), !str.preserve_case);
             break;
         case CompiledString::Type::StringVar:
             assert(str.storage.size() <= 127);
-            codegen.bw.emplace_u8(0xE);
             codegen.bw.emplace_u8(static_cast<uint8_t>(str.storage.size()));
             codegen.bw.emplace_chars(str.storage.size(), str.storage.c_str(), !str.preserve_case);
             break;
@@ -354,91 +462,30 @@ inline void generate_code(const CompiledString& str, CodeGenerator& codegen)
 
 inline void generate_code(const CompiledVar& v, CodeGenerator& codegen)
 {
-    bool global = v.var->global;
-
     if(v.index == nullopt)
     {
-        switch(v.var->type)
-        {
-            case VarType::Int:
-            case VarType::Float:
-                codegen.bw.emplace_u8(global? 0x2 : 0x3);
-                break;
-            case VarType::TextLabel:
-                codegen.bw.emplace_u8(global? 0xA : 0xB);
-                break;
-            case VarType::TextLabel16:
-                codegen.bw.emplace_u8(global? 0x10 : 0x11);
-                break;
-            default:
-                Unreachable();
-        }
-
-        codegen.bw.emplace_u16(static_cast<uint16_t>(global? v.var->offset() : v.var->index));
+        codegen.bw.emplace_u16(CodeGenerator::var_operand(*v.var));
+    }
+    else if(is<int32_t>(*v.index))
+    {
+        codegen.bw.emplace_u16(CodeGenerator::var_operand(*v.var, get<int32_t>(*v.index)));
     }
     else
     {
-        if(is<int32_t>(*v.index))
-        {
-            switch(v.var->type)
-            {
-                case VarType::Int:
-                case VarType::Float:
-                    codegen.bw.emplace_u8(global? 0x2 : 0x3);
-                    break;
-                case VarType::TextLabel:
-                    codegen.bw.emplace_u8(global? 0xA : 0xB);
-                    break;
-                case VarType::TextLabel16:
-                    codegen.bw.emplace_u8(global? 0x10 : 0x11);
-                    break;
-                default:
-                    Unreachable();
-            }
-
-            auto actual_index = get<int32_t>(*v.index) * Var::space_taken(v.var->type);
-            codegen.bw.emplace_u16(static_cast<uint16_t>(global? v.var->offset() + actual_index * 4 : v.var->index + actual_index));
-        }
-        else
-        {
-            auto& indexVar = get<shared_ptr<Var>>(*v.index);
-            switch(v.var->type)
-            {
-                case VarType::Int:
-                case VarType::Float:
-                    codegen.bw.emplace_u8(global? 0x7 : 0x8);
-                    break;
-                case VarType::TextLabel:
-                    codegen.bw.emplace_u8(global? 0xC : 0xD);
-                    break;
-                case VarType::TextLabel16:
-                    codegen.bw.emplace_u8(global? 0x12 : 0x13);
-                    break;
-                default:
-                    Unreachable();
-            }
-
-            auto ivartype = [&]() -> uint8_t {
-                switch(v.var->type)
-                {
-                    case VarType::Int: return 0;
-                    case VarType::Float: return 1;
-                    case VarType::TextLabel: return 2;
-                    case VarType::TextLabel16: return 3;
-                    default: Unreachable();
-                }
-            }();
+        auto& indexVar = get<shared_ptr<Var>>(*v.index);
+        auto ivartype = CodeGenerator::array_elem_type(*v.var);
 
-            codegen.bw.emplace_u16(static_cast<uint16_t>(global? v.var->offset() : v.var->index));
-            codegen.bw.emplace_u16(static_cast<uint16_t>(indexVar->global? indexVar->offset() : indexVar->index));
-            codegen.bw.emplace_u8(static_cast<uint8_t>(v.var->count.value()));
-            codegen.bw.emplace_u8((static_cast<uint8_t>(ivartype) & 0x7F) | (indexVar->global << 7));
-        }
+        codegen.bw.emplace_u16(CodeGenerator::var_operand(*v.var));
+        codegen.bw.emplace_u16(CodeGenerator::var_operand(*indexVar));
+        codegen.bw.emplace_u8(static_cast<uint8_t>(v.var->count.value()));
+        codegen.bw.emplace_u8((static_cast<uint8_t>(ivartype) & 0x7F) | (indexVar->global << 7));
     }
 }
 
 inline void generate_code(const ArgVariant& varg, CodeGenerator& codegen)
 {
+    if(auto type = codegen.datatype(varg))
+        codegen.bw.emplace_u8(*type);
     return visit_one(varg, [&](const auto& arg) { return ::generate_code(arg, codegen); });
 }
 
@@ -450,10 +497,10 @@ inline void generate_code(const CompiledCommand& ccmd, CodeGenerator& codegen)
         opcode = codegen.oatc->find_opcode(ccmd.command);
 
     if(opcode == nullopt)
-        opcode = ccmd.command.id;
+        opcode = ccmd.command.get().id;
 
     if(opcode == nullopt)
-        codegen.program.fatal_error(nocontext, "could not compile command {}, no id or no hash [-moatc]", ccmd.command.name);
+        codegen.program.fatal_error(nocontext, "could not compile command {}, no id or no hash [-moatc]", ccmd.command.get().name);
 
     codegen.bw.emplace_u16(*opcode | (ccmd.not_flag? 0x8000 : 0x0000));
     for(auto& arg : ccmd.args) ::generate_code(arg, codegen);
@@ -678,3 +725,29 @@ inline void generate_code(const CompiledData& data, CodeGenerator& codegen)
 {
     return visit_one(data.data, [&](const auto& data) { return ::generate_code(data, codegen); });
 }
+
+void CodeGenerator::report_memory(MemoryReport& report) const
+{
+    size_t ir_bytes = MemoryReport::bytes_of(this->compiled);
+    for(auto& data : this->compiled)
+    {
+        if(is<CompiledCommand>(data.data))
+        {
+            auto& ccmd = get<CompiledCommand>(data.data);
+            ir_bytes += MemoryReport::bytes_of(ccmd.args);
+            for(auto& arg : ccmd.args)
+            {
+                if(is<CompiledString>(arg))
+                    ir_bytes += MemoryReport::bytes_of(get<CompiledString>(arg).storage);
+            }
+        }
+        else if(is<CompiledHex>(data.data))
+        {
+            ir_bytes += MemoryReport::bytes_of(get<CompiledHex>(data.data).data);
+        }
+    }
+
+    auto owner = this->script->path.filename().u8string();
+    report.add(owner, "IR instructions", this->compiled.size(), ir_bytes);
+    report.add(owner, "bytecode", 1, this->buffer_size());
+}
@@ -60,6 +60,45 @@ public:
 
     ///
     const std::vector<CompiledData>& ir() const { return this->compiled; };
+
+    /// The intermediate representation may be changed (e.g. by the optimizer) up to `compute_labels`.
+    std::vector<CompiledData>& ir() { return this->compiled; };
+
+    /// \returns the size the code of this script would have if generated now.
+    uint32_t compute_size() const;
+
+    /// \returns the size `data` would take in the code of this script.
+    uint32_t compute_size(const CompiledData& data) const;
+
+    /// \returns the size `arg` would take in the code of this script, including its data type.
+    uint32_t compute_size(const ArgVariant& arg) const;
+
+    /// \returns the data type emitted before `arg`, or nullopt if none is (III/VC text labels and String128).
+    optional<uint8_t> datatype(const ArgVariant& arg) const;
+
+    /// \returns whether a reference to `label` from this script is emitted as a (negated) local offset.
+    bool is_local_reference(const Label& label) const;
+
+    /// \returns the offset emitted for a reference to `label` from this script. Local offsets are negative.
+    int32_t label_operand(const Label& label) const;
+
+    /// \returns the data type emitted for `var`, either indexed by another variable or not.
+    static uint8_t var_datatype(const Var& var, bool var_indexed);
+
+    /// \returns the offset (global variables) or index (local variables) emitted for `var` at the constant `index`.
+    static uint16_t var_operand(const Var& var, int32_t index = 0);
+
+    /// \returns the element type emitted for arrays indexed by a variable.
+    static uint8_t array_elem_type(const Var& var);
+
+    /// \returns `value` as stored in the bytecode when using half floats [-mq11.4].
+    static int16_t to_half_float(float value) { return static_cast<int16_t>(value * 16.0f); }
+
+    /// \returns the value of the half float `value`.
+    static float from_half_float(int16_t value) { return value / 16.0f; }
+
+    /// Accounts the memory taken by the intermediate representation and the bytecode into `report`.
+    void report_memory(MemoryReport& report) const;
 };
 
 /// Converts intermediate of pure-data things (such as the SCM header) into a bytecode.
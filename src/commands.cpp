@@ -43,6 +43,7 @@ Commands::Commands(transparent_set<Command>&& commands_,
     this->case_                         = find_command("CASE");
     this->switch_start                  = find_command("SWITCH_START");
     this->switch_continued              = find_command("SWITCH_CONTINUED");
+    this->gosub                         = find_command("GOSUB");
     this->gosub_file                    = find_command("GOSUB_FILE");
     this->launch_mission                = find_command("LAUNCH_MISSION");
     this->load_and_launch_mission_internal = find_command("LOAD_AND_LAUNCH_MISSION_INTERNAL");
@@ -90,7 +91,46 @@ optional<std::string> Commands::find_entity_name(EntityType type) const
     return nullopt;
 }
 
-void Commands::add_default_models(const insensitive_map<std::string, uint32_t>& default_models)
+void Commands::report_memory(MemoryReport& report) const
+{
+    size_t commands_bytes = 0;
+    for(auto& command : this->commands)
+    {
+        commands_bytes += MemoryReport::node_bytes<Command>() + MemoryReport::bytes_of(command.name);
+        if(command.args.size() > 12) // exceeds the inline storage of the small vector
+            commands_bytes += command.args.size() * sizeof(Command::Arg);
+        for(auto& arg : command.args)
+            commands_bytes += MemoryReport::bytes_of(arg.enums);
+    }
+
+    size_t alternators_bytes = 0;
+    for(auto& pair : this->alternators)
+    {
+        alternators_bytes += MemoryReport::node_bytes<decltype(pair)>() + MemoryReport::bytes_of(pair.first)
+                           + MemoryReport::bytes_of(pair.second);
+    }
+
+    size_t num_enum_values = 0, enums_bytes = 0;
+    for(auto& pair : this->enums)
+    {
+        enums_bytes += MemoryReport::node_bytes<decltype(pair)>() + MemoryReport::bytes_of(pair.first) + sizeof(Enum);
+        num_enum_values += pair.second->values.size();
+        for(auto& value : pair.second->values)
+            enums_bytes += MemoryReport::node_bytes<decltype(value)>() + MemoryReport::bytes_of(value.first);
+    }
+
+    size_t entities_bytes = 0;
+    for(auto& pair : this->entities)
+        entities_bytes += MemoryReport::node_bytes<decltype(pair)>() + MemoryReport::bytes_of(pair.first);
+
+    report.add("(config)", "commands", this->commands.size(), commands_bytes
+                + this->commands_by_id.size() * MemoryReport::node_bytes<std::pair<const uint16_t, const Command*>>());
+    report.add("(config)", "alternators", this->alternators.size(), alternators_bytes);
+    report.add("(config)", "enum values", num_enum_values, enums_bytes);
+    report.add("(config)", "entities", this->entities.size(), entities_bytes);
+}
+
+void Commands::add_default_models(const ModelTable& default_models)
 {
     for(auto& model_pair : default_models)
     {
@@ -87,6 +87,8 @@ struct Command
     bool                    supported;  //< Is this command supported by the script engine?
     bool                    internal;   //< Is this a command handled solely by the compiler itself?
     bool                    extension;  //< Is this a language extension?
+    bool                    pure;       //< Is this a condition without side effects, which may be left unevaluated?
+    uint8_t                 cost;       //< Relative cost of evaluating this command (zero for plain variable tests).
     optional<uint16_t>      id;         //< The opcode id.
     optional<uint32_t>      hash;       //< The command hash.
     small_vector<Arg, 12>   args;       //< The arguments of the command.
@@ -211,7 +213,10 @@ public:
     // TODO ^ make the paths of xml_list absolute? i.e. move modifies to outside?
 
     /// Adds the default models associated with the program context into the DEFAULTMODEL enum.
-    void add_default_models(const insensitive_map<std::string, uint32_t>&);
+    void add_default_models(const ModelTable&);
+
+    /// Gets all the commands, ordered by name.
+    const transparent_set<Command>& get_commands() const { return this->commands; }
 
     /// Gets the MODEL enumeration.
     const shared_ptr<Enum>& get_models_enum() const { return this->enum_models; }
@@ -252,6 +257,9 @@ public:
     /// Finds the name of the entity assigned to the id `type`.
     optional<std::string> find_entity_name(EntityType type) const;
 
+    /// Accounts the memory taken by the commands, enums and entities into `report`.
+    void report_memory(MemoryReport& report) const;
+
     /// Find a command based on its name.
     optional<const Command&> find_command(string_view name) const
     {
@@ -307,6 +315,12 @@ public:
         return false;
     }
 
+    /// \returns whether SWITCH statements can be compiled into SWITCH_START and SWITCH_CONTINUED.
+    bool has_switch_op() const
+    {
+        return switch_start && switch_start->supported && switch_continued && switch_continued->supported;
+    }
+
     bool is_alternator(const Command& command, optional<const Alternator&> alt) const
     {
         if(alt)
@@ -346,6 +360,7 @@ public:
     optional<const Command&> case_;
     optional<const Command&> switch_start;
     optional<const Command&> switch_continued;
+    optional<const Command&> gosub;
     optional<const Command&> gosub_file;
     optional<const Command&> return_;
     optional<const Command&> launch_mission;
@@ -59,11 +59,13 @@ void CompilerContext::compile_command(const Command& command, ArgList args, bool
         args.emplace_back(EOAL{});
     }
 
-    this->compiled.emplace_back(CompiledCommand{ not_flag, command, std::move(args) });
+    this->compiled.emplace_back(CompiledCommand{ not_flag, command, std::move(args), this->current_source });
 }
 
 void CompilerContext::compile_command(const SyntaxTree& command_node, bool not_flag)
 {
+    auto guard = source_guard(command_node);
+
     if(command_node.maybe_annotation<DummyCommandAnnotation>())
     {
         // compile nothing
@@ -224,18 +226,40 @@ void CompilerContext::compile_if(const SyntaxTree& if_node)
 
 void CompilerContext::compile_while(const SyntaxTree& while_node)
 {
-    auto beg_ptr = make_internal_label();
-    auto end_ptr = make_internal_label();
+    if(this->program.opt.rotate_loops)
+    {
+        // Tests the conditions at the bottom of each iteration, branching back into the body while the inverted
+        // conditions are false. The loop is entered by jumping into such test, so the conditions are compiled once.
+        auto loop_ptr     = make_internal_label();
+        auto continue_ptr = make_internal_label();
+        auto end_ptr      = make_internal_label();
+
+        loop_stack.emplace_back(LoopInfo { continue_ptr, end_ptr });
+
+        compile_command(*this->commands.goto_, { continue_ptr });
+        compile_label(loop_ptr);
+        compile_statements(while_node.child(1));
+        compile_label(continue_ptr);
+        compile_conditions(while_node.child(0), loop_ptr, true);
+        compile_label(end_ptr);
 
-    loop_stack.emplace_back(LoopInfo { beg_ptr, end_ptr });
+        loop_stack.pop_back();
+    }
+    else
+    {
+        auto beg_ptr = make_internal_label();
+        auto end_ptr = make_internal_label();
 
-    compile_label(beg_ptr);
-    compile_conditions(while_node.child(0), end_ptr);
-    compile_statements(while_node.child(1));
-    compile_command(*this->commands.goto_, { beg_ptr });
-    compile_label(end_ptr);
+        loop_stack.emplace_back(LoopInfo { beg_ptr, end_ptr });
 
-    loop_stack.pop_back();
+        compile_label(beg_ptr);
+        compile_conditions(while_node.child(0), end_ptr);
+        compile_statements(while_node.child(1));
+        compile_command(*this->commands.goto_, { beg_ptr });
+        compile_label(end_ptr);
+
+        loop_stack.pop_back();
+    }
 }
 
 void CompilerContext::compile_repeat(const SyntaxTree& repeat_node)
@@ -339,14 +363,16 @@ void CompilerContext::compile_switch(const SyntaxTree& switch_node)
         }
     }
 
-    auto opt_switch_start = commands.switch_start;
-    auto opt_switch_continued = commands.switch_continued;
+    auto& annotation = switch_node.annotation<const SwitchAnnotation&>();
 
-    if(opt_switch_start && opt_switch_start->supported
-    && opt_switch_continued && opt_switch_continued->supported)
+    if(commands.has_switch_op())
     {
         compile_switch_withop(switch_node, cases, break_ptr);
     }
+    else if(annotation.is_var_gt_int && annotation.num_cases > switch_tree_leaf_size)
+    {
+        compile_switch_tree(switch_node, cases, break_ptr);
+    }
     else
     {
         compile_switch_ifchain(switch_node, cases, break_ptr);
@@ -428,6 +454,91 @@ void CompilerContext::compile_switch_withop(const SyntaxTree& swnode, std::vecto
     compile_label(break_ptr);
 }
 
+void CompilerContext::compile_switch_tree(const SyntaxTree& swnode, std::vector<Case>& cases, shared_ptr<Label> break_ptr)
+{
+    std::vector<Case*> sorted_cases;   // does not contain default, unlike `cases`
+    sorted_cases.reserve(cases.size());
+    const Case* case_default = nullptr;
+
+    const Command& is_var_gt_int = *swnode.annotation<const SwitchAnnotation&>().is_var_gt_int;
+    auto& var = swnode.child(0);
+
+    for(auto& c : cases)
+    {
+        c.target = make_internal_label();
+        if(c.is_default())
+            case_default = std::addressof(c);
+        else
+            sorted_cases.emplace_back(std::addressof(c));
+    }
+
+    // The same programs as with the if-chain must be accepted, whatever the optimization level.
+    for(auto it = cases.begin(), next_it = cases.end(); it != cases.end(); it = next_it)
+    {
+        next_it = std::find_if(std::next(it), cases.end(), [&](const Case& c){
+            return !c.same_body_as(*it);
+        });
+
+        auto num_ifs = std::count_if(it, next_it, [](const Case& c) { return !c.is_default(); });
+        if(num_ifs > 8)
+            program.error(swnode, "more than 8 cases with the same body not supported using if-chain");
+    }
+
+    std::sort(sorted_cases.begin(), sorted_cases.end(), [](const Case* a, const Case* b) {
+        return *a->value < *b->value;
+    });
+
+    auto default_ptr = case_default? case_default->target : break_ptr;
+
+    // Branches into `else_ptr` if `command` comparing the variable with `value` is false.
+    auto compile_test = [&](const Command& command, int32_t value, bool not_flag, const shared_ptr<Label>& else_ptr)
+    {
+        if(!this->program.opt.optimize_andor)
+            compile_command(*this->commands.andor, { conv_int(0) });
+        compile_command(command, { get_arg(var), conv_int(value) }, not_flag);
+        compile_command(*this->commands.goto_if_false, { else_ptr });
+    };
+
+    // Binary searches the range [begin, end) of the sorted cases, until it's short enough to be tested linearly.
+    std::function<void(size_t, size_t)> compile_node = [&](size_t begin, size_t end)
+    {
+        if(end - begin <= switch_tree_leaf_size)
+        {
+            for(size_t i = begin; i < end; ++i)
+            {
+                if(sorted_cases[i]->is_var_eq_int == nullopt)
+                    program.fatal_error(nocontext, "unexpected failure at {}", __func__);
+
+                // NOT IS_VAR_EQUAL_TO is false exactly when the case matches.
+                compile_test(**sorted_cases[i]->is_var_eq_int, *sorted_cases[i]->value, true, sorted_cases[i]->target);
+            }
+            compile_command(*this->commands.goto_, { default_ptr });
+        }
+        else
+        {
+            auto mid = begin + (end - begin) / 2;
+            auto lower_ptr = make_internal_label();
+            compile_test(is_var_gt_int, *sorted_cases[mid - 1]->value, false, lower_ptr);
+            compile_node(mid, end);
+            compile_label(lower_ptr);
+            compile_node(begin, mid);
+        }
+    };
+
+    compile_node(0, sorted_cases.size());
+
+    for(auto it = cases.begin(); it != cases.end(); ++it)
+    {
+        compile_label(it->target);
+        if(std::next(it) == cases.end() || !std::next(it)->same_body_as(*it))
+        {
+            compile_statements(swnode.child(1), it->first_statement_id, it->last_statement_id);
+        }
+    }
+
+    compile_label(break_ptr);
+}
+
 void CompilerContext::compile_switch_ifchain(const SyntaxTree& swnode, std::vector<Case>& cases, shared_ptr<Label> break_ptr)
 {
     Case* default_case = nullptr;
@@ -519,6 +630,8 @@ void CompilerContext::compile_continue(const SyntaxTree& continue_node)
 
 void CompilerContext::compile_expr(const SyntaxTree& eq_node, bool not_flag)
 {
+    auto guard = source_guard(eq_node);
+
     if(eq_node.child(1).maybe_annotation<std::reference_wrapper<const Command>>())
     {
         // 'a = b OP c' or 'a OP= b'
@@ -567,6 +680,7 @@ void CompilerContext::compile_expr(const SyntaxTree& eq_node, bool not_flag)
 
 void CompilerContext::compile_incdec(const SyntaxTree& op_node, bool not_flag)
 {
+    auto guard = source_guard(op_node);
     auto& annotation = op_node.annotation<const IncDecAnnotation&>();
     auto& var = op_node.child(0);
     compile_command(annotation.op_var_with_one, { get_arg(var), get_arg(annotation.number_one) });
@@ -574,6 +688,7 @@ void CompilerContext::compile_incdec(const SyntaxTree& op_node, bool not_flag)
 
 void CompilerContext::compile_mission_end(const SyntaxTree& me_node, bool not_flag)
 {
+    auto guard = source_guard(me_node);
     const Command& command = me_node.annotation<std::reference_wrapper<const Command>>();
     return compile_command(command, {}, not_flag);
 }
@@ -598,13 +713,21 @@ void CompilerContext::compile_condition(const SyntaxTree& node, bool not_flag)
     }
 }
 
-void CompilerContext::compile_conditions(const SyntaxTree& conds_node, const shared_ptr<Label>& else_ptr)
+void CompilerContext::compile_conditions(const SyntaxTree& conds_node, const shared_ptr<Label>& else_ptr, bool invert)
 {
-    auto compile_multi_andor = [this](const auto& conds_node, size_t op)
+    if(this->program.opt.short_circuit
+    && (conds_node.type() == NodeType::AND || conds_node.type() == NodeType::OR)
+    && compile_short_circuit(conds_node, else_ptr, invert))
+    {
+        return;
+    }
+
+    // When inverting, De Morgan's laws turn an AND into an OR of the negated conditions, and vice versa.
+    auto compile_multi_andor = [this, invert](const auto& conds_node, size_t op)
     {
         assert(conds_node.child_count() <= 8);
         compile_command(*this->commands.andor, { conv_int(op + conds_node.child_count() - 2) });
-        for(auto& cond : conds_node) compile_condition(*cond);
+        for(auto& cond : conds_node) compile_condition(*cond, invert);
     };
 
     switch(conds_node.type())
@@ -619,13 +742,13 @@ void CompilerContext::compile_conditions(const SyntaxTree& conds_node, const sha
         case NodeType::LesserEqual:
             if (!this->program.opt.optimize_andor)
                 compile_command(*this->commands.andor, { conv_int(0) });
-            compile_condition(conds_node);
+            compile_condition(conds_node, invert);
             break;
         case NodeType::AND: // 1-8
-            compile_multi_andor(conds_node, 1);
+            compile_multi_andor(conds_node, invert? 21 : 1);
             break;
         case NodeType::OR: // 21-28
-            compile_multi_andor(conds_node, 21);
+            compile_multi_andor(conds_node, invert? 1 : 21);
             break;
         default:
             Unreachable();
@@ -634,6 +757,81 @@ void CompilerContext::compile_conditions(const SyntaxTree& conds_node, const sha
     compile_command(*this->commands.goto_if_false, { else_ptr });
 }
 
+auto CompilerContext::condition_command(const SyntaxTree& node) -> const Command*
+{
+    // also see compile_condition
+    switch(node.type())
+    {
+        case NodeType::NOT:
+            return condition_command(node.child(0));
+        case NodeType::Command:
+            if(node.maybe_annotation<DummyCommandAnnotation>())
+                return nullptr;
+            if(auto opt_annot = node.maybe_annotation<const ReplacedCommandAnnotation&>())
+                return &opt_annot->command;
+            return &node.annotation<std::reference_wrapper<const Command>>().get();
+        case NodeType::Equal:
+        case NodeType::Greater:
+        case NodeType::GreaterEqual:
+        case NodeType::Lesser:
+        case NodeType::LesserEqual:
+            if(node.child(1).maybe_annotation<std::reference_wrapper<const Command>>())
+                return nullptr; // 'a = b OP c'
+            return &node.annotation<std::reference_wrapper<const Command>>().get();
+        default:
+            return nullptr;
+    }
+}
+
+bool CompilerContext::compile_short_circuit(const SyntaxTree& conds_node, const shared_ptr<Label>& else_ptr, bool invert)
+{
+    // The script engine evaluates every condition of an ANDOR, even once the outcome is known. Conditions without
+    // side effects may instead be tested one at a time, in any order, leaving the remaining ones unevaluated.
+    std::vector<std::pair<const SyntaxTree*, const Command*>> conds;
+    conds.reserve(conds_node.child_count());
+    for(auto& cond : conds_node)
+    {
+        auto command = condition_command(*cond);
+        if(command == nullptr || !command->pure)
+            return false;
+        conds.emplace_back(cond.get(), command);
+    }
+
+    std::stable_sort(conds.begin(), conds.end(), [](const auto& a, const auto& b) {
+        return a.second->cost < b.second->cost;
+    });
+
+    // Only worth the additional branches if skipping the conditions after the first saves any work.
+    if(conds.size() < 2 || std::none_of(conds.begin() + 1, conds.end(), [](const auto& c) { return c.second->cost > 0; }))
+        return false;
+
+    auto compile_test = [this](const SyntaxTree& cond, bool not_flag, const shared_ptr<Label>& target)
+    {
+        if(!this->program.opt.optimize_andor)
+            compile_command(*this->commands.andor, { conv_int(0) });
+        compile_condition(cond, not_flag);
+        compile_command(*this->commands.goto_if_false, { target });
+    };
+
+    // When inverting, De Morgan's laws turn an AND into an OR of the negated conditions, and vice versa.
+    if((conds_node.type() == NodeType::AND) != invert)
+    {
+        for(auto& cond : conds)
+            compile_test(*cond.first, invert, else_ptr);
+    }
+    else
+    {
+        // Any condition but the last being true skips straight into the body.
+        auto then_ptr = make_internal_label();
+        for(size_t i = 0; i + 1 < conds.size(); ++i)
+            compile_test(*conds[i].first, !invert, then_ptr);
+        compile_test(*conds.back().first, invert, else_ptr);
+        compile_label(then_ptr);
+    }
+
+    return true;
+}
+
 auto CompilerContext::get_args(const Command& command, const std::vector<any>& params) -> ArgList
 {
     ArgList args;
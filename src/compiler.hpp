@@ -56,9 +56,11 @@ using ArgVariant = variant<EOAL, int8_t, int16_t, int32_t, float, shared_ptr<Lab
 /// IR for a single command plus its arguments.
 struct CompiledCommand
 {
-    bool                    not_flag;
-    const Command&          command;
-    std::vector<ArgVariant> args;
+    bool                                    not_flag;
+    std::reference_wrapper<const Command>   command;    //< A wrapper so that the IR can be rewritten in place.
+    std::vector<ArgVariant>                 args;
+    const SyntaxTree*                       where = nullptr; //< Statement written by the user this command was compiled
+                                                             //< from (nullptr if generated by a control structure).
 };
 
 /// IR for label **definitions**.
@@ -157,11 +159,15 @@ private:
         shared_ptr<Label> break_label;      //< Where a BREAK should jump into
     };
 
+    /// Maximum number of CASEs tested one after the other by a SWITCH lowered into a decision tree.
+    static constexpr size_t switch_tree_leaf_size = 4;
+
     // Helpers
     shared_ptr<Scope>              current_scope;
     std::vector<shared_ptr<Label>> internal_labels;
     std::vector<LoopInfo>          loop_stack;
     shared_ptr<Label>              label_skip_cutscene_end;
+    const SyntaxTree*              current_source = nullptr;   //< See `CompiledCommand::where`.
 
     // Inputs
     ProgramContext&                 program;
@@ -206,6 +212,15 @@ private:
 
     shared_ptr<Label> make_internal_label();
 
+    /// Attributes the commands compiled until the returned guard is destroyed to the statement `node`.
+    auto source_guard(const SyntaxTree& node)
+    {
+        auto prev_source = std::exchange(this->current_source, &node);
+        return make_scope_guard([this, prev_source] {
+            this->current_source = prev_source;
+        });
+    }
+
     void compile_statements(const SyntaxTree& parent, size_t from_id, size_t to_id_including);
 
     void compile_statements(const SyntaxTree& base);
@@ -234,6 +249,10 @@ private:
     // \warning expects no repeated Cases.
     void compile_switch_withop(const SyntaxTree& swnode, std::vector<Case>& cases, shared_ptr<Label> break_ptr);
 
+    // \warning mutates `cases`.
+    // \warning expects no repeated Cases.
+    void compile_switch_tree(const SyntaxTree& swnode, std::vector<Case>& cases, shared_ptr<Label> break_ptr);
+
     void compile_switch_ifchain(const SyntaxTree& swnode, std::vector<Case>& cases, shared_ptr<Label> break_ptr);
 
     void compile_break(const SyntaxTree& break_node);
@@ -248,7 +267,15 @@ private:
 
     void compile_condition(const SyntaxTree& node, bool not_flag = false);
 
-    void compile_conditions(const SyntaxTree& conds_node, const shared_ptr<Label>& else_ptr);
+    void compile_conditions(const SyntaxTree& conds_node, const shared_ptr<Label>& else_ptr, bool invert = false);
+
+    /// Compiles the AND/OR list `conds_node` into a chain of single tests, cheapest first, each one skipping the
+    /// remaining ones once the outcome is known (see -fshort-circuit).
+    /// \returns false (compiling nothing) if the conditions may have side effects or nothing would be skipped.
+    bool compile_short_circuit(const SyntaxTree& conds_node, const shared_ptr<Label>& else_ptr, bool invert);
+
+    /// \returns the command the condition `node` compiles into, or nullptr if it doesn't compile into a single command.
+    auto condition_command(const SyntaxTree& node) -> const Command*;
 
     void compile_dump(const SyntaxTree& node);
 
@@ -143,6 +143,8 @@ static Command
     xml_attribute<>* support_attrib = cmd_node->first_attribute("Supported");
     xml_attribute<>* internal_attrib = cmd_node->first_attribute("Internal");
     xml_attribute<>* extension_attrib = cmd_node->first_attribute("Extension");
+    xml_attribute<>* pure_attrib = cmd_node->first_attribute("Pure");
+    xml_attribute<>* cost_attrib = cmd_node->first_attribute("Cost");
     xml_node<>*      args_node   = cmd_node->first_node("Args");
 
     if(!name_attrib || !(id_attrib || hash_attrib))
@@ -227,10 +229,21 @@ static Command
         id = uint16_t(xml_stoi(id_attrib->value()) & 0x7FFF);
     }
 
+    uint8_t cost = 1;
+    if(cost_attrib)
+    {
+        auto value = xml_stoi(cost_attrib->value());
+        if(value < 0 || value > UINT8_MAX)
+            throw ConfigError("'Cost' attribute on '<Command>' node must be between 0 and {}, it is '{}'", UINT8_MAX, cost_attrib->value());
+        cost = uint8_t(value);
+    }
+
     return Command {
         xml_to_bool(support_attrib, true),               // supported
         xml_to_bool(internal_attrib, false),             // internal
         xml_to_bool(extension_attrib, false),            // extension
+        xml_to_bool(pure_attrib, false),                 // pure
+        cost,                                            // cost
         std::move(id),                                   // id
         std::move(hash),                                 // hash
         std::move(args),                                 // args
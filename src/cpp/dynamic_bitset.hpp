@@ -0,0 +1,143 @@
+///
+/// Dynamic Bitset
+///
+/// Like std::vector<bool>, but with word-wide operations to set ranges and to find set bits.
+///
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <climits>
+#include <vector>
+
+class dynamic_bitset
+{
+public:
+    using word_type = uint64_t;
+
+    static constexpr size_t npos = static_cast<size_t>(-1);
+    static constexpr size_t bits_per_word = sizeof(word_type) * CHAR_BIT;
+
+public:
+    explicit dynamic_bitset() = default;
+
+    explicit dynamic_bitset(size_t num_bits) { this->resize(num_bits); }
+
+    /// Resizes the bitset to `num_bits`. New bits are unset.
+    void resize(size_t num_bits)
+    {
+        this->words.resize((num_bits + bits_per_word - 1) / bits_per_word);
+        this->num_bits = num_bits;
+        this->clear_unused_bits();
+    }
+
+    size_t size() const { return this->num_bits; }
+    bool empty() const  { return this->num_bits == 0; }
+
+    bool test(size_t pos) const
+    {
+        return (this->words[pos / bits_per_word] & bit_mask(pos)) != 0;
+    }
+
+    bool operator[](size_t pos) const
+    {
+        return this->test(pos);
+    }
+
+    void set(size_t pos)
+    {
+        this->words[pos / bits_per_word] |= bit_mask(pos);
+    }
+
+    void reset(size_t pos)
+    {
+        this->words[pos / bits_per_word] &= ~bit_mask(pos);
+    }
+
+    /// Sets every bit in the range `[begin, end)`.
+    void set(size_t begin, size_t end)
+    {
+        if(begin >= end)
+            return;
+
+        size_t first_word = begin / bits_per_word;
+        size_t last_word  = (end - 1) / bits_per_word;
+
+        word_type first_mask = ~word_type(0) << (begin % bits_per_word);
+        word_type last_mask  = ~word_type(0) >> (bits_per_word - 1 - ((end - 1) % bits_per_word));
+
+        if(first_word == last_word)
+        {
+            this->words[first_word] |= (first_mask & last_mask);
+        }
+        else
+        {
+            this->words[first_word] |= first_mask;
+            for(size_t i = first_word + 1; i < last_word; ++i)
+                this->words[i] = ~word_type(0);
+            this->words[last_word] |= last_mask;
+        }
+    }
+
+    /// Finds the first set bit at or after `pos`.
+    /// \returns the position of such bit or `npos` if there's none.
+    size_t find_next(size_t pos) const
+    {
+        return this->find_next_if(pos, [](size_t, const word_type& w) { return w; });
+    }
+
+    /// Finds the first bit at or after `pos` which is set in either `*this` or `other`.
+    /// The size of `other` must be the same as the size of `*this`.
+    /// \returns the position of such bit or `npos` if there's none.
+    size_t find_next_either(const dynamic_bitset& other, size_t pos) const
+    {
+        return this->find_next_if(pos, [&](size_t i, const word_type& w) { return w | other.words[i]; });
+    }
+
+private:
+    static word_type bit_mask(size_t pos)
+    {
+        return word_type(1) << (pos % bits_per_word);
+    }
+
+    /// Scans the words, as transformed by `get_word(index, word)`, for the first set bit at or after `pos`.
+    template<typename GetWord>
+    size_t find_next_if(size_t pos, GetWord get_word) const
+    {
+        if(pos >= this->num_bits)
+            return npos;
+
+        size_t i = pos / bits_per_word;
+        word_type w = get_word(i, this->words[i]) & (~word_type(0) << (pos % bits_per_word));
+
+        while(w == 0)
+        {
+            if(++i == this->words.size())
+                return npos;
+            w = get_word(i, this->words[i]);
+        }
+
+        return i * bits_per_word + count_trailing_zeros(w);
+    }
+
+    static size_t count_trailing_zeros(word_type w)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        return static_cast<size_t>(__builtin_ctzll(w));
+#else
+        size_t n = 0;
+        for(; (w & 1) == 0; w >>= 1) ++n;
+        return n;
+#endif
+    }
+
+    /// Keeps the bits past `num_bits` in the last word unset, so whole word scans never find them.
+    void clear_unused_bits()
+    {
+        if(this->num_bits % bits_per_word)
+            this->words.back() &= ~(~word_type(0) << (this->num_bits % bits_per_word));
+    }
+
+private:
+    std::vector<word_type> words;
+    size_t                 num_bits = 0;
+};
@@ -0,0 +1,50 @@
+///
+/// Worker pool for running independent jobs concurrently.
+///
+#pragma once
+#include <cstddef>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+/// Number of workers to use when the user asks for `num_threads` of them (0 meaning one per hardware thread).
+inline unsigned num_workers(unsigned num_threads)
+{
+    if(num_threads == 0)
+        num_threads = std::thread::hardware_concurrency();
+    return std::max(1u, num_threads);
+}
+
+///
+/// Calls `functor(i)` for each `i` in `[0, count)` from a pool of `num_workers(num_threads)` threads.
+///
+/// The jobs are handed to the workers in order, but may complete in any order. The calling thread
+/// is also used as a worker, and this function only returns after all the jobs are completed.
+///
+/// \warning `functor` must not throw, otherwise the program terminates.
+///
+template<typename Functor>
+inline void parallel_for(size_t count, unsigned num_threads, Functor functor)
+{
+    auto num_threads_used = static_cast<unsigned>(std::min<size_t>(num_workers(num_threads), count));
+
+    std::atomic<size_t> next_job {0};
+
+    auto worker = [&]() noexcept
+    {
+        for(size_t i = next_job++; i < count; i = next_job++)
+            functor(i);
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(num_threads_used);
+
+    for(unsigned t = 1; t < num_threads_used; ++t)
+        threads.emplace_back(worker);
+
+    worker();
+
+    for(auto& thread : threads)
+        thread.join();
+}
@@ -0,0 +1,202 @@
+///
+/// Text Sink
+///
+/// Buffered text output into a FILE, formatting numbers straight into the buffer without allocating.
+///
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include "string_view.hpp"
+
+class text_sink
+{
+public:
+    static constexpr size_t buffer_size = 64 * 1024;
+
+public:
+    /// Writes into `stream`, which must be alive as long as this object.
+    ///
+    /// If `newline_at_end` is false, lines are separated by newlines instead of terminated by them.
+    explicit text_sink(FILE* stream, bool newline_at_end = true) :
+        stream(stream), buffer(new char[buffer_size]), newline_at_end(newline_at_end)
+    {}
+
+    text_sink(const text_sink&) = delete;
+    text_sink& operator=(const text_sink&) = delete;
+
+    ~text_sink()
+    {
+        this->flush();
+    }
+
+    /// Writes the buffered output into the stream.
+    /// \returns whether every write so far succeeded.
+    bool flush()
+    {
+        if(this->used != 0)
+        {
+            if(fwrite(this->buffer.get(), 1, this->used, this->stream) != this->used)
+                this->failed = true;
+            this->used = 0;
+        }
+        return !this->failed;
+    }
+
+    /// Must be called before the content of each line.
+    void begin_line()
+    {
+        if(this->pending_newline)
+        {
+            this->put('\n');
+            this->pending_newline = false;
+        }
+    }
+
+    /// Must be called after the content of each line.
+    void end_line()
+    {
+        if(this->newline_at_end)
+            this->put('\n');
+        else
+            this->pending_newline = true;
+    }
+
+    /// Writes the whole line `s`.
+    void line(const string_view& s)
+    {
+        this->begin_line();
+        this->put(s);
+        this->end_line();
+    }
+
+    void put(char c)
+    {
+        if(this->used == buffer_size)
+            this->flush();
+        this->buffer[this->used++] = c;
+    }
+
+    void put(const char* data, size_t size)
+    {
+        if(size > buffer_size - this->used)
+        {
+            this->flush();
+            if(size > buffer_size)
+            {
+                if(fwrite(data, 1, size, this->stream) != size)
+                    this->failed = true;
+                return;
+            }
+        }
+        std::memcpy(&this->buffer[this->used], data, size);
+        this->used += size;
+    }
+
+    void put(const string_view& s)
+    {
+        this->put(s.data(), s.size());
+    }
+
+    void put(const char* s)
+    {
+        this->put(s, std::strlen(s));
+    }
+
+    /// Writes `value` in decimal, as `printf("%llu")` would.
+    void put_uint(uint64_t value)
+    {
+        static const char digit_pairs[] =
+            "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+            "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+            "8081828384858687888990919293949596979899";
+
+        char temp[20];
+        char* p = temp + sizeof(temp);
+
+        while(value >= 100)
+        {
+            auto i = static_cast<size_t>(value % 100) * 2;
+            value /= 100;
+            *--p = digit_pairs[i + 1];
+            *--p = digit_pairs[i];
+        }
+
+        if(value >= 10)
+        {
+            auto i = static_cast<size_t>(value) * 2;
+            *--p = digit_pairs[i + 1];
+            *--p = digit_pairs[i];
+        }
+        else
+        {
+            *--p = static_cast<char>('0' + value);
+        }
+
+        this->put(p, static_cast<size_t>(temp + sizeof(temp) - p));
+    }
+
+    /// Writes `value` in decimal, as `printf("%lld")` would.
+    void put_int(int64_t value)
+    {
+        if(value < 0)
+        {
+            this->put('-');
+            this->put_uint(0 - static_cast<uint64_t>(value));
+        }
+        else
+        {
+            this->put_uint(static_cast<uint64_t>(value));
+        }
+    }
+
+    /// Writes `value` in hexadecimal, as `printf("%.6a")` would.
+    ///
+    /// Six digits are enough to represent any float exactly, thus no rounding takes place.
+    void put_hexfloat(float value)
+    {
+        static_assert(std::numeric_limits<double>::is_iec559
+            && sizeof(double) == sizeof(uint64_t), "IEEE 754 floating point expected.");
+
+        static const char hex_digits[] = "0123456789abcdef";
+
+        double dvalue = value; // floats are promoted to double by printf, which makes subnormals normal.
+        uint64_t bits;
+        std::memcpy(&bits, &dvalue, sizeof(bits));
+
+        bool negative     = (bits >> 63) != 0;
+        int32_t exponent  = static_cast<int32_t>((bits >> 52) & 0x7FF);
+        uint64_t mantissa = bits & ((uint64_t(1) << 52) - 1);
+
+        if(negative)
+            this->put('-');
+
+        if(exponent == 0x7FF)
+        {
+            this->put(mantissa? "nan" : "inf");
+            return;
+        }
+
+        char temp[16] = { '0', 'x', exponent? '1' : '0', '.' };
+        auto digits = static_cast<uint32_t>(mantissa >> (52 - 24));
+        for(size_t i = 0; i < 6; ++i)
+            temp[4 + i] = hex_digits[(digits >> (20 - 4 * i)) & 0xF];
+        temp[10] = 'p';
+        this->put(temp, 11);
+
+        int32_t unbiased = exponent? exponent - 1023 : 0;
+        this->put(unbiased < 0? '-' : '+');
+        this->put_uint(static_cast<uint32_t>(unbiased < 0? -unbiased : unbiased));
+    }
+
+private:
+    FILE*                   stream;
+    std::unique_ptr<char[]> buffer;
+    size_t                  used = 0;
+    bool                    newline_at_end;
+    bool                    pending_newline = false;
+    bool                    failed = false;
+};
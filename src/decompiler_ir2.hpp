@@ -10,8 +10,8 @@
 struct DecompilerIR2;
 
 template<typename T>
-std::string decompile_data(const T&, DecompilerIR2&);
-std::string decompile_data(const DecompiledData&, DecompilerIR2&);
+void decompile_data(const T&, DecompilerIR2&, text_sink&);
+void decompile_data(const DecompiledData&, DecompilerIR2&, text_sink&);
 
 struct DecompilerIR2
 {
@@ -19,11 +19,11 @@ private:
     std::vector<DecompiledData> data;
 
 protected:
-    friend std::string decompile_data(const DecompiledCommand&, DecompilerIR2&);
-    friend std::string decompile_data(const int8_t&, DecompilerIR2&);
-    friend std::string decompile_data(const int16_t&, DecompilerIR2&);
-    friend std::string decompile_data(const int32_t&, DecompilerIR2&);
-    friend std::string decompile_data(const DecompiledLabelDef&, DecompilerIR2&);
+    friend void decompile_data(const DecompiledCommand&, DecompilerIR2&, text_sink&);
+    friend void decompile_data(const int8_t&, DecompilerIR2&, text_sink&);
+    friend void decompile_data(const int16_t&, DecompilerIR2&, text_sink&);
+    friend void decompile_data(const int32_t&, DecompilerIR2&, text_sink&);
+    friend void decompile_data(const DecompiledLabelDef&, DecompilerIR2&, text_sink&);
 
     const Commands& commands;
     bool is_label_arg = false;
@@ -36,6 +36,7 @@ protected:
 
     const DecompilerIR2& main_ir2; // may point to *this
     std::map<size_t, size_t> label_ids; // <local_offset, id>
+    std::unordered_map<const Command*, CommandLayout> layouts; // built on demand, see `layout_of`
 
 public:
     explicit DecompilerIR2(const Commands& commands, std::vector<DecompiledData> decompiled,
@@ -74,18 +75,37 @@ public:
         }
     }
 
-    template<typename OnDecompile>
-    void decompile(OnDecompile callback)
+    /// Writes a line into `sink` for each piece of data in the local offset range `[begin, end)`.
+    void decompile(text_sink& sink, size_t begin = 0, size_t end = SIZE_MAX)
     {
         for(auto& d : this->data)
         {
-            callback(::decompile_data(d, *this));
+            if(d.offset < begin || d.offset >= end)
+                continue;
+
+            sink.begin_line();
+            ::decompile_data(d, *this, sink);
+            sink.end_line();
+        }
+    }
+
+    /// \returns the layout the arguments of `command` were decoded with.
+    const CommandLayout& layout_of(const Command& command)
+    {
+        auto it = this->layouts.find(&command);
+        if(it == this->layouts.end())
+        {
+            it = this->layouts.emplace(std::piecewise_construct, std::forward_as_tuple(&command),
+                                       std::forward_as_tuple(command, this->commands)).first;
         }
+        return it->second;
     }
 
-    optional<std::string> decompile_label_arg(int value) const
+    /// Writes the label at the `value` offset into `sink`.
+    /// \returns false, writing nothing, if there's no label at such offset.
+    bool decompile_label_arg(int value, text_sink& sink) const
     {
-        auto make_output = [&](char c, const std::string& block_name, size_t offset) -> optional<std::string>
+        auto make_output = [&](char c, const std::string& block_name, size_t offset) -> bool
         {
             if(offset >= this->base_offset
                 && offset < this->base_offset + this->script_size)
@@ -93,15 +113,14 @@ public:
                 auto it = this->label_ids.find(offset - this->base_offset);
                 if(it != this->label_ids.end())
                 {
-                    std::string output;
-                    output.push_back(c);
-                    output += block_name;
-                    output.push_back('_');
-                    output += std::to_string(it->second);
-                    return output;
+                    sink.put(c);
+                    sink.put(block_name);
+                    sink.put('_');
+                    sink.put_uint(it->second);
+                    return true;
                 }
             }
-            return nullopt;
+            return false;
         };
 
         if(value >= 0)
@@ -109,7 +128,7 @@ public:
             if(this->is_main_block)
                 return make_output('@', block_name, value);
             else
-                return this->main_ir2.decompile_label_arg(value);
+                return this->main_ir2.decompile_label_arg(value, sink);
         }
         else
             return make_output('%', block_name, this->base_offset + size_t(-value));
@@ -121,106 +140,82 @@ private:
 
 
 template<typename T>
-inline std::string decompile_data(const T& x, DecompilerIR2&)
+inline void decompile_data(const T& x, DecompilerIR2&, text_sink& sink)
 {
-    return x.decompile_data();
+    x.decompile_data(sink);
 }
 
-inline std::string decompile_data(const EOAL&, DecompilerIR2&)
+inline void decompile_data(const EOAL&, DecompilerIR2&, text_sink&)
 {
-    return std::string();
 }
 
-inline std::string decompile_data(const int8_t& value, DecompilerIR2& context)
+inline void decompile_data(const int8_t& value, DecompilerIR2& context, text_sink& sink)
 {
-    if(context.is_label_arg)
-    {
-        if(auto opt_output = context.decompile_label_arg(value))
-            return *opt_output;
-    }
+    if(context.is_label_arg && context.decompile_label_arg(value, sink))
+        return;
 
-    std::string output = std::to_string(static_cast<int>(value));
-    output += "i8";
-    return output;
+    sink.put_int(value);
+    sink.put("i8", 2);
 }
 
-inline std::string decompile_data(const int16_t& value, DecompilerIR2& context)
+inline void decompile_data(const int16_t& value, DecompilerIR2& context, text_sink& sink)
 {
-    if(context.is_label_arg)
-    {
-        if(auto opt_output = context.decompile_label_arg(value))
-            return *opt_output;
-    }
+    if(context.is_label_arg && context.decompile_label_arg(value, sink))
+        return;
 
-    std::string output = std::to_string(value);
-    output += "i16";
-    return output;
+    sink.put_int(value);
+    sink.put("i16", 3);
 }
 
-inline std::string decompile_data(const int32_t& value, DecompilerIR2& context)
+inline void decompile_data(const int32_t& value, DecompilerIR2& context, text_sink& sink)
 {
-    if(context.is_label_arg)
-    {
-        if(auto opt_output = context.decompile_label_arg(value))
-            return *opt_output;
-    }
+    if(context.is_label_arg && context.decompile_label_arg(value, sink))
+        return;
 
-    std::string output = std::to_string(value);
-    output += "i32";
-    return output;
+    sink.put_int(value);
+    sink.put("i32", 3);
 }
 
-inline std::string decompile_data(const float& value, DecompilerIR2&)
+inline void decompile_data(const float& value, DecompilerIR2&, text_sink& sink)
 {
-    char buffer[32];
-    sprintf(buffer, "%.6af", value);
-    return buffer;
+    sink.put_hexfloat(value);
+    sink.put('f');
 }
 
-inline std::string decompile_data(const DecompiledString& str, DecompilerIR2&)
+inline void decompile_data(const DecompiledString& str, DecompilerIR2&, text_sink& sink)
 {
-    std::string output;
     char quotes = 0;
 
-    output.reserve(str.storage.size() + 3); // +3 for quotes
-
     switch(str.type)
     {
         case DecompiledString::Type::TextLabel8:
-            output += "'";
+            sink.put("'", 1);
             quotes = '\'';
             break;
         case DecompiledString::Type::TextLabel16:
-            output += "v'";
+            sink.put("v'", 2);
             quotes = '\'';
             break;
         case DecompiledString::Type::StringVar:
-            output += "\"";
+            sink.put("\"", 1);
             quotes = '"';
             break;
         case DecompiledString::Type::String128:
-            output += "b\"";
+            sink.put("b\"", 2);
             quotes = '"';
             break;
         default:
             Unreachable();
     }
 
-    for(size_t i = 0; i < str.storage.size(); ++i)
-    {
-        if(str.storage[i] == '\0') break;
-        output.push_back(str.storage[i]);
-    }
-
-    output.push_back(quotes);
+    auto null_it = std::find(str.storage.begin(), str.storage.end(), '\0');
+    sink.put(str.storage.data(), null_it - str.storage.begin());
 
-    return output;
+    sink.put(quotes);
 }
 
-inline std::string decompile_data(const DecompiledVar& v, DecompilerIR2&)
+inline void decompile_data(const DecompiledVar& v, DecompilerIR2&, text_sink& sink)
 {
-    std::string output;
-
     auto type_cstr = v.type == VarType::Int? "" :
                      v.type == VarType::Float? "" :
                      v.type == VarType::TextLabel? "s" :
@@ -229,106 +224,88 @@ inline std::string decompile_data(const DecompiledVar& v, DecompilerIR2&)
 
     if(v.global)
     {
-        output += type_cstr;
-        output.push_back('&');
-        output.append(std::to_string(v.offset));
+        sink.put(type_cstr);
+        sink.put('&');
+        sink.put_uint(v.offset);
     }
     else
     {
-        output.append(std::to_string(v.offset / 4));
-        output.push_back('@');
-        output += type_cstr;
+        sink.put_uint(v.offset / 4);
+        sink.put('@');
+        sink.put(type_cstr);
     }
-
-    return output;
 }
 
-inline std::string decompile_data(const DecompiledVarArray& v, DecompilerIR2& context)
+inline void decompile_data(const DecompiledVarArray& v, DecompilerIR2& context, text_sink& sink)
 {
-    std::string output;
-    output += decompile_data(v.base, context);
-    output.push_back('(');
-    output += decompile_data(v.index, context);
-    output.push_back(',');
-    output += std::to_string(static_cast<int>(v.array_size));
-    output += v.elem_type == DecompiledVarArray::ElemType::None? "" :
-              v.elem_type == DecompiledVarArray::ElemType::Int? "i" :
-              v.elem_type == DecompiledVarArray::ElemType::Float? "f" :
-              v.elem_type == DecompiledVarArray::ElemType::TextLabel? "s" :
-              v.elem_type == DecompiledVarArray::ElemType::TextLabel16? "v" :
-              Unreachable();
-    output.push_back(')');
-    return output;
+    decompile_data(v.base, context, sink);
+    sink.put('(');
+    decompile_data(v.index, context, sink);
+    sink.put(',');
+    sink.put_uint(v.array_size);
+    sink.put(v.elem_type == DecompiledVarArray::ElemType::None? "" :
+             v.elem_type == DecompiledVarArray::ElemType::Int? "i" :
+             v.elem_type == DecompiledVarArray::ElemType::Float? "f" :
+             v.elem_type == DecompiledVarArray::ElemType::TextLabel? "s" :
+             v.elem_type == DecompiledVarArray::ElemType::TextLabel16? "v" :
+             Unreachable());
+    sink.put(')');
 }
 
-inline std::string decompile_data(const ArgVariant2& varg, DecompilerIR2& context)
+inline void decompile_data(const ArgVariant2& varg, DecompilerIR2& context, text_sink& sink)
 {
-    return visit_one(varg, [&](const auto& arg) { return ::decompile_data(arg, context); });
+    return visit_one(varg, [&](const auto& arg) { return ::decompile_data(arg, context, sink); });
 }
 
-inline std::string decompile_data(const DecompiledCommand& ccmd, DecompilerIR2& context)
+inline void decompile_data(const DecompiledCommand& ccmd, DecompilerIR2& context, text_sink& sink)
 {
-    std::string output;
-    size_t arg_id = 0;
-    
-    optional<const Command&> opt_command = ccmd.command;
-
-    bool not_flag = ccmd.not_flag;
-    auto& cmd_name = ccmd.command.name;
-    
-    output.reserve(12 + cmd_name.size() + ccmd.args.size() * 6);
-
-    /*
-    char opcode_buffer[6+1];
-    snprintf(opcode_buffer, sizeof(opcode_buffer), "%.4X: ", ccmd.id);
-    output.append(std::begin(opcode_buffer), std::end(opcode_buffer) - 1);
-    */
-
-    if(not_flag) output += "NOT ";
-    output += cmd_name;
-    output.push_back(' ');
+    auto& layout = context.layout_of(ccmd.command);
+
+    if(ccmd.not_flag) sink.put("NOT ", 4);
+    sink.put(ccmd.command.name);
+
+    // Arguments are separated by a space, with EOAL writing nothing, and then the last two spaces are trimmed.
+    size_t num_spaces = 1;
     for(size_t i = 0; i < ccmd.args.size(); ++i)
     {
-        if(opt_command)
+        if(is<EOAL>(ccmd.args[i]))
         {
-            if(auto opt_arg = opt_command->arg(i))
-                context.is_label_arg = (opt_arg->type == ArgType::Label);
+            ++num_spaces;
+            continue;
         }
 
-        output += ::decompile_data(ccmd.args[i], context);
-        output.push_back(' ');
+        context.is_label_arg = (layout.arg_kind(i) == CommandLayout::ArgKind::Label);
+
+        for(; num_spaces; --num_spaces) sink.put(' ');
+        ::decompile_data(ccmd.args[i], context, sink);
+        num_spaces = 1;
 
         context.is_label_arg = false;
     }
 
-    if(output.back() == ' ') output.pop_back();
-    if(output.back() == ' ') output.pop_back(); // again because of possible EOAL
-    return output;
+    for(; num_spaces > 2; --num_spaces) sink.put(' ');
 }
 
-inline std::string decompile_data(const DecompiledLabelDef& label, DecompilerIR2& context)
+inline void decompile_data(const DecompiledLabelDef& label, DecompilerIR2& context, text_sink& sink)
 {
-    return fmt::format("{}_{}:", context.block_name, context.label_ids[label.offset - context.base_offset]);
+    sink.put(context.block_name);
+    sink.put('_');
+    sink.put_uint(context.label_ids[label.offset - context.base_offset]);
+    sink.put(':');
 }
 
-inline std::string decompile_data(const DecompiledHex& hex, DecompilerIR2&)
+inline void decompile_data(const DecompiledHex& hex, DecompilerIR2&, text_sink& sink)
 {
-    std::string output;
-    output.reserve(sizeof("IR2_HEX ") + (hex.data.size() * 6) + 32);
-
-    output += "IR2_HEX ";
+    sink.put("IR2_HEX", 7);
     for(auto& x : hex.data)
     {
-        char buffer[16];
-        snprintf(buffer, sizeof(buffer), "%di8 ", int(int8_t(x)));
-        output.append(buffer);
+        sink.put(' ');
+        sink.put_int(int8_t(x));
+        sink.put("i8", 2);
     }
-    if(output.back() == ' ') output.pop_back();
-    return output;
 }
 
-inline std::string decompile_data(const DecompiledData& data, DecompilerIR2& context)
+inline void decompile_data(const DecompiledData& data, DecompilerIR2& context, text_sink& sink)
 {
-    return visit_one(data.data, [&](const auto& data) { return ::decompile_data(data, context); });
+    return visit_one(data.data, [&](const auto& data) { return ::decompile_data(data, context, sink); });
 }
-
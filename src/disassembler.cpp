@@ -3,14 +3,99 @@
 #include "program.hpp"
 #include "cdimage.hpp"
 
+/// Key of a `DecompiledXref` (or of the key itself) for searching by source.
+static size_t xref_source(const DecompiledXref& xref) { return xref.source; }
+static size_t xref_source(size_t source)              { return source; }
+
+/// Key of a `DecompiledXref` (or of the key itself) for searching by target.
+static std::pair<bool, size_t> xref_target(const DecompiledXref& xref)       { return { xref.to_main, xref.target }; }
+static std::pair<bool, size_t> xref_target(const std::pair<bool, size_t>& k) { return k; }
+
+Disassembler::Disassembler(ProgramContext& program, BinaryFetcher fetcher, Disassembler& main_asm, Type type) :
+    bf(std::move(fetcher)), program(program), main_asm(main_asm), type(type)
+{
+    // This constructor **ALWAYS** run, put all common initialization here.
+    if(this->is_main_segment())
+        this->layouts = std::make_shared<CommandLayoutTable>(program.commands);
+    else
+        this->layouts = main_asm.layouts;
+
+    this->label_offsets.resize(bf.size);
+    this->offset_explored.resize(bf.size);
+    this->offset_queued.resize(bf.size);
+}
+
 optional<size_t> Disassembler::data_index(uint32_t local_offset) const
 {
-    for(size_t i = 0; i < this->decompiled.size(); ++i)
+    auto it = std::lower_bound(this->decompiled_offsets.begin(), this->decompiled_offsets.end(), local_offset);
+    if(it != this->decompiled_offsets.end() && *it == local_offset)
+        return static_cast<size_t>(it - this->decompiled_offsets.begin());
+    return nullopt;
+}
+
+auto Disassembler::xrefs_from(size_t source) const -> std::pair<xref_iterator, xref_iterator>
+{
+    return std::equal_range(this->xrefs_by_source.begin(), this->xrefs_by_source.end(), source,
+                            [](const auto& a, const auto& b) {
+        return xref_source(a) < xref_source(b);
+    });
+}
+
+auto Disassembler::xrefs_to(size_t target, bool to_main) const -> std::pair<xref_iterator, xref_iterator>
+{
+    return std::equal_range(this->xrefs_by_target.begin(), this->xrefs_by_target.end(), std::make_pair(to_main, target),
+                            [](const auto& a, const auto& b) {
+        return xref_target(a) < xref_target(b);
+    });
+}
+
+void Disassembler::build_index()
+{
+    this->decompiled_offsets.clear();
+    this->decompiled_offsets.reserve(this->decompiled.size());
+
+    this->xrefs_by_source.clear();
+
+    for(auto& data : this->decompiled)
     {
-        if(this->decompiled[i].offset == local_offset)
-            return i;
+        this->decompiled_offsets.emplace_back(static_cast<uint32_t>(data.offset));
+
+        if(is<DecompiledCommand>(data.data))
+        {
+            auto& ccmd = get<DecompiledCommand>(data.data);
+
+            // The arguments were decoded from the layout of the command (e.g. a String128 is a single argument),
+            // so walk them the same way. Commands from the OATC header may not be in the layout table.
+            optional<CommandLayout> oatc_layout;
+            const CommandLayout* layout = ccmd.command.id? this->layouts->find(*ccmd.command.id) : nullptr;
+            if(layout == nullptr || &layout->command != &ccmd.command)
+            {
+                oatc_layout.emplace(ccmd.command, this->program.commands);
+                layout = std::addressof(*oatc_layout);
+            }
+
+            for(size_t i = 0; i < ccmd.args.size(); ++i)
+            {
+                if(layout->arg_kind(i) != CommandLayout::ArgKind::Label)
+                    continue;
+
+                if(auto opt_imm32 = get_imm32(ccmd.args[i]))
+                {
+                    // Same as in `explore_opcode`, positive offsets are in the main segment.
+                    int32_t label_param = *opt_imm32;
+                    if(label_param >= 0)
+                        this->xrefs_by_source.emplace_back(DecompiledXref { data.offset, size_t(label_param), !this->is_main_segment() });
+                    else
+                        this->xrefs_by_source.emplace_back(DecompiledXref { data.offset, size_t(-int64_t(label_param)), false });
+                }
+            }
+        }
     }
-    return nullopt;
+
+    this->xrefs_by_target = this->xrefs_by_source;
+    std::stable_sort(this->xrefs_by_target.begin(), this->xrefs_by_target.end(), [](const auto& a, const auto& b) {
+        return xref_target(a) < xref_target(b);
+    });
 }
 
 void Disassembler::run_analyzer(size_t from_offset)
@@ -21,7 +106,26 @@ void Disassembler::run_analyzer(size_t from_offset)
         from_offset = *opt_next;
     }
 
-    this->to_explore.emplace(from_offset);
+    this->push_explore(from_offset);
+    this->analyze();
+}
+
+void Disassembler::merge_branch_targets(const Disassembler& segment)
+{
+    Expects(this->is_main_segment() && &segment.main_asm == this);
+
+    for(auto offset : segment.main_branch_targets)
+    {
+        this->add_label(offset);
+
+        if(this->type == Type::RecursiveTraversal)
+            this->push_explore(offset);
+    }
+}
+
+void Disassembler::run_analyzer_on_branch_targets()
+{
+    Expects(this->is_main_segment() && this->type == Type::RecursiveTraversal);
     this->analyze();
 }
 
@@ -29,13 +133,35 @@ void Disassembler::analyze()
 {
     while(!this->to_explore.empty())
     {
-        auto offset = this->to_explore.top();
-        this->to_explore.pop();
+        auto offset = this->to_explore.back();
+        this->to_explore.pop_back();
+
+        if(offset < bf.size)
+            this->offset_queued.reset(offset);
 
         this->explore(offset);
     }
 }
 
+void Disassembler::push_explore(size_t offset)
+{
+    if(offset < bf.size)
+    {
+        if(this->offset_explored[offset] || this->offset_queued[offset])
+            return;
+        this->offset_queued.set(offset);
+    }
+
+    // offsets outside the bytecode are still pushed, so that `explore` can diagnose them.
+    this->to_explore.emplace_back(offset);
+}
+
+void Disassembler::add_label(size_t offset)
+{
+    if(offset < bf.size)
+        this->label_offsets.set(offset);
+}
+
 void Disassembler::explore(size_t offset)
 {
     if(offset >= bf.size)
@@ -56,9 +182,9 @@ void Disassembler::explore(size_t offset)
         bool not_flag = (*opt_cmdid & 0x8000) != 0;
         uint16_t pureid = *opt_cmdid & 0x7FFF;
 
-        if(auto opt_cmd = this->command_from_opcode(*opt_cmdid))
+        if(auto layout = this->layout_from_opcode(*opt_cmdid))
         {
-            if(explore_opcode(offset, *opt_cmd, not_flag))
+            if(explore_opcode(offset, *layout, not_flag))
                 return;
 
             program.warning(nocontext, "could not disassembly opcode 0x{:X} at local offset 0x{:X}", pureid, offset);
@@ -72,25 +198,25 @@ void Disassembler::explore(size_t offset)
     }
 
     // Exploring this byte wasn't quite successful, try the next one.
-    this->to_explore.emplace(offset + 1);
+    this->push_explore(offset + 1);
 }
 
-optional<const Command&> Disassembler::command_from_opcode(uint16_t opcode) const
+const CommandLayout* Disassembler::layout_from_opcode(uint16_t opcode) const
 {
     uint16_t pureid = opcode & 0x7FFF;
     if(pureid < this->oatc_start.value_or(0xFFFF))
     {
-        return this->program.commands.find_command(pureid);
+        return this->layouts->find(pureid);
     }
     else
     {
         size_t ordinal = pureid - *this->oatc_start;
         if(ordinal < this->oatc_table.size())
         {
-            if(auto ptr = this->oatc_table[ordinal])
-                return *ptr;
+            if(auto& layout = this->oatc_table[ordinal])
+                return std::addressof(*layout);
         }
-        return nullopt;
+        return nullptr;
     }
 }
 
@@ -125,7 +251,7 @@ void Disassembler::parse_custom_header(size_t offset, size_t end_offset)
             auto ordinal_begin = bf.fetch_u16(offset + 16).value();
             auto num_ordinals = bf.fetch_u16(offset + 18).value();
 
-            std::vector<const Command*> oatc_table;
+            std::vector<optional<CommandLayout>> oatc_table;
             oatc_table.reserve(num_ordinals);
 
             size_t table_end   = offset + 20 + 12 * num_ordinals;
@@ -137,9 +263,9 @@ void Disassembler::parse_custom_header(size_t offset, size_t end_offset)
                 if(offz) cmdname = bf.fetch_zstring(offz + offset + 12).value();
 
                 if(auto opt = this->program.commands.find_command(hash, cmdname))
-                    oatc_table.emplace_back(std::addressof(*opt));
+                    oatc_table.emplace_back(CommandLayout(*opt, this->program.commands));
                 else
-                    oatc_table.emplace_back(nullptr);
+                    oatc_table.emplace_back(nullopt);
             }
 
             this->oatc_start = ordinal_begin;
@@ -152,236 +278,321 @@ void Disassembler::parse_custom_header(size_t offset, size_t end_offset)
     }
 }
 
-optional<size_t> Disassembler::explore_opcode(size_t op_offset, const Command& command, bool not_flag)
+CommandLayout::CommandLayout(const Command& command, const Commands& commands) :
+    command(command), decodable(true)
 {
-    // delay addition of offsets into `this->to_explore`, the opcode may be illformed while we're analyzing it.
-    std::stack<size_t> interesting_offsets;
+    this->is_switch_start     = commands.equal(command, commands.switch_start);
+    this->is_switch_continued = commands.equal(command, commands.switch_continued);
 
-    size_t offset = op_offset + 2;
-
-    bool stop_it = false;
-    size_t argument_id = 0;
-
-    auto& commands = this->program.commands;
-    bool is_switch_start     = commands.equal(command, commands.switch_start);
-    bool is_switch_continued = commands.equal(command, commands.switch_continued);
+    // TODO would be nice if this was actually configurable.
+    this->is_terminator = commands.equal(command, commands.goto_)
+                       || commands.equal(command, commands.return_)
+                       || commands.equal(command, commands.cleo_return)
+                       || commands.equal(command, commands.terminate_this_script)
+                       || commands.equal(command, commands.terminate_this_custom_script);
 
-    auto check_for_imm32 = [&](auto value, const Command::Arg& arg)
+    for(auto it = command.args.begin(); it != command.args.end(); ++it)
     {
-        if(is_switch_start && argument_id == 1)
-        {
-            this->switch_cases_left = value;
-        }
+        ArgKind kind;
 
-        if(arg.type == ArgType::Label)
+        if(it->type == ArgType::TextLabel32)
         {
-            if(is_switch_start || is_switch_continued)
+            // TEXT_LABEL32 arguments come in groups of four, which are compiled as a single 128 bytes string.
+            auto is_fixed_text_label32 = [&](size_t i) {
+                return std::distance(it, command.args.end()) > ptrdiff_t(i)
+                    && std::next(it, i)->type == ArgType::TextLabel32 && !std::next(it, i)->optional;
+            };
+
+            if(!is_fixed_text_label32(0) || !is_fixed_text_label32(1)
+            || !is_fixed_text_label32(2) || !is_fixed_text_label32(3))
             {
-                if(this->switch_cases_left == 0)
-                    return; // don't take offset
-                    
-                if(is_switch_start && argument_id != 3) // not default label
-                    --this->switch_cases_left;
+                this->decodable = false;
+                break;
             }
 
-            interesting_offsets.emplace(value);
+            kind = ArgKind::String128;
+            it += 3;
         }
-    };
+        else if(it->type == ArgType::Label)
+            kind = ArgKind::Label;
+        else if(it->type == ArgType::TextLabel)
+            kind = ArgKind::TextLabel;
+        else if(it->type == ArgType::String)
+            kind = ArgKind::String;
+        else
+            kind = ArgKind::Value;
 
-    if(is_switch_start)
+        if(it->optional)
+        {
+            // Optional arguments repeat until a EOA, so any argument after it is never reached.
+            this->variadic = kind;
+            break;
+        }
+
+        this->args.emplace_back(kind);
+    }
+}
+
+CommandLayoutTable::CommandLayoutTable(const Commands& commands) :
+    by_opcode(0x8000, 0)
+{
+    for(uint16_t id = 0; id < 0x8000; ++id)
     {
-        // We need this set to 0 since the switch cases argument mayn't
-        // be a constant (ill-formed, but game executes).
-        this->switch_cases_left = 0;
+        if(auto command = commands.find_command(id))
+        {
+            this->layouts.emplace_back(*command, commands);
+            this->by_opcode[id] = static_cast<uint32_t>(this->layouts.size());
+        }
     }
+}
 
-    // TODO optimize out fetches here to just check offset + N
+/// Pseudo data type used by `DecodedArg` for a String128 argument, which has no data type in the bytecode.
+static constexpr uint8_t datatype_string128 = 0xFF;
 
-    try
+template<typename OnImm32>
+optional<size_t> Disassembler::decode_args(size_t op_offset, const CommandLayout& layout,
+                                           std::vector<DecodedArg>& args, OnImm32 on_imm32) const
+{
+    using ArgKind = CommandLayout::ArgKind;
+
+    if(!layout.decodable)
+        return nullopt;
+
+    size_t offset = op_offset + 2;
+
+    // Checks whether there are `count` bytes available at the current offset.
+    auto fits = [&](size_t count) {
+        return offset + count <= bf.size;
+    };
+
+    // Records a argument at the current offset and skips its `count` bytes of data.
+    auto push_arg = [&](uint8_t datatype, size_t count) {
+        args.emplace_back(DecodedArg { datatype, static_cast<uint32_t>(offset) });
+        offset += count;
+    };
+
+    for(size_t argument_id = 0; ; ++argument_id)
     {
-        for(auto it = command.args.begin();
-            !stop_it && it != command.args.end();
-            (it->optional? it : ++it), ++argument_id)
+        bool is_variadic = (argument_id >= layout.args.size());
+
+        if(is_variadic && !layout.variadic)
+            break;
+
+        ArgKind kind = is_variadic? *layout.variadic : layout.args[argument_id];
+
+        if(kind == ArgKind::String128)
         {
-            if(it->type == ArgType::TextLabel32)
+            if(!fits(128))
+                return nullopt;
+            push_arg(datatype_string128, 128);
+            continue;
+        }
+
+        if(!fits(1))
+            return nullopt;
+
+        uint8_t datatype = *bf.fetch_u8(offset++);
+
+        // Handle III/VC string arguments
+        if(datatype > 0x06 && !this->program.opt.has_text_label_prefix)
+        {
+            if(kind == ArgKind::TextLabel)
             {
-                if(std::next(it, 1) != command.args.end() && std::next(it, 1)->type == it->type
-                && std::next(it, 2) != command.args.end() && std::next(it, 2)->type == it->type
-                && std::next(it, 3) != command.args.end() && std::next(it, 3)->type == it->type)
-                {
-                    bf.fetch_chars(offset, 128).value();
-                    offset += 128;
-                    it += 3;
-                    continue;
-                }
-                else
-                {
+                offset = offset - 1; // there was no data type, remove one byte
+                if(!fits(8))
                     return nullopt;
-                }
+                push_arg(0x09, 8);
+                continue;
+            }
+            else if(datatype == 0x0E && kind == ArgKind::String && this->program.opt.cleo)
+            {
+                // III/VC CLEO suppots variable length strings
+                // let it pass
+            }
+            else
+            {
+                return nullopt;
             }
+        }
 
-            optional<uint8_t> opt_argtype = bf.fetch_u8(offset++);
+        switch(datatype)
+        {
+            case 0x00: // EOA (end of args)
+                if(!is_variadic)
+                    return nullopt;
+                push_arg(datatype, 0);
+                return offset;
 
-            if(!opt_argtype)
-                return nullopt;
+            case 0x01: // Int32
+                if(!fits(4))
+                    return nullopt;
+                on_imm32(*bf.fetch_i32(offset), kind, argument_id);
+                push_arg(datatype, 4);
+                break;
 
-            // Handle III/VC string arguments
-            if(*opt_argtype > 0x06 && !this->program.opt.has_text_label_prefix)
+            case 0x04: // Int8
+                if(!fits(1))
+                    return nullopt;
+                on_imm32(*bf.fetch_i8(offset), kind, argument_id);
+                push_arg(datatype, 1);
+                break;
+
+            case 0x05: // Int16
+                if(!fits(2))
+                    return nullopt;
+                on_imm32(*bf.fetch_i16(offset), kind, argument_id);
+                push_arg(datatype, 2);
+                break;
+
+            case 0x02: // Global Int/Float Var
+            case 0x03: // Local Int/Float Var
+            case 0x0A: // Global TextLabel Var (SA)
+            case 0x0B: // Local TextLabel Var (SA)
+            case 0x10: // Global TextLabel16 Var (SA)
+            case 0x11: // Local TextLabel16 Var (SA)
+                if(!fits(2))
+                    return nullopt;
+                push_arg(datatype, 2);
+                break;
+
+            case 0x07: // Global Int/Float Array (SA)
+            case 0x08: // Local Int/Float Array (SA)
+            case 0x0C: // Global TextLabel Array (SA)
+            case 0x0D: // Local TextLabel Array (SA)
+            case 0x12: // Global TextLabel16 Array (SA)
+            case 0x13: // Local TextLabel16 Array (SA)
+                if(!fits(6)) // u16 + i16 + u8 + u8
+                    return nullopt;
+                push_arg(datatype, 6);
+                break;
+
+            case 0x06: // Float
             {
-                if(it->type == ArgType::TextLabel)
-                {
-                    offset = offset - 1; // there was no data type, remove one byte
-                    bf.fetch_chars(offset, 8).value();
-                    offset += 8;
-                    continue;
-                }
-                else if(*opt_argtype == 0x0E 
-                        && it->type == ArgType::String 
-                        && this->program.opt.cleo)
-                {
-                    // III/VC CLEO suppots variable length strings
-                    // let it pass
-                }
-                else
-                {
+                size_t size = this->program.opt.use_half_float? sizeof(int16_t) : sizeof(uint32_t);
+                if(!fits(size))
                     return nullopt;
-                }
+                push_arg(datatype, size);
+                break;
             }
 
-            switch(*opt_argtype)
+            case 0x09: // Immediate 8-byte string (SA)
+                if(!fits(8))
+                    return nullopt;
+                push_arg(datatype, 8);
+                break;
+
+            case 0x0F: // Immediate 16-byte string (SA)
+                if(!fits(16))
+                    return nullopt;
+                push_arg(datatype, 16);
+                break;
+
+            case 0x0E: // Immediate variable-length string (SA)
             {
-                case 0x00: // EOA (end of args)
-                    if(!it->optional)
-                        return nullopt;
-                    stop_it = true;
-                    break;
+                if(!fits(1))
+                    return nullopt;
+                size_t count = *bf.fetch_u8(offset);
+                if(!fits(1 + count))
+                    return nullopt;
+                push_arg(datatype, 1 + count);
+                break;
+            }
 
-                case 0x01: // Int32
-                {
-                    int32_t imm32 = bf.fetch_i32(offset).value();
-                    check_for_imm32(imm32, *it);
-                    offset += sizeof(int32_t);
-                    break;
-                }
+            default:
+                return nullopt;
+        }
+    }
 
-                case 0x04: // Int8
-                {
-                    int8_t imm8 = bf.fetch_i8(offset).value();
-                    check_for_imm32(imm8, *it);
-                    offset += sizeof(int8_t);
-                    break;
-                }
+    return offset;
+}
 
-                case 0x05: // Int16
-                {
-                    int16_t imm16 = bf.fetch_i16(offset).value();
-                    check_for_imm32(imm16, *it);
-                    offset += sizeof(int16_t);
-                    break;
-                }
+optional<size_t> Disassembler::explore_opcode(size_t op_offset, const CommandLayout& layout, bool not_flag)
+{
+    // delay addition of offsets into `this->to_explore`, the opcode may be illformed while we're analyzing it.
+    small_vector<int32_t, 8> interesting_offsets;
 
-                case 0x02: // Global Int/Float Var
-                case 0x03: // Local Int/Float Var
-                case 0x0A: // Global TextLabel Var (SA)
-                case 0x0B: // Local TextLabel Var (SA)
-                case 0x10: // Global TextLabel16 Var (SA)
-                case 0x11: // Local TextLabel16 Var (SA)
-                    bf.fetch_u16(offset).value();
-                    offset += sizeof(uint16_t);
-                    break;
-
-                case 0x07: // Global Int/Float Array (SA)
-                case 0x08: // Local Int/Float Array (SA)
-                case 0x0C: // Global TextLabel Array (SA)
-                case 0x0D: // Local TextLabel Array (SA)
-                case 0x12: // Global TextLabel16 Array (SA)
-                case 0x13: // Local TextLabel16 Array (SA)
-                {
-                    bf.fetch_u32(offset+0).value();  // u16 + i16
-                    bf.fetch_u16(offset+4).value(); // u8 + u8
-                    offset += 6;
-                    break;
-                }
+    bool is_switch_start     = layout.is_switch_start;
+    bool is_switch_continued = layout.is_switch_continued;
 
-                case 0x06: // Float
-                    if(this->program.opt.use_half_float)
-                    {
-                        bf.fetch_i16(offset).value();
-                        offset += sizeof(int16_t);
-                    }
-                    else
-                    {
-                        bf.fetch_u32(offset).value();
-                        offset += sizeof(uint32_t);
-                    }
-                    break;
-
-                case 0x09: // Immediate 8-byte string (SA)
-                    bf.fetch_chars(offset, 8).value();
-                    offset += 8;
-                    break;
-
-                case 0x0F: // Immediate 16-byte string (SA)
-                    bf.fetch_chars(offset, 16).value();
-                    offset += 16;
-                    break;
-
-                case 0x0E: // Immediate variable-length string (SA)
-                {
-                    uint8_t count = bf.fetch_u8(offset).value();
-                    bf.fetch_chars(offset+1, count).value();
-                    offset += (count+1);
-                    break;
-                }
+    auto check_for_imm32 = [&](int32_t value, CommandLayout::ArgKind kind, size_t argument_id)
+    {
+        if(is_switch_start && argument_id == 1)
+        {
+            this->switch_cases_left = value;
+        }
 
-                default:
-                    return nullopt;
+        if(kind == CommandLayout::ArgKind::Label)
+        {
+            if(is_switch_start || is_switch_continued)
+            {
+                if(this->switch_cases_left == 0)
+                    return; // don't take offset
+
+                if(is_switch_start && argument_id != 3) // not default label
+                    --this->switch_cases_left;
             }
+
+            interesting_offsets.emplace_back(value);
         }
+    };
+
+    if(is_switch_start)
+    {
+        // We need this set to 0 since the switch cases argument mayn't
+        // be a constant (ill-formed, but game executes).
+        this->switch_cases_left = 0;
     }
-    catch(const bad_optional_access&)
+
+    auto first_arg = this->decoded_args.size();
+
+    auto opt_offset = this->decode_args(op_offset, layout, this->decoded_args, check_for_imm32);
+    if(!opt_offset)
     {
         // opcode is incorrect or broken
+        this->decoded_args.resize(first_arg);
         return nullopt;
     }
 
+    size_t offset = *opt_offset;
+
     // OK, opcode is not ill formed, we can push up the new offsets to explore
-    while(!interesting_offsets.empty())
+    for(auto it = interesting_offsets.rbegin(); it != interesting_offsets.rend(); ++it)
     {
-        int32_t label_param = interesting_offsets.top();
-        interesting_offsets.pop();
+        int32_t label_param = *it;
 
         if(label_param >= 0)
         {
-            main_asm.label_offsets.emplace(label_param);
+            if(this->is_main_segment())
+            {
+                this->add_label(label_param);
 
-            if(main_asm.type == Type::RecursiveTraversal)
-                main_asm.to_explore.emplace(label_param);
+                if(this->type == Type::RecursiveTraversal)
+                    this->push_explore(label_param);
+            }
+            else
+            {
+                this->main_branch_targets.emplace_back(label_param);
+            }
         }
         else
         {
-            this->label_offsets.emplace(-label_param);
+            this->add_label(-label_param);
 
             if(this->type == Type::RecursiveTraversal)
-                this->to_explore.emplace(-label_param);
+                this->push_explore(-label_param);
         }
     }
 
     if(this->type == Type::LinearSweep)
     {
         // Add next instruction to be explored.
-        this->to_explore.emplace(offset);
+        this->push_explore(offset);
     }
     else if(this->type == Type::RecursiveTraversal)
     {
         // add next instruction as the next thing to be explored, if this isn't a instruction that
         // terminates execution or jumps unconditionally to another offset.
-        // TODO would be nice if this was actually configurable.
-        if(!commands.equal(command, commands.goto_)
-        && !commands.equal(command, commands.return_)
-        && !commands.equal(command, commands.cleo_return)
-        && !commands.equal(command, commands.terminate_this_script)
-        && !commands.equal(command, commands.terminate_this_custom_script))
+        if(!layout.is_terminator)
         {
             if((is_switch_start || is_switch_continued) && this->switch_cases_left == 0)
             {
@@ -389,35 +600,31 @@ optional<size_t> Disassembler::explore_opcode(size_t op_offset, const Command& c
             }
             else
             {
-                this->to_explore.emplace(offset);
+                this->push_explore(offset);
             }
         }
     }
 
     // mark this area as explored
-    for(size_t i = op_offset; i < offset; ++i)
-        this->offset_explored[i] = true;
+    this->offset_explored.set(op_offset, offset);
+
+    // keep the decoded arguments around, so that `disassembly` doesn't need to decode this again.
+    this->decoded.emplace_back(DecodedInstruction {
+        static_cast<uint32_t>(op_offset), static_cast<uint32_t>(offset - op_offset),
+        static_cast<uint32_t>(first_arg), static_cast<uint32_t>(this->decoded_args.size() - first_arg),
+        not_flag, &layout,
+    });
 
     ++this->hint_num_ops;
 
     return offset - op_offset;
 }
 
-// this function should not really fail.
-// before it runs, `explore_opcode` ran, meaning everything is alright.
-DecompiledData Disassembler::opcode_to_data(size_t& offset)
+DecompiledData Disassembler::args_to_data(size_t offset, const CommandLayout& layout, bool not_flag,
+                                          const DecodedArg* args_begin, const DecodedArg* args_end) const
 {
-    bool stop_it = false;
-
-    auto cmdid     = *bf.fetch_u16(offset);
-    bool not_flag  = (cmdid & 0x8000) != 0;
-
-    const Command& command = *this->command_from_opcode(cmdid);
-
-    DecompiledCommand ccmd { (cmdid & 0x8000) != 0, command };
-
-    auto start_offset = offset;
-    offset = offset + 2;
+    DecompiledCommand ccmd { not_flag, layout.command };
+    ccmd.args.reserve(args_end - args_begin);
 
     // Helper functor to fetch array data.
     auto parse_array = [this, &ccmd](size_t offset, bool is_global, VarType type)
@@ -440,162 +647,134 @@ DecompiledData Disassembler::opcode_to_data(size_t& offset)
             array_size,
             elem_type,
         });
-
-        return offset + 6;
     };
 
-    for(auto it = command.args.begin();
-        !stop_it && it != command.args.end();
-        it->optional? it : ++it)
+    for(auto arg = args_begin; arg != args_end; ++arg)
     {
-        if(it->type == ArgType::TextLabel32)
-        {
-            assert(std::next(it,1)->type == it->type);
-            assert(std::next(it,2)->type == it->type);
-            assert(std::next(it,3)->type == it->type);
-            
-            ccmd.args.emplace_back(DecompiledString{ DecompiledString::Type::String128, std::move(*bf.fetch_chars(offset, 128)) });
-
-            it += 3;
-            offset += 128;
-            continue;
-        }
-
-        auto datatype = *bf.fetch_u8(offset++);
+        size_t arg_offset = arg->offset;
 
-        // Handle III/VC string arguments
-        if(datatype > 0x06 && !this->program.opt.has_text_label_prefix)
-        {
-            if(it->type == ArgType::TextLabel)
-            {
-                offset = offset - 1; // there was no data type, remove one byte
-                ccmd.args.emplace_back(DecompiledString { DecompiledString::Type::TextLabel8, std::move(*bf.fetch_chars(offset, 8)) });
-                offset += 8;
-                continue;
-            }
-
-            // Code was already analyzed by explore_opcode and it went fine.
-            // meaning either this is unreachable, or this is a variable
-            // length string with cleo support enabled. Let it run.
-        }
-
-        switch(datatype)
+        switch(arg->datatype)
         {
             case 0x00:
                 ccmd.args.emplace_back(EOAL{});
-                stop_it = true;
                 break;
 
             case 0x01: // Int32
-            {
-                auto i32 = *bf.fetch_i32(offset);
-                offset += sizeof(int32_t);
-                ccmd.args.emplace_back(i32);
+                ccmd.args.emplace_back(*bf.fetch_i32(arg_offset));
                 break;
-            }
 
             case 0x04: // Int8
-            {
-                auto i8 = *bf.fetch_i8(offset);
-                offset += sizeof(int8_t);
-                ccmd.args.emplace_back(i8);
+                ccmd.args.emplace_back(*bf.fetch_i8(arg_offset));
                 break;
-            }
 
             case 0x05: // Int16
-            {
-                auto i16 = *bf.fetch_i16(offset);
-                offset += sizeof(int16_t);
-                ccmd.args.emplace_back(i16);
+                ccmd.args.emplace_back(*bf.fetch_i16(arg_offset));
                 break;
-            }
 
             case 0x02: // Global Int/Float Var
-                ccmd.args.emplace_back(DecompiledVar{ true, VarType::Int, *bf.fetch_u16(offset) });
-                offset += sizeof(uint16_t);
+                ccmd.args.emplace_back(DecompiledVar{ true, VarType::Int, *bf.fetch_u16(arg_offset) });
                 break;
             case 0x0A: // Global TextLabel Var (SA)
-                ccmd.args.emplace_back(DecompiledVar{ true, VarType::TextLabel, *bf.fetch_u16(offset) });
-                offset += sizeof(uint16_t);
+                ccmd.args.emplace_back(DecompiledVar{ true, VarType::TextLabel, *bf.fetch_u16(arg_offset) });
                 break;
             case 0x10: // Global TextLabel16 Var (SA)
-                ccmd.args.emplace_back(DecompiledVar { true, VarType::TextLabel16, *bf.fetch_u16(offset) });
-                offset += sizeof(uint16_t);
+                ccmd.args.emplace_back(DecompiledVar { true, VarType::TextLabel16, *bf.fetch_u16(arg_offset) });
                 break;
 
             case 0x03: // Local Int/Float Var
-                ccmd.args.emplace_back(DecompiledVar{ false, VarType::Int, *bf.fetch_u16(offset) * 4u });
-                offset += sizeof(uint16_t);
+                ccmd.args.emplace_back(DecompiledVar{ false, VarType::Int, *bf.fetch_u16(arg_offset) * 4u });
                 break;
             case 0x0B: // Local TextLabel Var (SA)
-                ccmd.args.emplace_back(DecompiledVar{ false, VarType::TextLabel, *bf.fetch_u16(offset) * 4u });
-                offset += sizeof(uint16_t);
+                ccmd.args.emplace_back(DecompiledVar{ false, VarType::TextLabel, *bf.fetch_u16(arg_offset) * 4u });
                 break;
             case 0x11: // Local TextLabel16 Var (SA)
-                ccmd.args.emplace_back(DecompiledVar { false, VarType::TextLabel16, *bf.fetch_u16(offset) * 4u });
-                offset += sizeof(uint16_t);
+                ccmd.args.emplace_back(DecompiledVar { false, VarType::TextLabel16, *bf.fetch_u16(arg_offset) * 4u });
                 break;
 
             case 0x07: // Global Int/Float Array (SA)
-                offset = parse_array(offset, true, VarType::Int);
+                parse_array(arg_offset, true, VarType::Int);
                 break;
             case 0x0C: // Global TextLabel Array (SA)
-                offset = parse_array(offset, true, VarType::TextLabel);
+                parse_array(arg_offset, true, VarType::TextLabel);
                 break;
             case 0x12: // Global TextLabel16 Array (SA)
-                offset = parse_array(offset, true, VarType::TextLabel16);
+                parse_array(arg_offset, true, VarType::TextLabel16);
                 break;
 
             case 0x08: // Local Int/Float Array (SA)
-                offset = parse_array(offset, false, VarType::Int);
+                parse_array(arg_offset, false, VarType::Int);
                 break;
             case 0x0D: // Local TextLabel Array (SA)
-                offset = parse_array(offset, false, VarType::TextLabel);
+                parse_array(arg_offset, false, VarType::TextLabel);
                 break;
             case 0x13: // Local TextLabel16 Array (SA)
-                offset = parse_array(offset, false, VarType::TextLabel16);
+                parse_array(arg_offset, false, VarType::TextLabel16);
                 break;
 
             case 0x06: // Float
                 if(this->program.opt.use_half_float)
                 {
-                    ccmd.args.emplace_back(*bf.fetch_i16(offset) / 16.0f);
-                    offset += sizeof(int16_t);
+                    ccmd.args.emplace_back(*bf.fetch_i16(arg_offset) / 16.0f);
                 }
                 else
                 {
                     static_assert(std::numeric_limits<float>::is_iec559
                         && sizeof(float) == sizeof(uint32_t), "IEEE 754 floating point expected.");
 
-                    ccmd.args.emplace_back(reinterpret_cast<const float&>(*bf.fetch_u32(offset)));
-                    offset += sizeof(uint32_t);
+                    ccmd.args.emplace_back(reinterpret_cast<const float&>(*bf.fetch_u32(arg_offset)));
                 }
                 break;
 
-            case 0x09: // Immediate 8-byte string (SA)
-                ccmd.args.emplace_back(DecompiledString{ DecompiledString::Type::TextLabel8, std::move(*bf.fetch_chars(offset, 8)) });
-                offset += 8;
+            case 0x09: // Immediate 8-byte string (SA), or a III/VC text label
+                ccmd.args.emplace_back(DecompiledString{ DecompiledString::Type::TextLabel8, std::move(*bf.fetch_chars(arg_offset, 8)) });
                 break;
 
             case 0x0F: // Immediate 16-byte string (SA)
-                ccmd.args.emplace_back(DecompiledString{ DecompiledString::Type::TextLabel16, std::move(*bf.fetch_chars(offset, 16)) });
-                offset += 16;
+                ccmd.args.emplace_back(DecompiledString{ DecompiledString::Type::TextLabel16, std::move(*bf.fetch_chars(arg_offset, 16)) });
                 break;
 
             case 0x0E: // Immediate variable-length string (SA)
             {
-                auto count = *bf.fetch_u8(offset);
-                ccmd.args.emplace_back(DecompiledString{ DecompiledString::Type::StringVar, std::move(*bf.fetch_chars(offset+1, count)) });
-                offset += count + 1;
+                auto count = *bf.fetch_u8(arg_offset);
+                ccmd.args.emplace_back(DecompiledString{ DecompiledString::Type::StringVar, std::move(*bf.fetch_chars(arg_offset+1, count)) });
                 break;
             }
 
+            case datatype_string128:
+                ccmd.args.emplace_back(DecompiledString{ DecompiledString::Type::String128, std::move(*bf.fetch_chars(arg_offset, 128)) });
+                break;
+
             default:
                 Unreachable();
         }
     }
 
-    return DecompiledData(start_offset, std::move(ccmd));
+    return DecompiledData(offset, std::move(ccmd));
+}
+
+DecompiledData Disassembler::opcode_to_data(size_t& offset) const
+{
+    auto start_offset = offset;
+
+    if(auto opt_cmdid = bf.fetch_u16(offset))
+    {
+        bool not_flag = (*opt_cmdid & 0x8000) != 0;
+
+        if(auto layout = this->layout_from_opcode(*opt_cmdid))
+        {
+            std::vector<DecodedArg> args;
+            auto ignore_imm32 = [](int32_t, CommandLayout::ArgKind, size_t) {};
+
+            if(auto opt_offset = this->decode_args(offset, *layout, args, ignore_imm32))
+            {
+                offset = *opt_offset;
+                return args_to_data(start_offset, *layout, not_flag, args.data(), args.data() + args.size());
+            }
+        }
+    }
+
+    offset = start_offset + 1;
+    return DecompiledData(start_offset, std::vector<uint8_t>(bf.bytes + start_offset, bf.bytes + offset));
 }
 
 void Disassembler::disassembly(size_t from_offset)
@@ -607,35 +786,54 @@ void Disassembler::disassembly(size_t from_offset)
     while(auto opt_next = this->skip_custom_header(from_offset))
         from_offset = *opt_next;
 
+    // walk the explored instructions in the same order as the bytecode.
+    std::sort(this->decoded.begin(), this->decoded.end(), [](const auto& a, const auto& b) {
+        return a.offset < b.offset;
+    });
+
+    auto next_decoded = this->decoded.cbegin();
+
     for(size_t offset = from_offset; offset < bf.size; )
     {
-        if(this->label_offsets.count(offset))
+        if(this->label_offsets[offset])
         {
             output.emplace_back(DecompiledLabelDef{ offset });
         }
 
         if(this->offset_explored[offset])
         {
-            output.emplace_back(opcode_to_data(offset));
-            // offset was received by ref and mutated ^
+            while(next_decoded != this->decoded.cend() && next_decoded->offset < offset)
+                ++next_decoded;
+
+            if(next_decoded != this->decoded.cend() && next_decoded->offset == offset)
+            {
+                auto args_begin = this->decoded_args.data() + next_decoded->first_arg;
+                auto args_end   = args_begin + next_decoded->num_args;
+                output.emplace_back(args_to_data(offset, *next_decoded->layout, next_decoded->not_flag, args_begin, args_end));
+                offset += next_decoded->size;
+            }
+            else
+            {
+                // this offset is in the middle of a explored instruction (i.e. a branch into its arguments
+                // made two instructions overlap), so it must be decoded once again.
+                output.emplace_back(opcode_to_data(offset));
+                // offset was received by ref and mutated ^
+            }
         }
         else
         {
-            auto begin_offset = offset++;
-            for(; offset < bf.size; ++offset)
-            {
-                // repeat this loop until a label offset or a explored offset is found, then break.
-                //
-                // if a label offset is found, it'll be added at the beggining of the outer for loop,
-                // and then (maybe) this loop will continue.
-
-                if(this->offset_explored[offset] || this->label_offsets.count(offset))
-                    break;
-            }
+            // skip until a label offset or a explored offset is found.
+            //
+            // if a label offset is found, it'll be added at the beggining of the outer for loop,
+            // and then (maybe) this unexplored area will continue.
+            auto begin_offset = offset;
+            offset = std::min(this->offset_explored.find_next_either(this->label_offsets, offset + 1), bf.size);
 
             output.emplace_back(begin_offset, std::vector<uint8_t>(bf.bytes + begin_offset, bf.bytes + offset));
         }
     }
+
+    this->build_index();
 }
 
 optional<DecompiledScmHeader> DecompiledScmHeader::from_bytecode(const void* bytecode, size_t bytecode_size, Version version)
@@ -690,7 +888,7 @@ optional<DecompiledScmHeader> DecompiledScmHeader::from_bytecode(const void* byt
             for(size_t i = 0; i < num_scripts; ++i)
             {
                 char buffer[24];
-                auto name = bf.fetch_chars(seg4_offset + 8 + 4 + 4 + (28 * i), 20, buffer).value();
+                bf.fetch_chars(seg4_offset + 8 + 4 + 4 + (28 * i), 20, buffer).value();
                 auto size = bf.fetch_u32(seg4_offset + 8 + 4 + 4 + (28 * i) + 20 + 4).value();
                 streamed_scripts.emplace_back(StreamedScript { buffer, size });
             }
@@ -788,3 +986,42 @@ auto streamed_scripts_fetcher(const void* img_bytes_, size_t img_size, const Dec
 
     return scripts;
 }
+
+void Disassembler::report_memory(MemoryReport& report, const string_view& segment_name) const
+{
+    size_t data_bytes = MemoryReport::bytes_of(this->decompiled);
+    for(auto& data : this->decompiled)
+    {
+        if(is<DecompiledCommand>(data.data))
+        {
+            auto& ccmd = get<DecompiledCommand>(data.data);
+            data_bytes += MemoryReport::bytes_of(ccmd.args);
+            for(auto& arg : ccmd.args)
+            {
+                if(is<DecompiledString>(arg))
+                    data_bytes += MemoryReport::bytes_of(get<DecompiledString>(arg).storage);
+            }
+        }
+        else if(is<DecompiledHex>(data.data))
+        {
+            data_bytes += MemoryReport::bytes_of(get<DecompiledHex>(data.data).data);
+        }
+    }
+
+    auto bitset_bytes = [](const dynamic_bitset& bitset) {
+        return (bitset.size() + CHAR_BIT - 1) / CHAR_BIT;
+    };
+
+    size_t analysis_bytes = bitset_bytes(this->label_offsets) + bitset_bytes(this->offset_explored)
+                          + bitset_bytes(this->offset_queued) + MemoryReport::bytes_of(this->to_explore)
+                          + MemoryReport::bytes_of(this->main_branch_targets);
+
+    size_t index_bytes = MemoryReport::bytes_of(this->decompiled_offsets) + MemoryReport::bytes_of(this->xrefs_by_source)
+                       + MemoryReport::bytes_of(this->xrefs_by_target);
+
+    report.add(segment_name, "decoded instructions", this->decoded.size(),
+               MemoryReport::bytes_of(this->decoded) + MemoryReport::bytes_of(this->decoded_args));
+    report.add(segment_name, "analysis state", 1, analysis_bytes);
+    report.add(segment_name, "decompiled data", this->decompiled.size(), data_bytes);
+    report.add(segment_name, "data indices", this->decompiled_offsets.size(), index_bytes);
+}
@@ -73,6 +73,14 @@ struct DecompiledHex
     std::vector<uint8_t> data;
 };
 
+/// Branch from a command into a label, as found in the label arguments of the disassembled commands.
+struct DecompiledXref
+{
+    size_t source;      //< Local offset of the branching command.
+    size_t target;      //< Offset of the label branched into.
+    bool   to_main;     //< Whether `target` is a offset in the main code segment instead of a local offset.
+};
+
 // contrasts to CompiledScmHeader
 struct DecompiledScmHeader
 {
@@ -138,6 +146,54 @@ std::vector<BinaryFetcher> mission_scripts_fetcher(const void* bytecode, size_t
 std::vector<BinaryFetcher> streamed_scripts_fetcher(const void* img_bytes, size_t img_size,
                                                     const DecompiledScmHeader& header, ProgramContext& program);
 
+/// Layout of the arguments of a command, precomputed from its definition so that the
+/// disassembler doesn't need to interpret the definition for every instruction.
+struct CommandLayout
+{
+    enum class ArgKind : uint8_t
+    {
+        Value,          //< Any argument with a data type prefix.
+        Label,          //< Label argument, whose immediate value is a branch target.
+        TextLabel,      //< Text label, which lacks the data type prefix in III/VC.
+        String,         //< String, which may be a variable length string in III/VC with CLEO.
+        String128,      //< Group of four TEXT_LABEL32 arguments, a 128 bytes string without data type.
+    };
+
+    const Command&              command;
+    small_vector<ArgKind, 12>   args;           //< Fixed arguments.
+    optional<ArgKind>           variadic;       //< Kind of the arguments repeated until a EOA, if any.
+    bool                        decodable;      //< Whether the command definition can be disassembled at all.
+    bool                        is_switch_start;
+    bool                        is_switch_continued;
+    bool                        is_terminator;  //< Does not proceed to the next instruction (e.g. GOTO, RETURN).
+
+    explicit CommandLayout(const Command& command, const Commands& commands);
+
+    /// \returns the kind of the decoded argument `i`, or nullopt if the command takes no such argument.
+    optional<ArgKind> arg_kind(size_t i) const
+    {
+        return i < this->args.size()? optional<ArgKind>(this->args[i]) : this->variadic;
+    }
+};
+
+/// Table of `CommandLayout`s indexed by opcode.
+class CommandLayoutTable
+{
+public:
+    explicit CommandLayoutTable(const Commands& commands);
+
+    /// Finds the layout of the command of id `pureid` (i.e. opcode without the not flag).
+    const CommandLayout* find(uint16_t pureid) const
+    {
+        auto index = this->by_opcode[pureid & 0x7FFF];
+        return index? &this->layouts[index - 1] : nullptr;
+    }
+
+private:
+    std::vector<CommandLayout> layouts;
+    std::vector<uint32_t>      by_opcode;   //< Index in `layouts` plus one, or zero if unknown.
+};
+
 ///
 class Disassembler
 {
@@ -154,14 +210,50 @@ private:
     /// Bytecode being analyzed.
     BinaryFetcher       bf;
 
-    /// The local offset of the labels in the analyzed bytecode.
-    std::set<size_t>    label_offsets;
+    /// A bitset of the local offsets which are labels in the analyzed bytecode.
+    dynamic_bitset      label_offsets;
 
     /// A bitset of the offsets explored and unexplored. Explored offsets are confirmed to be code.
     dynamic_bitset      offset_explored;
 
     /// LIFO structure of offsets [mostly confirmed to be code] which still needs to be explored.
-    std::stack<size_t>  to_explore;
+    /// Use `push_explore` to add offsets into it, so that it does not contain duplicates.
+    std::vector<size_t> to_explore;
+
+    /// A bitset of the offsets currently in `to_explore`.
+    dynamic_bitset      offset_queued;
+
+    /// Argument of a explored instruction, already validated.
+    struct DecodedArg
+    {
+        uint8_t  datatype;  //< Data type of the argument, or a pseudo data type for arguments without one.
+        uint32_t offset;    //< Local offset of the argument data (i.e. after the data type).
+    };
+
+    /// Instruction successfully explored.
+    struct DecodedInstruction
+    {
+        uint32_t             offset;    //< Local offset of the instruction.
+        uint32_t             size;      //< Size of the instruction in bytes.
+        uint32_t             first_arg; //< Index of the first argument in `decoded_args`.
+        uint32_t             num_args;
+        bool                 not_flag;
+        const CommandLayout* layout;
+    };
+
+    /// The instructions found during exploration (in the exploration order) and their arguments.
+    /// Used by `disassembly` to build the output without decoding the instructions once again.
+    std::vector<DecodedInstruction> decoded;
+    std::vector<DecodedArg>         decoded_args;
+
+    /// Layout of the commands, shared by all the segments.
+    shared_ptr<const CommandLayoutTable> layouts;
+
+    /// Offsets in the main code segment branched to by this (non-main) segment.
+    ///
+    /// Those are kept privately so that segments can be analyzed concurrently. The main segment
+    /// takes them by the means of `merge_branch_targets` before running its own analyzer.
+    std::vector<size_t> main_branch_targets;
 
     /// A hint (for efficient memory allocation) of how many opcodes are in the analyzed bytecode.
     std::size_t         hint_num_ops = 0;
@@ -179,21 +271,23 @@ private:
     /// The result of disassemblying.
     std::vector<DecompiledData> decompiled;
 
+    /// Local offset of each element of `decompiled`, for binary searching.
+    std::vector<uint32_t> decompiled_offsets;
+
+    /// Branches found in `decompiled`, sorted by source and by target respectively.
+    std::vector<DecompiledXref> xrefs_by_source;
+    std::vector<DecompiledXref> xrefs_by_target;
+
     /// OATC header information
-    optional<uint16_t> oatc_start;          //< Starting opcode.
-    std::vector<const Command*> oatc_table; //< Commands associated with ordinal ids. May contain `nullptr` for unknown commmands.
+    optional<uint16_t> oatc_start;                  //< Starting opcode.
+    std::vector<optional<CommandLayout>> oatc_table;//< Commands associated with ordinal ids. May contain `nullopt` for unknown commmands.
 
 public:
     /// Constructs assuming `main_asm` to be the main code segment.
     ///
     /// \warning It's undefined what happens with the analyzer if data inside `fetcher.bytecode` is changed while
     /// \warning this Disassembler object is still alive.
-    Disassembler(ProgramContext& program, BinaryFetcher fetcher, Disassembler& main_asm, Type type) :
-        bf(std::move(fetcher)), program(program), main_asm(main_asm), type(type)
-    {
-        // This constructor **ALWAYS** run, put all common initialization here.
-        this->offset_explored.resize(bf.size);
-    }
+    Disassembler(ProgramContext& program, BinaryFetcher fetcher, Disassembler& main_asm, Type type);
 
     /// Constructs assuming `*this` to be the main code segment.
     ///
@@ -213,8 +307,19 @@ public:
     bool is_main_segment() const { return this == &main_asm; }
 
     /// Step 1. Analyze the code.
+    ///
+    /// The analyzer of non-main segments may run concurrently, as long as each has its own `ProgramContext`.
+    /// The main segment analyzer must run after all the `segment`s branch targets have been merged into it.
     void run_analyzer(size_t from_offset = 0);
 
+    /// Takes the branches from `segment` into the main code segment (i.e. `*this`).
+    void merge_branch_targets(const Disassembler& segment);
+
+    /// Same as `run_analyzer`, but only analyzes the code reachable from the branch targets merged so far.
+    ///
+    /// This is only meaningful on a recursive traversal of the main segment. Custom headers aren't parsed.
+    void run_analyzer_on_branch_targets();
+
     /// Step 2. After analyzes, disassembly into a vector of pseudo-instructions.
     void disassembly(size_t from_offset = 0);
 
@@ -224,15 +329,42 @@ public:
     std::vector<DecompiledData> get_data() &&               { return std::move(this->decompiled); }
 
     /// After Step 3. the following is available also.
+    /// Those indices are built by `disassembly`, and are not updated if the data from `get_data` is modified.
+    using xref_iterator = std::vector<DecompiledXref>::const_iterator;
+
     /// Gets index on get_data() vector based on a local offset.
+    /// If a label and a command are both at `local_offset`, the index of the label is returned.
     optional<size_t> data_index(uint32_t local_offset) const;
 
+    /// Gets all the branches in this segment, sorted by source offset.
+    const std::vector<DecompiledXref>& get_xrefs() const { return this->xrefs_by_source; }
+
+    /// Gets the branches made by the command at the local offset `source`.
+    std::pair<xref_iterator, xref_iterator> xrefs_from(size_t source) const;
+
+    /// Gets the branches in this segment into `target`, which is a local offset,
+    /// or a offset in the main code segment if `to_main` is set.
+    std::pair<xref_iterator, xref_iterator> xrefs_to(size_t target, bool to_main = false) const;
+
+    /// Accounts the memory taken by the analysis and the output of this segment into `report`,
+    /// on behalf of `segment_name`.
+    void report_memory(MemoryReport& report, const string_view& segment_name) const;
+
 private:
 
     void analyze();
 
     void explore(size_t offset);
 
+    /// Builds the offset and branch indices of `decompiled`.
+    void build_index();
+
+    /// Pushes `offset` into the exploration stack, unless it's already explored or in the stack.
+    void push_explore(size_t offset);
+
+    /// Marks `offset` as a label. Offsets outside the bytecode are ignored.
+    void add_label(size_t offset);
+
     /// Attempts to skip a custom header at `offset`.
     /// \returns the offset after the header or `nullopt` if no custom header at `offset`.
     optional<size_t> skip_custom_header(size_t offset) const;
@@ -241,20 +373,31 @@ private:
     /// Expects the header at `offset` to exist.
     void parse_custom_header(size_t offset, size_t end_offset);
 
-    /// Tries to explore the `offset` assuming it contains the specified `command`.
+    /// Tries to explore the `offset` assuming it contains a command of the specified `layout`.
     ///
     /// Returns the number of bytes explored (the size of the compiled command),
     /// or `nullopt` if impossible to explore this opcode.
-    optional<size_t> explore_opcode(size_t offset, const Command& command, bool not_flag);
+    optional<size_t> explore_opcode(size_t offset, const CommandLayout& layout, bool not_flag);
 
-    /// Returns a `DecompiledData` containing a `DecompiledCommand` by interpreting `offset`.
+    /// Validates the arguments of the instruction at `op_offset` of the specified `layout`, pushing them into `args`.
     ///
-    /// The `offset` **must** have been successfully explored previosly by `explore_opcode`.
-    /// For this reason, this call never fails.
-    DecompiledData opcode_to_data(size_t& offset);
+    /// `on_imm32(value, kind, argument_id)` is called for each integer argument.
+    ///
+    /// Returns the offset after the instruction, or `nullopt` if the instruction is ill-formed.
+    template<typename OnImm32>
+    optional<size_t> decode_args(size_t op_offset, const CommandLayout& layout,
+                                 std::vector<DecodedArg>& args, OnImm32 on_imm32) const;
+
+    /// Returns a `DecompiledData` containing a `DecompiledCommand` built from the decoded `args`.
+    DecompiledData args_to_data(size_t offset, const CommandLayout& layout, bool not_flag,
+                                const DecodedArg* args_begin, const DecodedArg* args_end) const;
+
+    /// Returns a `DecompiledData` by interpreting `offset`, which wasn't recorded as the start of a explored
+    /// instruction (i.e. it's in the middle of one). If no instruction can be decoded there, a byte of hex is returned.
+    DecompiledData opcode_to_data(size_t& offset) const;
 
-    /// Gets the command from the opcode id, either using the OATC table or the normal opcode lookup.
-    optional<const Command&> command_from_opcode(uint16_t opcode) const;
+    /// Gets the command layout from the opcode id, either using the OATC table or the normal opcode lookup.
+    const CommandLayout* layout_from_opcode(uint16_t opcode) const;
 };
 
 
@@ -1,14 +1,30 @@
 #include <stdinc.h>
 #include "program.hpp"
+#include "cmdline.hpp"
 #include "system.hpp"
-#include "cpp/argv.hpp"
+#include "cpp/parallel.hpp"
+#include <mutex>
 
 const char* GTA3SC_HELP_MESSAGE =
 R"(Usage: gta3sc [compile|decompile] --config=<name> file [options]
+       gta3sc [compile|decompile] --batch --config=<name> <dir-or-list> [options]
 Options:
   --help                   Display this information.
   --version                Displays version information.
   -o <file>                Place the output into <file>.
+  --batch                  Compiles (or decompiles) every script in the input
+                           directory, or every script in the input list file,
+                           in parallel. When no action is given, it's inferred
+                           from the extension of each script, and compilations
+                           run before decompilations. Outputs of compilations
+                           in the directory aren't decompiled.
+                           Each line of the list is a input file optionally
+                           followed by options specific to it. The outputs are
+                           placed alongside their inputs.
+  -j <n>                   Number of parallel jobs when in batch mode, or of
+                           scripts analyzed in parallel by the decompiler.
+                           Defaults to the number of hardware threads.
+  --jobs=<n>               Ditto.
   --cs                     Outputs a CLEO script. This also sets -fcleo.
   --cm                     Outputs a CLEO custom mission.
                            This also sets -fcleo and -fmission-script.
@@ -19,6 +35,8 @@ Options:
                            The compiler will still try to behave properly
                            without this, but this is still recommended.
   --levelfile=<name>       Name of the level data file in the data directory.
+  --models-cache=<file>    Caches the models read from the data directory in
+                           <file>, reusing it while the data files are unchanged.
   --add-config=<path>      Adds an additional XML definition file.
                            If the path is not absolute or starts with './' or
                            '../', uses a path relative to 'config/<name>/'.
@@ -30,11 +48,38 @@ Options:
   --define=<name>          Ditto.
   -U <name>                Undefines the preprocessor directive <name>.
   --undefine=<name>        Ditto.
-  -O                       Enables optimizations.
+  -O<level>                Sets the optimization level: -O0 disables every
+                           optimization, -O1 (or -O) enables the ones which
+                           are always a win, -O2 also trades code size for
+                           speed, and -Os favours code size instead. Flags
+                           given after it override the level.
+                           Note -O1 removes unreachable code, threads jumps
+                           and renumbers local variables, so any dead code
+                           triggers -Wunreachable-code (an error along with
+                           -Werror unless -Wno-unreachable-code is given).
   -emit-ir2                Emits a explicit IR based on Sanny Builder syntax.
+  --emit-bir               Emits the same IR in a binary format (BIR), which
+                           can be memory-mapped and read without parsing. BIR
+                           inputs are decompiled into IR2.
   -fsyntax-only            Only checks the syntax, i.e. doesn't generate code.
   --recursive-traversal    Disassembler scans the code by the means of a
                            recursive traversal instead of linear-sweep.
+  --emit-xrefs             When decompiling, also writes the branches into each
+                           label to a '.xrefs' file next to the output.
+  --only-mission=<n>       When decompiling, analyzes and outputs only the
+                           mission <n> and the code of the main segment that
+                           it branches into.
+  --only-stream=<name>     Same as --only-mission but for a streamed script.
+  --range=<begin>:<end>    When decompiling, outputs only the local offsets in
+                           this range of the selected mission or streamed
+                           script, or of the main segment if none is selected.
+  -ftime-report            Prints the time taken by each phase and by each
+                           script.
+  -ftime-trace=<file>      Writes the timing of each phase into <file>, in the
+                           Chrome trace event format.
+  -fmem-report             Prints the peak memory usage of each phase and the
+                           memory taken by the data structures of each script.
+  -fopt-stats              Prints what each optimization pass did.
   --expect-var=<info>
 
 Language Options:
@@ -76,6 +121,41 @@ Machine Options:
   -moptimize-zero          Compiles 0.0 as 0, using a 8 bit data type.
   -moatc                   Uses the Custom Commands Header whenever possible.
 
+Optimization Options:
+  -frotate-loops           Tests the condition of WHILE loops at the bottom of
+                           each iteration, jumping into such test when
+                           entering the loop.
+  -fswitch-tree            Lowers large SWITCH statements into a binary search
+                           over the sorted CASE values, when SWITCH_START is
+                           not supported by the game.
+  -fshort-circuit          Tests the conditions of AND/OR lists one at a time,
+                           cheapest first, skipping the remaining ones as soon
+                           as the outcome is known. Only applies when every
+                           condition is free of side effects.
+  -finline-gosub[=<size>]  Replaces the GOSUBs into subroutines taking at most
+                           <size> bytes (32 by default) by a copy of the
+                           subroutine, as long as the script grows by at most
+                           a quarter of its size (or <size> bytes). Trades
+                           code size for speed.
+  -fremove-unreachable-code Removes code which is never executed, such as
+                            commands after a GOTO and subroutines which are
+                            never called.
+  -ffold-identical-code    Replaces sequences of commands identical to the end
+                           of another sequence by a GOTO into it. Trades speed
+                           for code size.
+  -fthread-jumps           Branches straight into the final destination of a
+                           chain of GOTOs, and replaces GOTOs into a RETURN or
+                           TERMINATE_THIS_SCRIPT by such command.
+  -fremove-redundant-goto  Removes GOTOs into the instruction right after them.
+  -fshare-local-vars       Lets local variables never alive at the same time
+                           share the same index, reducing the local variables
+                           needed by each script (and mission).
+  -fcompact-global-vars    Removes the global variables never used or never
+                           read, and renumbers the remaining ones densely. The
+                           variables given by --expect-var stay in place. Not
+                           enabled by any -O level, since it changes the
+                           layout of the global variables.
+
 Error Message Options:
   --error-format=<format>  The error formating for the compiler errors.
                            May be `default` or `json`. Do note the JSON format
@@ -86,6 +166,10 @@ Error Message Options:
                             names.
   -Wexpect-var             Warns if any of the variables specified with
                            the --expect-var option is out of place.
+  -Wunreachable-code       Warns about the code removed by
+                           -fremove-unreachable-code.
+  -Wunused-global-var      Warns about global variables never used or never
+                           read by any script.
   -fconstant-checks        Checks whether variables collides with constants.
 )";
 
@@ -108,319 +192,229 @@ enum class Action
     QueryModels,
 };
 
-
-struct DataInfo
+struct BatchJob
 {
-    fs::path    datadir;
-    std::string levelfile;
+    Action   action;
+    fs::path input;
+    fs::path output;
+    Options  options;
 };
 
-struct ConfigInfo
+/// Infers whether `input` should be compiled or decompiled from its extension.
+/// Returns `Action::None` if it cannot be inferred.
+Action infer_action(const fs::path& input)
 {
-    std::string           config_name;
-    std::vector<fs::path> add_config_files;
-};
+    std::string extension = input.extension().string();
+    if(iequal_to()(extension, ".sc"))
+        return Action::Compile;
+    else if(iequal_to()(extension, ".scm"))
+        return Action::Decompile;
+    else if(iequal_to()(extension, ".scc"))
+        return Action::Decompile;
+    else if(iequal_to()(extension, ".cs"))
+        return Action::Decompile;
+    else if(iequal_to()(extension, ".cm"))
+        return Action::Decompile;
+    else if(iequal_to()(extension, ".bir"))
+        return Action::Decompile;
+    else
+        return Action::None;
+}
 
-bool parse_args(char**& argv, fs::path& input, fs::path& output, DataInfo& data, ConfigInfo& conf, Options& options)
+/// Reads the jobs of a batch from `batch_input`, which is either a directory or a list file.
+/// If `action` is `Action::None`, the action of each job is inferred from its input extension.
+///
+/// Every line of a list file contains a input file followed by the options specific to it (which
+/// are applied on top of `base_options`). Relative paths are relative to the list directory.
+bool read_batch_jobs(Action action, const fs::path& batch_input, const Options& base_options, std::vector<BatchJob>& jobs)
 {
-    try
-    {
-        bool flag;
-        int32_t temp_i32;
+    std::error_code ec;
 
-        while(*argv)
+    if(fs::is_directory(batch_input, ec))
+    {
+        for(auto& entry : fs::directory_iterator(batch_input))
         {
-            if(**argv != '-')
-            {
-                if(!input.empty())
-                {
-                    fprintf(stderr, "gta3sc: error: input file appears twice\n");
-                    return false;
-                }
-
-                input = *argv;
-                ++argv;
-            }
-            else if(optget(argv, "-h", "--help", 0))
-            {
-                options.help = true;
-                return true;
-            }
-            else if(optget(argv, nullptr, "--version", 0))
-            {
-                options.version = true;
-                return true;
-            }
-            else if(const char* o = optget(argv, "-o", nullptr, 1))
-            {
-                output = o;
-            }
-            else if(optget(argv, nullptr, "-pedantic-errors", 0))
-            {
-                options.pedantic = true;
-                options.pedantic_errors = true;
-            }
-            else if(optget(argv, nullptr, "-pedantic", 0))
-            {
-                options.pedantic = true;
-            }
-            else if(optget(argv, nullptr, "--guesser", 0))
-            {
-                options.guesser = true;
-            }
-            else if(const char* info = optget(argv, nullptr, "--expect-var", 1))
-            {
-                if(!options.push_expect_var(info))
-                {
-                    fprintf(stderr, "gta3sc: error: failed to parse --expect-var entry\n");
-                    return false;
-                }
-            }
-            else if(optget(argv, nullptr, "--recursive-traversal", 0))
+            auto& path = entry.path();
+            auto file_action = infer_action(path);
+            if(fs::is_regular_file(entry.status()) && file_action != Action::None
+            && (action == Action::None || action == file_action))
             {
-                options.linear_sweep = false;
+                jobs.push_back(BatchJob { file_action, path, fs::path(), base_options });
             }
-            else if(const char* name = optget(argv, nullptr, "--config", 1))
-            {
-                // avoid infinite recursion of parse_args(...) calls
-                if(iequal_to()(conf.config_name, name))
-                    continue;
-
-                conf.config_name = name;
+        }
 
-                if(auto opt_cmdline = read_file_utf8(config_path() / conf.config_name / "commandline.txt"))
-                {
-                    auto& cmdline = *opt_cmdline;
-                    small_vector<char*, 128> args;
-
-                    auto it = !cmdline.empty()? &cmdline[0] : nullptr;
-                    auto end = it + cmdline.size();
-                    for(; it != end; )
-                    {
-                        it = std::find_if_not(it, end, ::isspace);
-                        args.emplace_back(it);
-                        it = std::find_if(it, end, ::isspace);
-                        if(it != end) *it++ = '\0';
-                    }
-                    args.emplace_back(nullptr);
-
-                    char** argv2 = args.data();
-                    if(!parse_args(argv2, input, output, data, conf, options))
-                        return false;
-                }
-                else
-                {
-                    fprintf(stderr, "gta3sc: error: config path is missing commandline.txt file\n");
-                    return false;
-                }
-            }
-            else if(const char* path = optget(argv, nullptr, "--add-config", 1))
-            {
-                conf.add_config_files.emplace_back(path);
-            }
-            else if(const char* path = optget(argv, nullptr, "--datadir", 1))
-            {
-                data.datadir = path;
-            }
-            else if(const char* name = optget(argv, nullptr, "--levelfile", 1))
-            {
-                data.levelfile = name;
-            }
-            else if(const char* name = optget(argv, nullptr, "--error-format", 1))
-            {
-                if(!strcmp(name, "default"))
-                    options.error_format = Options::ErrorFormat::Default;
-                else if(!strcmp(name, "json"))
-                    options.error_format = Options::ErrorFormat::JSON;
-                else
-                {
-                    fprintf(stderr, "gta3sc: error: invalid error-format\n");
-                    return false;
-                }
-            }
-            else if(const char* ver = optget(argv, nullptr, "-mheader", 1))
-            {
-                if(!strcmp(ver, "gta3"))
-                    options.header = Options::HeaderVersion::GTA3;
-                else if(!strcmp(ver, "gtavc"))
-                    options.header = Options::HeaderVersion::GTAVC;
-                else if(!strcmp(ver, "gtasa"))
-                    options.header = Options::HeaderVersion::GTASA;
-                else
-                {
-                    fprintf(stderr, "gta3sc: error: invalid header version, must be 'gta3', 'gtavc' or 'gtasa'\n");
-                    return false;
-                }
-            }
-            else if(optflag(argv, "-mno-header", nullptr))
-            {
-                options.headerless = true;
-            }
-            else if(optflag(argv, "-moatc", &flag))
-            {
-                options.oatc = flag;
-            }
-            else if(optflag(argv, "-mq11.4", &flag))
-            {
-                options.use_half_float = flag;
-            }
-            else if(optflag(argv, "-mtyped-text-label", &flag))
-            {
-                options.has_text_label_prefix = flag;
-            }
-            else if(optflag(argv, "-moptimize-andor", &flag))
-            {
-                options.optimize_andor = flag;
-            }
-            else if(optflag(argv, "-moptimize-zero", &flag))
-            {
-                options.optimize_zero_floats = flag;
-            }
-            else if(optget(argv, nullptr, "-O", 0))
-            {
-                options.optimize_andor = true;
-                options.optimize_zero_floats = true;
-            }
-            else if(optflag(argv, "-fentity-tracking", &flag))
-            {
-                options.entity_tracking = flag;
-            }
-            else if(optflag(argv, "-fscript-name-check", &flag))
-            {
-                options.script_name_check = flag;
-            }
-            else if(optflag(argv, "-frelax-not", &flag))
-            {
-                options.relax_not = flag;
-            }
-            else if(optflag(argv, "-fswitch", &flag))
-            {
-                options.fswitch = flag;
-            }
-            else if(optflag(argv, "-fbreak-continue", nullptr))
-            {
-                options.allow_break_continue = true;
-            }
-            else if(optflag(argv, "-fscope-then-label", &flag))
-            {
-                options.scope_then_label = flag;
-            }
-            else if(optflag(argv, "-funderscore-idents", &flag))
-            {
-                options.allow_underscore_identifiers = flag;
-            }
-            else if(optflag(argv, "-farrays", &flag))
-            {
-                options.farrays = flag;
-            }
-            else if(optflag(argv, "-fconst", &flag))
-            {
-                options.fconst = flag;
-            }
-            else if(optflag(argv, "-fstreamed-scripts", &flag))
-            {
-                options.streamed_scripts = flag;
-            }
-            else if(optflag(argv, "-ftext-label-vars", &flag))
-            {
-                options.text_label_vars = flag;
-            }
-            else if(optflag(argv, "-fskip-cutscene", &flag))
-            {
-                options.skip_cutscene = flag;
-            }
-            else if(optflag(argv, "-mlocal-offsets", nullptr))
-            {
-                options.use_local_offsets = true;
-            }
-            else if(optint(argv, "-ftimer-index", &options.timer_index)) {}
-            else if(optint(argv, "-flocal-var-limit", &options.local_var_limit)) {}
-            else if(optint(argv, "-fmission-var-limit", &temp_i32))
-            {
-                options.mission_var_limit = temp_i32 < 0? nullopt : optional<uint32_t>(temp_i32);
-            }
-            else if(optint(argv, "-fmission-var-begin", &temp_i32))
-            {
-                options.mission_var_begin = std::max(0, temp_i32);
-            }
-            else if(optint(argv, "-fswitch-case-limit", &temp_i32))
-            {
-                options.switch_case_limit = temp_i32 < 0? nullopt : optional<uint32_t>(temp_i32);
-            }
-            else if(optint(argv, "-farray-elem-limit", &temp_i32))
-            {
-                options.array_elem_limit = temp_i32 < 0? nullopt : optional<uint32_t>(temp_i32);
-            }
-            else if(optflag(argv, "-fsyntax-only", nullptr))
-            {
-                options.fsyntax_only = true;
-            }
-            else if(optflag(argv, "-emit-ir2", nullptr))
-            {
-                options.emit_ir2 = true;
-            }
-            else if(optflag(argv, "-fcleo", nullptr))
-            {
-                options.cleo.emplace(0);
-            }
-            else if(optget(argv, nullptr, "--cs", 0))
-            {
-                options.cleo.emplace(0);
-                options.output_cleo = true;
-                options.mission_script = false;
-                options.headerless = true;
-                options.use_local_offsets = true;
-            }
-            else if(optget(argv, nullptr, "--cm", 0))
-            {
-                options.cleo.emplace(0);
-                options.output_cleo = true;
-                options.mission_script = true;
-                options.headerless = true;
-                options.use_local_offsets = true;
-            }
-            else if(optflag(argv, "-fmission-script", nullptr))
-            {
-                options.mission_script = true;
-            }
-            else if(optflag(argv, "-Werror", &flag))
-            {
-                options.warning_is_error = flag;
-            }
-            else if(optflag(argv, "-Wconflict-text-label-var", &flag))
-            {
-                options.warn_conflict_text_label_var = flag;
-            }
-            else if(optflag(argv, "-Wexpect-var", &flag))
-            {
-                options.warn_expect_var = flag;
-            }
-            else if(optflag(argv, "-fconstant-checks", &flag))
-            {
-                options.constant_checks = flag;
-            }
-            else if(const char* name = optget(argv, "-D", "--define", 1))
-            {
-                options.define(name);
-            }
-            else if(const char* name = optget(argv, "-U", "--undefine", 1))
-            {
-                options.undefine(name);
-            }
-            else
-            {
-                fprintf(stderr, "gta3sc: error: unregonized argument '%s'\n", *argv);
-                return false;
-            }
+        // Outputs of the compilations of this batch are not inputs of it, even if they existed beforehand.
+        std::set<fs::path> outputs;
+        for(auto& job : jobs)
+        {
+            if(job.action == Action::Compile)
+                outputs.emplace(default_compile_output(job.input, job.options));
         }
 
+        jobs.erase(std::remove_if(jobs.begin(), jobs.end(), [&](const BatchJob& job) {
+            return job.action == Action::Decompile && outputs.count(job.input);
+        }), jobs.end());
+
+        std::sort(jobs.begin(), jobs.end(), [](const BatchJob& a, const BatchJob& b) {
+            return a.input < b.input;
+        });
+
         return true;
     }
-    catch(const invalid_opt& e)
+
+    auto opt_list = read_file_utf8(batch_input);
+    if(!opt_list)
     {
-        fprintf(stderr, "gta3sc: error: %s\n", e.what());
+        fprintf(stderr, "gta3sc: error: could not read batch list '%s'\n", batch_input.generic_u8string().c_str());
         return false;
     }
+
+    auto& list = *opt_list;
+    auto list_dir = batch_input.parent_path();
+
+    size_t lineno = 0;
+    for(auto it = list.begin(); it != list.end(); )
+    {
+        auto line_end = std::find(it, list.end(), '\n');
+        auto line = std::string(it, line_end);
+        it = (line_end != list.end()? line_end + 1 : line_end);
+        ++lineno;
+
+        small_vector<char*, 32> args;
+        for(auto arg = line.begin(); ; )
+        {
+            arg = std::find_if_not(arg, line.end(), ::isspace);
+            if(arg == line.end() || *arg == '#')
+                break;
+            args.emplace_back(&*arg);
+            arg = std::find_if(arg, line.end(), ::isspace);
+            if(arg != line.end()) *arg++ = '\0';
+        }
+
+        if(args.empty())
+            continue;
+
+        args.emplace_back(nullptr);
+
+        BatchJob job { action, fs::path(), fs::path(), base_options };
+        DataInfo job_data;
+        ConfigInfo job_conf;
+
+        char** argv = args.data();
+        if(!parse_args(argv, job.input, job.output, job_data, job_conf, job.options) || !check_options(job.options))
+        {
+            fprintf(stderr, "gta3sc: note: in batch list '%s' at line %u\n", batch_input.generic_u8string().c_str(), unsigned(lineno));
+            return false;
+        }
+
+        // Every job shares the same configuration (i.e. Commands), thus options changing it are not allowed.
+        if(!job_data.datadir.empty() || !job_data.levelfile.empty() || !job_data.models_cache.empty()
+        || !job_conf.config_name.empty() || !job_conf.add_config_files.empty()
+        || job.options.cleo != base_options.cleo
+        || job.options.time_report != base_options.time_report || job.options.time_trace != base_options.time_trace
+        || job.options.mem_report != base_options.mem_report || job.options.opt_stats != base_options.opt_stats
+        || job.options.help || job.options.version || job.options.batch != base_options.batch)
+        {
+            fprintf(stderr, "gta3sc: error: batch list '%s' at line %u changes the configuration of the batch\n",
+                            batch_input.generic_u8string().c_str(), unsigned(lineno));
+            return false;
+        }
+
+        if(job.input.empty())
+        {
+            fprintf(stderr, "gta3sc: error: batch list '%s' at line %u has no input file\n",
+                            batch_input.generic_u8string().c_str(), unsigned(lineno));
+            return false;
+        }
+
+        if(job.action == Action::None)
+            job.action = infer_action(job.input);
+
+        if(job.action == Action::None)
+        {
+            fprintf(stderr, "gta3sc: error: batch list '%s' at line %u: could not infer action from input extension (compile/decompile)\n",
+                            batch_input.generic_u8string().c_str(), unsigned(lineno));
+            return false;
+        }
+
+        if(job.input.is_relative())
+            job.input = list_dir / job.input;
+        if(!job.output.empty() && job.output != "-" && job.output.is_relative())
+            job.output = list_dir / job.output;
+
+        jobs.emplace_back(std::move(job));
+    }
+
+    return true;
+}
+
+/// Compiles or decompiles every script given by `batch_input` in parallel, sharing the configuration of `program`.
+///
+/// Every compilation finishes before any decompilation starts, so that no decompilation reads a file while it's
+/// being written by a compilation of the same batch.
+int run_batch(Action action, const fs::path& batch_input, const ProgramContext& program)
+{
+    std::vector<BatchJob> jobs;
+    if(!read_batch_jobs(action, batch_input, program.opt, jobs))
+        return EXIT_FAILURE;
+
+    std::vector<std::string> logs(jobs.size());
+    std::vector<char> completed(jobs.size(), false);
+    std::atomic<size_t> num_failures {0};
+
+    std::mutex log_mutex;
+    size_t next_log = 0;
+
+    std::vector<size_t> compile_jobs, decompile_jobs;
+    for(size_t i = 0; i < jobs.size(); ++i)
+    {
+        if(jobs[i].action == Action::Compile)
+            compile_jobs.emplace_back(i);
+        else
+            decompile_jobs.emplace_back(i);
+    }
+
+    auto run_job = [&](size_t i)
+    {
+        auto& job = jobs[i];
+        auto& log = logs[i];
+
+        {
+            ProgramContext job_program(program, std::move(job.options), [&log](const std::string& msg) {
+                log += msg;
+                log += '\n';
+            });
+
+            bool succeeded = (job.action == Action::Compile? compile_file(job.input, job.output, job_program) :
+                                                             decompile_file(job.input, job.output, job_program));
+            if(!succeeded)
+            {
+                log += fmt::format("gta3sc: {} of '{}' failed\n", job.action == Action::Compile? "compilation" : "decompilation",
+                                                                   job.input.generic_u8string());
+                ++num_failures;
+            }
+        }
+
+        // Flush the messages in the order of the jobs, so that the output is deterministic.
+        std::lock_guard<std::mutex> lock(log_mutex);
+        completed[i] = true;
+        for(; next_log < jobs.size() && completed[next_log]; ++next_log)
+        {
+            fwrite(logs[next_log].data(), 1, logs[next_log].size(), stderr);
+            std::string().swap(logs[next_log]);
+        }
+    };
+
+    parallel_for(compile_jobs.size(), program.opt.num_jobs, [&](size_t k) { run_job(compile_jobs[k]); });
+    parallel_for(decompile_jobs.size(), program.opt.num_jobs, [&](size_t k) { run_job(decompile_jobs[k]); });
+
+    if(num_failures != 0)
+    {
+        fprintf(stderr, "gta3sc: %u of %u batch jobs failed\n", unsigned(num_failures), unsigned(jobs.size()));
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
 }
 
 int main(int argc, char** argv)
@@ -434,8 +428,8 @@ int main(int argc, char** argv)
     DataInfo data;
 
     optional<ProgramContext> program; // delay construction of ProgramContext
-    std::map<std::string, uint32_t, iless> default_models;
-    std::map<std::string, uint32_t, iless> level_models;
+    ModelTable default_models;
+    ModelTable level_models;
 
     ++argv;
 
@@ -494,20 +488,11 @@ int main(int argc, char** argv)
         return EXIT_FAILURE;
     }
 
-    if(action == Action::None)
+    // in batch mode, the action of each input is inferred separately.
+    if(action == Action::None && !options.batch)
     {
-        std::string extension = input.extension().string();
-        if(iequal_to()(extension, ".sc"))
-            action = Action::Compile;
-        else if(iequal_to()(extension, ".scm"))
-            action = Action::Decompile;
-        else if(iequal_to()(extension, ".scc"))
-            action = Action::Decompile;
-        else if(iequal_to()(extension, ".cs"))
-            action = Action::Decompile;
-        else if(iequal_to()(extension, ".cm"))
-            action = Action::Decompile;
-        else
+        action = infer_action(input);
+        if(action == Action::None)
         {
             fprintf(stderr, "gta3sc: error: could not infer action from input extension (compile/decompile)\n");
             return EXIT_FAILURE;
@@ -516,35 +501,8 @@ int main(int argc, char** argv)
 
     if(action != Action::QueryModels)
     {
-        if(!options.guesser && options.fswitch)
-        {
-            fprintf(stderr, "gta3sc: error: use of -fswitch only available in guesser mode [--guesser]\n");
+        if(!check_options(options))
             return EXIT_FAILURE;
-        }
-
-        if(!options.guesser && options.farrays)
-        {
-            fprintf(stderr, "gta3sc: error: use of -farrays only available in guesser mode [--guesser]\n");
-            return EXIT_FAILURE;
-        }
-
-        if(!options.guesser && options.fconst)
-        {
-            fprintf(stderr, "gta3sc: error: use of -fconst only available in guesser mode [--guesser]\n");
-            return EXIT_FAILURE;
-        }
-
-        if(!options.guesser && options.streamed_scripts)
-        {
-            fprintf(stderr, "gta3sc: error: use of -fstreamed_scripts only available in guesser mode [--guesser]\n");
-            return EXIT_FAILURE;
-        }
-
-        if(!options.guesser && options.skip_cutscene)
-        {
-            fprintf(stderr, "gta3sc: error: use of -fskip-cutscene only available in guesser mode [--guesser]\n");
-            return EXIT_FAILURE;
-        }
     }
 
     if(!data.datadir.empty())
@@ -567,8 +525,7 @@ int main(int argc, char** argv)
 
         try
         {
-            default_models = load_dat(data.datadir / "default.dat", true);
-            level_models   = load_dat(data.datadir / data.levelfile, false);
+            std::tie(default_models, level_models) = load_models(data.datadir, data.levelfile, data.models_cache);
         }
         catch(const ConfigError& e)
         {
@@ -579,20 +536,7 @@ int main(int argc, char** argv)
 
     try
     {
-        std::vector<fs::path> config_files;
-        config_files.reserve(6 + conf.add_config_files.size());
-
-        config_files.emplace_back(config_path() / "gta3sc.xml");
-        config_files.emplace_back("alternators.xml");
-        config_files.emplace_back("commands.xml");
-        config_files.emplace_back("constants.xml");
-        if(data.datadir.empty()) config_files.emplace_back("default.xml");
-        if(options.cleo) config_files.emplace_back("cleo.xml");
-        std::move(conf.add_config_files.begin(), conf.add_config_files.end(), std::back_inserter(config_files));
-
-        Commands commands = Commands::from_xml(conf.config_name, config_files);
-        commands.add_default_models(default_models);
-
+        Commands commands = load_commands(conf, data, options, default_models);
         program.emplace(std::move(options), std::move(commands));
         program->setup_models(std::move(default_models), std::move(level_models));
     }
@@ -605,6 +549,27 @@ int main(int argc, char** argv)
     fs::path conf_path = config_path();
     //fprintf(stderr, "gta3sc: using '%s' as configuration path\n", conf_path.generic_u8string().c_str());
 
+    // Reported once every job is done, so that the whole run is accounted.
+    auto report_guard = make_scope_guard([&] {
+        if(program->opt.time_report)
+            program->time_trace->print_report(stderr);
+
+        if(program->opt.time_trace && !program->time_trace->write_chrome_trace(*program->opt.time_trace))
+            fprintf(stderr, "gta3sc: error: could not write time trace to '%s'\n", program->opt.time_trace->generic_u8string().c_str());
+
+        if(program->opt.mem_report)
+        {
+            program->commands.report_memory(*program->mem_report);
+            program->mem_report->print(stderr, program->time_trace.get());
+        }
+
+        if(program->opt.opt_stats)
+            program->opt_stats->print(stderr);
+    });
+
+    if(program->opt.batch && action != Action::QueryModels)
+        return run_batch(action, input, *program);
+
     switch(action)
     {
         case Action::Compile:
@@ -624,7 +589,7 @@ int main(int argc, char** argv)
             if(input == "level" || input == "all")
             {
                 fprintf(stdout, "=LEVEL\n");
-                for(auto& pair : program->level_models)
+                for(auto& pair : *program->level_models)
                 {
                     fprintf(stdout, "%s %u\n", pair.first.c_str(), pair.second);
                 }
@@ -3,7 +3,10 @@
 #include "parser.hpp"
 #include "symtable.hpp"
 #include "codegen.hpp"
+#include "optimizer.hpp"
 #include "cdimage.hpp"
+#include "decompiler_ir2.hpp"
+#include "bir_writer.hpp"
 
 using RequiredFrom = std::vector<weak_ptr<const Script>>;
 using IncluderPair = std::pair<shared_ptr<Script>, IncluderTable>;
@@ -32,7 +35,7 @@ namespace
 
     auto generate_ir(const SymTable&, std::vector<shared_ptr<Script>>& scripts, ProgramContext& program) -> std::vector<CodeGenerator>;
 
-    void generate_scm(std::vector<CodeGenerator>&);
+    void generate_scm(std::vector<CodeGenerator>&, ProgramContext&);
 
     auto build_headers(std::vector<CodeGenerator>& gens, const SymTable& symbols, const std::vector<std::string>& models,
                        const shared_ptr<const Script> main, std::vector<shared_ptr<Script>>& scripts,
@@ -47,25 +50,46 @@ namespace
                          Writeable1& main_scm, Writeable2& script_img, bool has_script_img,
                          ProgramContext& program);
 
+    bool generate_ir2(const std::vector<CodeGenerator>& gens, const MultiFileHeaderList& multi_headers,
+                      ProgramContext& program, Options::Lang lang, text_sink& sink);
+
     void check_expect_vars(const Script& main, const SymTable&, ProgramContext&);
 }
 
 int compile(fs::path input, fs::path output, ProgramContext& program)
 {
-    if(output.empty())
+    if(!compile_file(std::move(input), std::move(output), program))
     {
-        output = fs::path(input).replace_extension([&] {
-            if(program.opt.emit_ir2)
-                return ".ir2";
-            else if(program.opt.output_cleo)
-                return program.opt.mission_script? ".cm" : ".cs";
-            else
-                return ".scm";
-        }());
+        fprintf(stderr, "gta3sc: compilation failed\n");
+        return EXIT_FAILURE;
     }
+    return EXIT_SUCCESS;
+}
+
+fs::path default_compile_output(const fs::path& input, const Options& options)
+{
+    return fs::path(input).replace_extension([&] {
+        if(options.emit_ir2)
+            return ".ir2";
+        else if(options.emit_bir)
+            return ".bir";
+        else if(options.output_cleo)
+            return options.mission_script? ".cm" : ".cs";
+        else
+            return ".scm";
+    }());
+}
+
+bool compile_file(fs::path input, fs::path output, ProgramContext& program)
+{
+    if(output.empty())
+        output = default_compile_output(input, program.opt);
 
     try
     {
+        TimeTrace* trace = program.time_trace.get();
+        TimeTrace::Scope compile_timer(trace, "compile", input.filename().u8string());
+
         IncluderTable ictable;
         std::vector<shared_ptr<Script>> scripts;
 
@@ -78,7 +102,10 @@ int compile(fs::path input, fs::path output, ProgramContext& program)
 
         const auto use_script_img = (program.opt.streamed_scripts && !program.opt.headerless);
 
-        shared_ptr<Script> main = Script::create(input, main_type, program);
+        shared_ptr<Script> main = [&] {
+            TimeTrace::Scope timer(trace, "Script::create", input.filename().u8string());
+            return Script::create(input, main_type, program);
+        }();
 
         if(!main)
         {
@@ -88,36 +115,54 @@ int compile(fs::path input, fs::path output, ProgramContext& program)
 
         auto subdir = main->scan_subdir();
 
-        std::tie(ictable, scripts) = resolve_inclusion(main, subdir, program);
+        {
+            TimeTrace::Scope timer(trace, "resolve_inclusion");
+            std::tie(ictable, scripts) = resolve_inclusion(main, subdir, program);
+        }
 
         if(program.has_error())
             throw ProgramFailure();
 
-        SymTable symbols = scan_symbols(std::move(ictable), scripts, program);
-        symbols.check_scope_collisions(program);
-        symbols.check_constant_collisions(program);
+        SymTable symbols = [&] {
+            TimeTrace::Scope timer(trace, "scan_symbols");
+            SymTable symbols = scan_symbols(std::move(ictable), scripts, program);
+            symbols.check_scope_collisions(program);
+            symbols.check_constant_collisions(program);
+            return symbols;
+        }();
 
         if(program.has_error())
             throw ProgramFailure();
 
-        std::for_each(scripts.begin(), scripts.end(), [&](const auto& script) {
-            script->annotate_tree(symbols, program);
-        });
+        {
+            TimeTrace::Scope timer(trace, "annotate_tree");
+            std::for_each(scripts.begin(), scripts.end(), [&](const auto& script) {
+                TimeTrace::Scope script_timer(trace, "annotate_tree", script->path.filename().u8string());
+                script->annotate_tree(symbols, program);
+            });
+        }
 
         if(program.has_error())
             throw ProgramFailure();
 
-        std::for_each(scripts.begin(), scripts.end(), [&](const auto& script) {
-            script->compute_scope_outputs(symbols, program);
-            script->fix_call_scope_variables(program);
-        });
+        {
+            TimeTrace::Scope timer(trace, "compute_scope_outputs");
+            std::for_each(scripts.begin(), scripts.end(), [&](const auto& script) {
+                TimeTrace::Scope script_timer(trace, "compute_scope_outputs", script->path.filename().u8string());
+                script->compute_scope_outputs(symbols, program);
+                script->fix_call_scope_variables(program);
+            });
+        }
 
         if(program.has_error())
             throw ProgramFailure();
 
         check_expect_vars(*main, symbols, program);
 
-        Script::handle_special_commands(scripts, symbols, program);
+        {
+            TimeTrace::Scope timer(trace, "handle_special_commands");
+            Script::handle_special_commands(scripts, symbols, program);
+        }
 
         if(program.has_error())
             throw ProgramFailure();
@@ -129,25 +174,56 @@ int compile(fs::path input, fs::path output, ProgramContext& program)
                 program.error(nocontext, "use of non-default model {} in custom script", model);
         }
 
-        auto gens = generate_ir(symbols, scripts, program);
+        auto gens = [&] {
+            TimeTrace::Scope timer(trace, "generate_ir");
+            return generate_ir(symbols, scripts, program);
+        }();
 
         if(program.has_error())
             throw ProgramFailure();
 
         if(program.opt.fsyntax_only)
-            return EXIT_SUCCESS;
+            return true;
+
+        {
+            TimeTrace::Scope timer(trace, "optimize");
+            optimize(gens, symbols, program);
+        }
+
+        if(program.has_error())
+            throw ProgramFailure();
 
-        auto multi_headers = build_headers(gens, symbols, models, main, scripts, program);
+        auto multi_headers = [&] {
+            TimeTrace::Scope timer(trace, "build_headers");
+            return build_headers(gens, symbols, models, main, scripts, program);
+        }();
 
-        compute_offsets(gens, multi_headers, scripts, program);
-        
-        generate_scm(gens);
+        {
+            TimeTrace::Scope timer(trace, "compute_offsets");
+            compute_offsets(gens, multi_headers, scripts, program);
+        }
+
+        {
+            TimeTrace::Scope timer(trace, "generate_scm");
+            generate_scm(gens, program);
+        }
+
+        if(program.mem_report)
+        {
+            for(auto& script : scripts)
+                script->report_memory(*program.mem_report);
+            for(auto& gen : gens)
+                gen.report_memory(*program.mem_report);
+            symbols.report_memory(*program.mem_report);
+        }
 
         if(program.has_error())
             throw ProgramFailure();
 
-        if(program.opt.emit_ir2)
+        if(program.opt.emit_ir2 || program.opt.emit_bir)
         {
+            auto lang = program.opt.emit_bir? Options::Lang::BIR : Options::Lang::IR2;
+
             FILE *outstream = 0;
             std::vector<uint8_t> main_scm;
             std::vector<uint8_t> script_img;
@@ -160,27 +236,21 @@ int compile(fs::path input, fs::path output, ProgramContext& program)
             if(outstream == nullptr)
                 program.fatal_error(nocontext, "failed to open output for writing");
 
-            bool is_first_line = true;
-            auto print_ir2_line = [&](const std::string& line)
-            {
-                if(is_first_line)
-                {
-                    is_first_line = false;
-                    fprintf(outstream, "%s", line.c_str());
-                }
-                else
-                {
-                    fprintf(outstream, "\n%s", line.c_str());
-                }
-            };
+            text_sink sink(outstream, false);
 
-            generate_output(gens, multi_headers, main_scm, script_img, use_script_img, program);
+            TimeTrace::Scope timer(trace, "generate_ir2");
 
-            auto status = decompile(main_scm.data(), main_scm.size(),
-                                    script_img.data(), script_img.size(), program,
-                                    Options::Lang::IR2, print_ir2_line);
-            if(!status)
-                throw ProgramFailure();
+            if(!generate_ir2(gens, multi_headers, program, lang, sink))
+            {
+                // Things like HEX data can only be printed as the disassembler sees them.
+                generate_output(gens, multi_headers, main_scm, script_img, use_script_img, program);
+
+                auto status = decompile(main_scm.data(), main_scm.size(),
+                                        script_img.data(), script_img.size(), program,
+                                        lang, sink);
+                if(!status)
+                    throw ProgramFailure();
+            }
         }
         else
         {
@@ -202,18 +272,18 @@ int compile(fs::path input, fs::path output, ProgramContext& program)
                     program.fatal_error(nocontext, "failed to open script.img for writing");
             }
 
+            TimeTrace::Scope timer(trace, "generate_output");
             generate_output(gens, multi_headers, main_scm, script_img, use_script_img, program);
         }
         
         if(program.has_error())
             throw ProgramFailure();
 
-        return EXIT_SUCCESS;
+        return true;
     }
     catch(const ProgramFailure&)
     {
-        fprintf(stderr, "gta3sc: compilation failed\n");
-        return EXIT_FAILURE;
+        return false;
     }
 }
 
@@ -223,6 +293,8 @@ namespace
 auto read_script(const std::string& filename, ScriptType type,
                  const Script& main, const Script::SubDir& subdir, ProgramContext& program) -> optional<IncluderPair>
 {
+    TimeTrace::Scope timer(program.time_trace.get(), "read_script", filename);
+
     if(auto script = main.from_subdir(filename, subdir, type, program))
     {
         return std::make_pair( script, IncluderTable::from_script(*script, program) );
@@ -398,6 +470,7 @@ auto scan_symbols(IncluderTable&& ictable, std::vector<shared_ptr<Script>>& scri
     vec_symbols.reserve(scripts.size());
 
     std::transform(scripts.begin(), scripts.end(), std::back_inserter(vec_symbols), [&](const auto& script) {
+        TimeTrace::Scope timer(program.time_trace.get(), "SymTable::from_script", script->path.filename().u8string());
         return SymTable::from_script(*script, program);
     });
 
@@ -481,6 +554,7 @@ void compute_offsets(std::vector<CodeGenerator>& gens, const MultiFileHeaderList
     assert(gens.size() == scripts.size());
 
     for_loop(size_t(0), gens.size(), [&](size_t i) {
+        TimeTrace::Scope timer(program.time_trace.get(), "compute_labels", scripts[i]->path.filename().u8string());
         scripts[i]->code_size = gens[i].compute_labels();
     });
 
@@ -493,15 +567,17 @@ auto generate_ir(const SymTable& symbols, std::vector<shared_ptr<Script>>& scrip
     gens.reserve(scripts.size());
 
     std::transform(scripts.begin(), scripts.end(), std::back_inserter(gens), [&](const auto& script) {
+        TimeTrace::Scope timer(program.time_trace.get(), "CompilerContext::compile", script->path.filename().u8string());
         return CodeGenerator { CompilerContext::compile(script, symbols, program), program };
     });
 
     return gens;
 }
 
-void generate_scm(std::vector<CodeGenerator>& gens)
+void generate_scm(std::vector<CodeGenerator>& gens, ProgramContext& program)
 {
     std::for_each(gens.begin(), gens.end(), [&](auto& gen) {
+        TimeTrace::Scope timer(program.time_trace.get(), "CodeGenerator::generate", gen.script->path.filename().u8string());
         gen.generate();
     });
 }
@@ -652,6 +728,514 @@ void generate_output(const std::vector<CodeGenerator>& gens,
     assert(file_tell(main_scm) == multifile_size);
 }
 
+/// Converts the intermediate representation of the scripts into IR2 (or BIR), without generating and disassembling
+/// the bytecode. The output is the same as from `decompile` on the output of `generate_output`.
+///
+/// \returns false, before outputting anything, if the disassembler would see anything other than the compiled
+/// commands, such as for HEX data or commands that cannot be decoded. The bytecode must be decompiled instead.
+bool generate_ir2(const std::vector<CodeGenerator>& gens, const MultiFileHeaderList& multi_headers,
+                  ProgramContext& program, Options::Lang lang, text_sink& sink)
+{
+    using ArgKind = CommandLayout::ArgKind;
+
+    /// A code segment, as split by the decompiler.
+    struct Segment
+    {
+        size_t                                                size = 0; //< Size of the segment, including its headers.
+        std::vector<std::pair<size_t, const CodeGenerator*>>  gens;     //< Scripts in this segment, by local offset.
+        std::vector<std::pair<size_t, DecompiledCommand>>     commands; //< Commands in this segment, by local offset.
+        dynamic_bitset                                        labels;   //< Local offsets branched into.
+    };
+
+    /// A argument as the disassembler would fetch it from the bytecode.
+    struct DecodedArg
+    {
+        ArgVariant2 value;
+        size_t      size;           //< Size of the argument, including its data type.
+        uint8_t     datatype;       //< Data type, or the first character for III/VC text labels and String128.
+        bool        has_datatype;
+    };
+
+    // Recursive traversal may find instructions overlapping the compiled ones.
+    if(!program.opt.linear_sweep)
+        return false;
+
+    assert(gens[0].script->is_main_script());
+    auto& main = gens[0].script;
+    auto scmheader = multi_headers.find_header<CompiledScmHeader>(main);
+
+    if(!program.opt.headerless && !scmheader)
+        return false;
+
+    const bool use_script_img = (program.opt.streamed_scripts && !program.opt.headerless);
+    const bool has_streams = (scmheader && scmheader->version == CompiledScmHeader::Version::SanAndreas);
+
+    size_t num_missions = scmheader? scmheader->num_missions : 0;
+    size_t num_streamed = (has_streams && use_script_img)? scmheader->num_streamed : 0;
+
+    if(scmheader)
+    {
+        // Names filling the whole header field have no null terminator and aren't read back properly.
+        if(std::any_of(scmheader->models.begin(), scmheader->models.end(), [](const auto& model) {
+            return model.size() >= 24;
+        }))
+            return false;
+
+        if(has_streams && std::any_of(scmheader->base_scripts.begin(), scmheader->base_scripts.end(), [](const auto& script) {
+            auto name = script->path.stem().u8string();
+            return script->type == ScriptType::StreamedScript && (name.size() >= 20 || iequal_to()(name, "AAA"));
+        }))
+            return false;
+    }
+
+    size_t multifile_size = std::accumulate(gens.begin(), gens.end(), size_t(0), [&](size_t size, const auto& gen) {
+        if(gen.script->is_root_script() && gen.script->type != ScriptType::StreamedScript)
+            return size + gen.script->full_size();
+        return size;
+    });
+
+    std::vector<Segment> segments(1 + num_missions + num_streamed);
+    std::vector<uint32_t> mission_bases;
+
+    for(auto& gen : gens)
+    {
+        // OATC opcodes are only known to the disassembler after it parses the custom header.
+        if(gen.oatc)
+            return false;
+
+        auto root_script = gen.script->root_script();
+        if(root_script->on_the_same_space_as(*main))
+        {
+            if(gen.script == root_script)
+                segments[0].size += root_script->full_size();
+            segments[0].gens.emplace_back(gen.script->code_offset.value(), &gen);
+        }
+        else if(root_script->type == ScriptType::Mission && num_missions)
+        {
+            if(gen.script == root_script)
+                mission_bases.emplace_back(root_script->base.value());
+            segments[1 + root_script->mission_id.value()].gens.emplace_back(
+                        gen.script->code_offset.value() - root_script->base.value(), &gen);
+        }
+        else if(root_script->type == ScriptType::StreamedScript && gen.script == root_script && num_streamed)
+        {
+            // Same layout as in script.img, with the required scripts after the streamed script.
+            auto& segment = segments[1 + num_missions + root_script->streamed_id.value()];
+            size_t offset = root_script->header_size();
+
+            segment.size = root_script->full_size();
+            segment.gens.emplace_back(offset, &gen);
+            offset += gen.script->code_size.value();
+
+            for(auto& weakp : gen.script->children_scripts)
+            {
+                auto required_script = weakp.lock();
+                auto& required_gen = *std::find_if(gens.begin(), gens.end(), [&](const auto& g) { return g.script == required_script; });
+                segment.gens.emplace_back(offset, &required_gen);
+                offset += required_script->code_size.value();
+            }
+        }
+    }
+
+    if(program.opt.headerless)
+        segments[0].size = multifile_size;
+
+    std::sort(mission_bases.begin(), mission_bases.end());
+
+    for(auto& gen : gens)
+    {
+        auto root_script = gen.script->root_script();
+        if(gen.script == root_script && root_script->type == ScriptType::Mission && num_missions)
+        {
+            auto next_base = std::upper_bound(mission_bases.begin(), mission_bases.end(), root_script->base.value());
+            auto end_offset = (next_base != mission_bases.end()? *next_base : multifile_size);
+            segments[1 + root_script->mission_id.value()].size = end_offset - root_script->base.value();
+        }
+    }
+
+    // The disassembler walks each segment linearly, so the scripts must cover the whole of it.
+    for(auto& segment : segments)
+    {
+        std::sort(segment.gens.begin(), segment.gens.end(), [](const auto& a, const auto& b) {
+            return a.first < b.first;
+        });
+
+        if(segment.gens.empty())
+            return false;
+
+        size_t offset = segment.gens.front().second->script->root_script()->header_size();
+        for(auto& pair : segment.gens)
+        {
+            if(pair.first != offset)
+                return false;
+            offset += pair.second->script->code_size.value();
+        }
+
+        if(offset != segment.size)
+            return false;
+
+        segment.labels.resize(segment.size);
+    }
+
+    // Strings are fetched as a fixed amount of characters, the ones after the null terminator being zeros.
+    auto decode_chars = [](const CompiledString& str, size_t count) -> std::string
+    {
+        std::string output(count, '\0');
+        for(size_t i = 0; i < count && i < str.storage.size() && str.storage[i] != '\0'; ++i)
+            output[i] = str.preserve_case? str.storage[i] : toupper_ascii(str.storage[i]);
+        return output;
+    };
+
+    auto decode_var = [](const Var& var, uint16_t value) -> DecompiledVar
+    {
+        auto type = (var.type == VarType::Float? VarType::Int : var.type);
+        return DecompiledVar { var.global, type, var.global? uint32_t(value) : uint32_t(value) * 4u };
+    };
+
+    // Converts a argument with the same rules as the code generator, then back as the disassembler.
+    auto decode_value = [&](const ArgVariant& varg, const CodeGenerator& gen) -> ArgVariant2
+    {
+        if(is<EOAL>(varg))
+        {
+            return EOAL{};
+        }
+        else if(is<int8_t>(varg))
+        {
+            return get<int8_t>(varg);
+        }
+        else if(is<int16_t>(varg))
+        {
+            return get<int16_t>(varg);
+        }
+        else if(is<int32_t>(varg))
+        {
+            return get<int32_t>(varg);
+        }
+        else if(is<float>(varg))
+        {
+            auto value = get<float>(varg);
+            if(*gen.datatype(varg) == 0x04) // zero, see -moptimize-zero
+                return int8_t(0);
+            else if(program.opt.use_half_float)
+                return CodeGenerator::from_half_float(CodeGenerator::to_half_float(value));
+            else
+                return value;
+        }
+        else if(is<shared_ptr<Label>>(varg))
+        {
+            return gen.label_operand(*get<shared_ptr<Label>>(varg));
+        }
+        else if(is<CompiledVar>(varg))
+        {
+            auto& v = get<CompiledVar>(varg);
+            auto& var = *v.var;
+
+            if(v.index == nullopt)
+            {
+                return decode_var(var, CodeGenerator::var_operand(var));
+            }
+            else if(is<int32_t>(*v.index))
+            {
+                return decode_var(var, CodeGenerator::var_operand(var, get<int32_t>(*v.index)));
+            }
+            else
+            {
+                auto& index_var = *get<shared_ptr<Var>>(*v.index);
+                auto index_value = CodeGenerator::var_operand(index_var);
+                auto elem_type = CodeGenerator::array_elem_type(var);
+
+                return DecompiledVarArray {
+                    decode_var(var, CodeGenerator::var_operand(var)),
+                    DecompiledVar { index_var.global, VarType::Int, index_var.global? uint32_t(index_value) : uint32_t(index_value) * 4u },
+                    static_cast<uint8_t>(var.count.value()),
+                    elem_type == 0? DecompiledVarArray::ElemType::Int :
+                    elem_type == 1? DecompiledVarArray::ElemType::Float :
+                    elem_type == 2? DecompiledVarArray::ElemType::TextLabel :
+                    elem_type == 3? DecompiledVarArray::ElemType::TextLabel16 :
+                                    DecompiledVarArray::ElemType::None,
+                };
+            }
+        }
+        else if(is<CompiledString>(varg))
+        {
+            auto& str = get<CompiledString>(varg);
+            switch(str.type)
+            {
+                case CompiledString::Type::TextLabel8:
+                    return DecompiledString { DecompiledString::Type::TextLabel8, decode_chars(str, 8) };
+                case CompiledString::Type::TextLabel16:
+                    return DecompiledString { DecompiledString::Type::TextLabel16, decode_chars(str, 16) };
+                case CompiledString::Type::StringVar:
+                    return DecompiledString { DecompiledString::Type::StringVar, decode_chars(str, str.storage.size()) };
+                case CompiledString::Type::String128:
+                    return DecompiledString { DecompiledString::Type::String128, decode_chars(str, 128) };
+                default:
+                    Unreachable();
+            }
+        }
+        Unreachable();
+    };
+
+    auto decode_arg = [&](const ArgVariant& varg, const CodeGenerator& gen) -> DecodedArg
+    {
+        DecodedArg arg { decode_value(varg, gen), gen.compute_size(varg), 0x00, false };
+
+        if(auto datatype = gen.datatype(varg))
+        {
+            arg.datatype = *datatype;
+            arg.has_datatype = true;
+        }
+        else
+        {
+            // The disassembler takes the first character as the data type.
+            assert(is<DecompiledString>(arg.value));
+            arg.datatype = static_cast<uint8_t>(get<DecompiledString>(arg.value).storage[0]);
+        }
+
+        return arg;
+    };
+
+    std::map<const Command*, CommandLayout> layouts;
+
+    for(auto& segment : segments)
+    {
+        bool is_main_segment = (&segment == &segments[0]);
+        size_t switch_cases_left = 0;
+
+        for(auto& pair : segment.gens)
+        {
+            const CodeGenerator& gen = *pair.second;
+            size_t offset = pair.first;
+
+            for(auto& op : gen.ir())
+            {
+                if(is<CompiledLabelDef>(op.data))
+                    continue;
+
+                // HEX may be disassembled into anything, possibly overlapping the following commands.
+                if(!is<CompiledCommand>(op.data))
+                    return false;
+
+                auto& ccmd = get<CompiledCommand>(op.data);
+
+                if(!ccmd.command.get().id || *ccmd.command.get().id >= 0x8000)
+                    return false;
+
+                // The disassembler identifies the command by its opcode, which may be shared by multiple commands.
+                auto command = program.commands.find_command(*ccmd.command.get().id);
+                if(!command)
+                    return false;
+
+                auto it_layout = layouts.find(std::addressof(*command));
+                if(it_layout == layouts.end())
+                    it_layout = layouts.emplace(std::addressof(*command), CommandLayout(*command, program.commands)).first;
+
+                const CommandLayout& layout = it_layout->second;
+                if(!layout.decodable)
+                    return false;
+
+                if(ccmd.args.size() < layout.args.size() + (layout.variadic? 1 : 0))
+                    return false;
+
+                // Same as `Disassembler::explore_opcode`.
+                if(layout.is_switch_start)
+                    switch_cases_left = 0;
+
+                DecompiledCommand dcmd { ccmd.not_flag, *command };
+                dcmd.args.reserve(ccmd.args.size());
+
+                size_t op_offset = offset;
+                offset += sizeof(uint16_t);
+
+                for(size_t argument_id = 0; argument_id < ccmd.args.size(); ++argument_id)
+                {
+                    auto& varg = ccmd.args[argument_id];
+                    bool is_variadic = (argument_id >= layout.args.size());
+
+                    if(is_variadic && !layout.variadic)
+                        return false;
+
+                    ArgKind kind = is_variadic? *layout.variadic : layout.args[argument_id];
+                    DecodedArg arg = decode_arg(varg, gen);
+
+                    bool is_string128 = (is<DecompiledString>(arg.value)
+                                        && get<DecompiledString>(arg.value).type == DecompiledString::Type::String128);
+
+                    if(is_string128 != (kind == ArgKind::String128))
+                        return false;
+
+                    // The argument list ends at the first EOAL.
+                    if(is<EOAL>(arg.value) != (is_variadic && argument_id + 1 == ccmd.args.size()))
+                        return false;
+
+                    if(!is_string128)
+                    {
+                        if(arg.datatype > 0x06 && !program.opt.has_text_label_prefix)
+                        {
+                            // III/VC text labels are told apart from other arguments by their first character.
+                            if(kind == ArgKind::TextLabel)
+                            {
+                                if(arg.has_datatype)
+                                    return false;
+                            }
+                            else if(!(arg.datatype == 0x0E && kind == ArgKind::String && program.opt.cleo))
+                            {
+                                return false;
+                            }
+                        }
+                        else if(!arg.has_datatype)
+                        {
+                            return false;
+                        }
+                    }
+
+                    if(is<int8_t>(arg.value) || is<int16_t>(arg.value) || is<int32_t>(arg.value))
+                    {
+                        int32_t value = *get_imm32(arg.value);
+
+                        if(layout.is_switch_start && argument_id == 1)
+                            switch_cases_left = value;
+
+                        bool take_label = (kind == ArgKind::Label);
+                        if(take_label && (layout.is_switch_start || layout.is_switch_continued))
+                        {
+                            if(switch_cases_left == 0)
+                                take_label = false;
+                            else if(layout.is_switch_start && argument_id != 3)
+                                --switch_cases_left;
+                        }
+
+                        if(take_label)
+                        {
+                            // Positive offsets are in the main segment.
+                            auto& target_segment = (value >= 0 || is_main_segment)? segments[0] : segment;
+                            auto target = value >= 0? size_t(value) : size_t(-int64_t(value));
+                            if(target < target_segment.labels.size())
+                                target_segment.labels.set(target);
+                        }
+                    }
+
+                    offset += arg.size;
+                    dcmd.args.emplace_back(std::move(arg.value));
+                }
+
+                segment.commands.emplace_back(op_offset, std::move(dcmd));
+            }
+
+            if(offset != pair.first + gen.script->code_size.value())
+                return false;
+        }
+    }
+
+    auto to_data = [](Segment& segment)
+    {
+        std::vector<DecompiledData> output;
+        output.reserve(segment.commands.size() + 16);
+        for(auto& pair : segment.commands)
+        {
+            if(segment.labels[pair.first])
+                output.emplace_back(DecompiledLabelDef { pair.first });
+            output.emplace_back(pair.first, std::move(pair.second));
+        }
+        return output;
+    };
+
+    if(lang == Options::Lang::BIR)
+    {
+        BirWriter bir;
+
+        if(scmheader)
+        {
+            std::string temp_string;
+
+            for(auto& model : scmheader->models)
+            {
+                temp_string = model;
+                std::transform(temp_string.begin(), temp_string.end(), temp_string.begin(), toupper_ascii);
+                bir.add_model(temp_string);
+            }
+
+            if(has_streams)
+            {
+                for(auto& script : scmheader->base_scripts)
+                {
+                    if(script->type == ScriptType::StreamedScript)
+                    {
+                        temp_string = script->path.stem().u8string();
+                        std::transform(temp_string.begin(), temp_string.end(), temp_string.begin(), toupper_ascii);
+                        bir.add_stream(temp_string);
+                    }
+                }
+                bir.add_stream("AAA");
+            }
+        }
+
+        bir.add_block(BirBlockKind::Main, 0, segments[0].size, to_data(segments[0]));
+
+        for(size_t i = 0; i < num_missions; ++i)
+            bir.add_block(BirBlockKind::Mission, i, segments[1 + i].size, to_data(segments[1 + i]));
+
+        for(size_t i = 0; i < num_streamed; ++i)
+        {
+            auto& segment = segments[1 + num_missions + i];
+            bir.add_block(BirBlockKind::Stream, i, segment.size, to_data(segment));
+        }
+
+        bir.write(sink);
+        return true;
+    }
+
+    if(scmheader)
+    {
+        std::string temp_string;
+
+        for(size_t i = 0; i < scmheader->models.size(); ++i)
+        {
+            temp_string = scmheader->models[i];
+            std::transform(temp_string.begin(), temp_string.end(), temp_string.begin(), toupper_ascii);
+            sink.line(fmt::format("#DEFINE_MODEL {} -{}", temp_string, i+1));
+        }
+
+        if(has_streams)
+        {
+            size_t i = 0;
+            for(auto& script : scmheader->base_scripts)
+            {
+                if(script->type == ScriptType::StreamedScript)
+                {
+                    temp_string = script->path.stem().u8string();
+                    std::transform(temp_string.begin(), temp_string.end(), temp_string.begin(), toupper_ascii);
+                    sink.line(fmt::format("#DEFINE_STREAM {} {}", temp_string, i++));
+                }
+            }
+            sink.line(fmt::format("#DEFINE_STREAM {} {}", "AAA", i));
+        }
+    }
+
+    DecompilerIR2 main_ir2(program.commands, to_data(segments[0]), 0, segments[0].size, "MAIN", true);
+    main_ir2.decompile(sink);
+
+    for(size_t i = 0; i < num_missions; ++i)
+    {
+        auto& segment = segments[1 + i];
+        auto script_name = fmt::format("MISSION_{}", i);
+        sink.line(fmt::format("#MISSION_BLOCK_START {}", (int)(i)));
+        DecompilerIR2(program.commands, to_data(segment), 0, segment.size, std::move(script_name), false, main_ir2).decompile(sink);
+        sink.line("#MISSION_BLOCK_END");
+    }
+
+    for(size_t i = 0; i < num_streamed; ++i)
+    {
+        auto& segment = segments[1 + num_missions + i];
+        auto script_name = fmt::format("STREAM_{}", i);
+        sink.line(fmt::format("#STREAMED_BLOCK_START {}", (int)(i)));
+        DecompilerIR2(program.commands, to_data(segment), 0, segment.size, std::move(script_name), false, main_ir2).decompile(sink);
+        sink.line("#STREAMED_BLOCK_END");
+    }
+
+    return true;
+}
+
 void check_expect_vars(const Script& main, const SymTable& symbols, ProgramContext& program)
 {
     if(!program.opt.warn_expect_var || main.type != ScriptType::Main)
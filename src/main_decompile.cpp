@@ -2,70 +2,308 @@
 #include "program.hpp"
 #include "disassembler.hpp"
 #include "decompiler_ir2.hpp"
+#include "bir_writer.hpp"
+#include "cpp/parallel.hpp"
+
+static bool decompile_bir(const void* bytes, size_t size, ProgramContext& program, text_sink& output);
 
 int decompile(fs::path input, fs::path output, ProgramContext& program)
+{
+    if(!decompile_file(std::move(input), std::move(output), program))
+    {
+        fprintf(stderr, "gta3sc: decompilation failed\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+bool decompile_file(fs::path input, fs::path output, ProgramContext& program)
 {
     if(output.empty())
     {
         output = input;
-        output.replace_extension(program.opt.emit_ir2? ".ir2" : ".sc");
+        output.replace_extension(program.opt.emit_bir? ".bir" : program.opt.emit_ir2? ".ir2" : ".sc");
     }
 
     try
     {
-        const Commands& commands = program.commands;
+        TimeTrace::Scope decompile_timer(program.time_trace.get(), "decompile", input.filename().u8string());
 
-        FILE* outstream;
+        FILE* outstream = nullptr;
+        FILE* xrefstream = nullptr;
 
-        auto lang = (program.opt.emit_ir2? Options::Lang::IR2 : Options::Lang::GTA3Script);
+        auto lang = (program.opt.emit_bir? Options::Lang::BIR :
+                     program.opt.emit_ir2? Options::Lang::IR2 : Options::Lang::GTA3Script);
 
         auto guard = make_scope_guard([&] {
-            if(outstream != stdout) fclose(outstream);
+            if(outstream && outstream != stdout) fclose(outstream);
+            if(xrefstream) fclose(xrefstream);
         });
 
         if(lang == Options::Lang::GTA3Script)
             program.fatal_error(nocontext, "GTA3script output is disabled, please use -emit-ir2 for IR2 output");
 
+        const bool is_bir_input = iequal_to()(input.extension().u8string(), ".bir");
+        if(is_bir_input && lang != Options::Lang::IR2)
+            program.fatal_error(nocontext, "BIR can only be decompiled into IR2");
+
         outstream = (output != "-"? u8fopen(output, "wb") : stdout);
         if(!outstream)
             program.fatal_error(nocontext, "could not open file '{}' for writing", output.generic_u8string());
 
-        auto opt_bytecode = read_file_binary(input);
+        // Mapped instead of read, so that only the pages of script.img which are used get loaded.
+        auto opt_bytecode = MappedFile::open(input);
         if(!opt_bytecode)
             program.fatal_error(nocontext, "file '{}' does not exist", input.generic_u8string());
 
-        std::vector<uint8_t> script_img;
-        if(program.opt.streamed_scripts)
+        optional<MappedFile> script_img;
+        if(program.opt.streamed_scripts && !is_bir_input)
         {
             auto img_path = fs::path(input).replace_filename("script.img");
-            if(auto opt = read_file_binary(img_path))
-                script_img = std::move(*opt);
-            else
+            script_img = MappedFile::open(img_path);
+            if(!script_img)
                 program.fatal_error(nocontext, "file '{}' does not exist", img_path.generic_u8string());
         }
 
-        auto println = [&](const std::string& line) { fprintf(outstream, "%s\n", line.c_str()); }; 
-        if(!decompile(opt_bytecode->data(), opt_bytecode->size(), script_img.data(), script_img.size(), program, lang, println))
+        std::unique_ptr<text_sink> xrefs_sink;
+        if(program.opt.emit_xrefs)
+        {
+            auto xrefs_path = (output != "-"? output : input);
+            xrefs_path.replace_extension(".xrefs");
+
+            xrefstream = u8fopen(xrefs_path, "wb");
+            if(!xrefstream)
+                program.fatal_error(nocontext, "could not open file '{}' for writing", xrefs_path.generic_u8string());
+
+            xrefs_sink = std::make_unique<text_sink>(xrefstream);
+        }
+
+        text_sink sink(outstream);
+
+        if(is_bir_input)
+        {
+            if(xrefs_sink)
+                program.fatal_error(nocontext, "cross references cannot be emitted from BIR");
+
+            if(!decompile_bir(opt_bytecode->data(), opt_bytecode->size(), program, sink))
+                throw ProgramFailure();
+
+            return true;
+        }
+
+        if(!decompile(opt_bytecode->data(), opt_bytecode->size(),
+                      script_img? script_img->data() : nullptr, script_img? script_img->size() : 0,
+                      program, lang, sink, xrefs_sink.get()))
             throw ProgramFailure();
 
-        return 0;
+        return true;
     }
     catch(const ProgramFailure&)
     {
-        fprintf(stderr, "gta3sc: decompilation failed\n");
-        return EXIT_FAILURE;
+        return false;
+    }
+}
+
+/// Emits a line for each label branched into, followed by the commands which branch into it.
+///
+/// Each of the `blocks` is named by the IR2 block name of the segment, the first one being the main segment.
+static void emit_xrefs(const std::vector<std::pair<std::string, const Disassembler*>>& blocks, text_sink& sink)
+{
+    struct BlockXref
+    {
+        size_t target_block, target;
+        size_t source_block, source;
+
+        bool operator<(const BlockXref& rhs) const
+        {
+            return std::tie(target_block, target, source_block, source)
+                 < std::tie(rhs.target_block, rhs.target, rhs.source_block, rhs.source);
+        }
+    };
+
+    std::vector<BlockXref> xrefs;
+    for(size_t i = 0; i < blocks.size(); ++i)
+    {
+        for(auto& xref : blocks[i].second->get_xrefs())
+            xrefs.emplace_back(BlockXref { xref.to_main? 0 : i, xref.target, i, xref.source });
+    }
+
+    std::sort(xrefs.begin(), xrefs.end());
+
+    std::string line;
+    for(auto it = xrefs.begin(); it != xrefs.end(); )
+    {
+        line = fmt::format("{}@0x{:X} <-", blocks[it->target_block].first, it->target);
+
+        auto end = std::find_if(it, xrefs.end(), [&](const BlockXref& x) {
+            return x.target_block != it->target_block || x.target != it->target;
+        });
+
+        for(; it != end; ++it)
+            line += fmt::format(" {}@0x{:X}", blocks[it->source_block].first, it->source);
+
+        sink.line(line);
     }
 }
 
+/// Decompiles a BIR file into IR2.
+static bool decompile_bir(const void* bytes, size_t size, ProgramContext& program, text_sink& output)
+{
+    BirReader reader(bytes, size);
+    if(!reader.valid())
+        program.fatal_error(nocontext, "corrupted or unsupported BIR file");
+
+    for(size_t i = 0; i < reader.models().size(); ++i)
+    {
+        auto name = reader.string(reader.models()[i]);
+        output.line(fmt::format("#DEFINE_MODEL {} -{}", std::string(name.begin(), name.end()), i+1));
+    }
+
+    for(size_t i = 0; i < reader.streams().size(); ++i)
+    {
+        auto name = reader.string(reader.streams()[i]);
+        output.line(fmt::format("#DEFINE_STREAM {} {}", std::string(name.begin(), name.end()), i));
+    }
+
+    auto read_block = [&](const BirBlock& block)
+    {
+        auto opt_data = read_bir_block(reader, block, program.commands);
+        if(!opt_data)
+            program.fatal_error(nocontext, "BIR file uses commands unknown to this configuration");
+        return std::move(*opt_data);
+    };
+
+    auto blocks = reader.blocks();
+    if(blocks.empty() || blocks[0].kind != uint8_t(BirBlockKind::Main))
+        program.fatal_error(nocontext, "BIR file has no main block");
+
+    auto main_ir2 = DecompilerIR2(program.commands, read_block(blocks[0]), 0, blocks[0].size, "MAIN", true);
+    main_ir2.decompile(output);
+
+    for(size_t i = 1; i < blocks.size(); ++i)
+    {
+        auto& block = blocks[i];
+        bool is_stream = (block.kind == uint8_t(BirBlockKind::Stream));
+        output.line(fmt::format("#{}_BLOCK_START {}", is_stream? "STREAMED" : "MISSION", block.id));
+        DecompilerIR2(program.commands, read_block(block), 0, block.size,
+                      fmt::format("{}_{}", is_stream? "STREAM" : "MISSION", block.id), false, main_ir2).decompile(output);
+        output.line(fmt::format("#{}_BLOCK_END", is_stream? "STREAMED" : "MISSION"));
+    }
+
+    return !program.has_error();
+}
+
+/// Decompiles only the segment and offset range selected by `--only-mission`, `--only-stream` and `--range`.
+///
+/// The code of the main segment reachable from the selected segment is output as well, so that
+/// every label it branches into is defined.
+static void decompile_selected(const optional<DecompiledScmHeader>& opt_header,
+                               const BinaryFetcher& main_segment,
+                               const std::vector<BinaryFetcher>& mission_segments,
+                               const std::vector<BinaryFetcher>& stream_segments,
+                               ProgramContext& program, text_sink& output, text_sink* xrefs_output)
+{
+    auto scan_type = program.opt.linear_sweep? Disassembler::Type::LinearSweep :
+                                               Disassembler::Type::RecursiveTraversal;
+
+    auto range_begin = program.opt.only_range? size_t(program.opt.only_range->first) : 0;
+    auto range_end = program.opt.only_range? size_t(program.opt.only_range->second) : SIZE_MAX;
+    auto code_offset = opt_header? opt_header->code_offset : 0;
+
+    // Index of the selected segment in either `mission_segments` or `stream_segments`.
+    optional<size_t> selected_id;
+    bool selected_is_stream = false;
+
+    if(program.opt.only_mission || program.opt.only_stream)
+    {
+        if(!opt_header)
+            program.fatal_error(nocontext, "cannot select a mission or streamed script of a headerless script");
+
+        if(program.opt.only_mission)
+        {
+            if(*program.opt.only_mission >= mission_segments.size())
+                program.fatal_error(nocontext, "mission {} does not exist", *program.opt.only_mission);
+            selected_id = *program.opt.only_mission;
+        }
+        else
+        {
+            if(!program.opt.streamed_scripts)
+                program.fatal_error(nocontext, "cannot select a streamed script without -fstreamed-scripts");
+
+            auto& streams = opt_header->streamed_scripts;
+            auto it = std::find_if(streams.begin(), streams.end(), [&](const auto& stream) {
+                return iequal_to()(stream.name, *program.opt.only_stream);
+            });
+            if(it == streams.end() || iequal_to()(it->name, "AAA"))
+                program.fatal_error(nocontext, "streamed script '{}' does not exist", *program.opt.only_stream);
+
+            selected_id = size_t(it - streams.begin());
+            selected_is_stream = true;
+        }
+    }
+
+    if(!selected_id)
+    {
+        Disassembler main_segment_asm(program, main_segment, scan_type);
+        main_segment_asm.run_analyzer(code_offset);
+        main_segment_asm.disassembly(code_offset);
+
+        if(program.has_error())
+            throw ProgramFailure();
+
+        if(xrefs_output)
+            emit_xrefs({ { "MAIN", &main_segment_asm } }, *xrefs_output);
+
+        DecompilerIR2(program.commands, main_segment_asm.get_data(), 0, main_segment.size, "MAIN", true)
+            .decompile(output, range_begin, range_end);
+        return;
+    }
+
+    auto& segment = selected_is_stream? stream_segments[*selected_id] : mission_segments[*selected_id];
+    auto block_name = fmt::format("{}_{}", selected_is_stream? "STREAM" : "MISSION", *selected_id);
+
+    // Only the code reachable from the selected segment is explored in the main segment.
+    Disassembler main_segment_asm(program, main_segment, Disassembler::Type::RecursiveTraversal);
+    Disassembler segment_asm(program, segment, main_segment_asm, scan_type);
+
+    segment_asm.run_analyzer();
+    main_segment_asm.merge_branch_targets(segment_asm);
+    main_segment_asm.run_analyzer_on_branch_targets();
+
+    main_segment_asm.disassembly(code_offset);
+    segment_asm.disassembly();
+
+    if(program.has_error())
+        throw ProgramFailure();
+
+    if(xrefs_output)
+        emit_xrefs({ { "MAIN", &main_segment_asm }, { block_name, &segment_asm } }, *xrefs_output);
+
+    // The unexplored areas of the main segment are of no interest here.
+    std::vector<DecompiledData> main_data;
+    std::copy_if(main_segment_asm.get_data().begin(), main_segment_asm.get_data().end(), std::back_inserter(main_data),
+                 [](const DecompiledData& d) { return !is<DecompiledHex>(d.data); });
+
+    auto main_ir2 = DecompilerIR2(program.commands, std::move(main_data), 0, main_segment.size, "MAIN", true);
+    main_ir2.decompile(output);
+
+    output.line(fmt::format("#{}_BLOCK_START {}", selected_is_stream? "STREAMED" : "MISSION", (int)(*selected_id)));
+    DecompilerIR2(program.commands, segment_asm.get_data(), 0, segment.size, std::move(block_name), false, main_ir2)
+        .decompile(output, range_begin, range_end);
+    output.line(fmt::format("#{}_BLOCK_END", selected_is_stream? "STREAMED" : "MISSION"));
+}
+
 bool decompile(const void* bytecode, size_t bytecode_size,
                const void* script_img, size_t script_img_size,
                ProgramContext& program, Options::Lang lang,
-               std::function<void(const std::string&)> callback)
+               text_sink& output, text_sink* xrefs_output)
 {
     Expects(!program.opt.streamed_scripts || program.opt.headerless || script_img != nullptr);
 
     try
     {
+        TimeTrace* trace = program.time_trace.get();
+
         optional<DecompiledScmHeader> opt_header;
         size_t ignore_stream_id = -1;
 
@@ -109,6 +347,21 @@ bool decompile(const void* bytecode, size_t bytecode_size,
         if(program.has_error())
             throw ProgramFailure();
 
+        if(program.opt.only_mission || program.opt.only_stream || program.opt.only_range)
+        {
+            if(lang != Options::Lang::IR2)
+                program.fatal_error(nocontext, "targeted decompilation is only available for IR2 output");
+
+            decompile_selected(opt_header, main_segment, mission_segments, stream_segments,
+                               program, output, xrefs_output);
+            return true;
+        }
+
+        // Each segment gets its own context, buffering its messages, so that they can be analyzed
+        // concurrently. The messages are then forwarded to `program` in the segments order.
+        std::deque<ProgramContext> segment_programs;
+        std::vector<std::vector<std::string>> segment_messages(mission_segments.size() + stream_segments.size());
+
         Disassembler main_segment_asm(program, main_segment, scan_type);
         std::vector<Disassembler> mission_segments_asm;
         std::vector<Disassembler> stream_segments_asm;
@@ -117,52 +370,166 @@ bool decompile(const void* bytecode, size_t bytecode_size,
         {
             DecompiledScmHeader& header = *opt_header;
 
+            std::vector<Disassembler*> segments_asm;
+            std::vector<std::string> segments_name;
+
+            auto make_segment_program = [&]() -> ProgramContext&
+            {
+                auto& messages = segment_messages[segment_programs.size()];
+                segment_programs.emplace_back(program, program.opt, [&messages](const std::string& msg) {
+                    messages.emplace_back(msg);
+                });
+                return segment_programs.back();
+            };
+
             mission_segments_asm.reserve(header.mission_offsets.size());
             stream_segments_asm.reserve(header.streamed_scripts.size());
 
-            // this loop cannot be thread safely unfolded because of main_segment_asm being
-            // mutated on all the units.
             for(auto& mission_bytecode : mission_segments)
             {
-                mission_segments_asm.emplace_back(program, mission_bytecode, main_segment_asm, scan_type);
-                mission_segments_asm.back().run_analyzer();
+                mission_segments_asm.emplace_back(make_segment_program(), mission_bytecode, main_segment_asm, scan_type);
             }
 
-            // this loop cannot be thread safely unfolded because of stream_segment_asm being
-            // mutated on all the units.
             for(size_t i = 0; i < stream_segments.size(); ++i)
             {
                 if(i != ignore_stream_id)
                 {
                     auto& stream_bytecode = stream_segments[i];
-                    stream_segments_asm.emplace_back(program, stream_bytecode, main_segment_asm, scan_type);
-                    stream_segments_asm.back().run_analyzer();
+                    stream_segments_asm.emplace_back(make_segment_program(), stream_bytecode, main_segment_asm, scan_type);
                 }
             }
+
+            for(auto& segment_asm : mission_segments_asm) segments_asm.emplace_back(&segment_asm);
+            for(auto& segment_asm : stream_segments_asm) segments_asm.emplace_back(&segment_asm);
+
+            for(size_t i = 0; i < mission_segments_asm.size(); ++i)
+                segments_name.emplace_back(fmt::format("MISSION_{}", i));
+            for(size_t i = 0; i < stream_segments.size(); ++i)
+            {
+                if(i != ignore_stream_id)
+                    segments_name.emplace_back(fmt::format("STREAM_{}", i));
+            }
+
+            TimeTrace::Scope segments_timer(trace, "analyze segments");
+
+            // Nested parallelism is avoided when already running in batch mode.
+            parallel_for(segments_asm.size(), program.opt.batch? 1 : program.opt.num_jobs, [&](size_t i)
+            {
+                TimeTrace::Scope timer(trace, "Disassembler::run_analyzer", segments_name[i], &segments_timer);
+                try
+                {
+                    segments_asm[i]->run_analyzer();
+                }
+                catch(const ProgramFailure&)
+                {
+                    // accounted by the segment context, which is merged below.
+                }
+            });
+
+            for(size_t i = 0; i < segments_asm.size(); ++i)
+            {
+                program.merge_diagnostics(segment_programs[i], segment_messages[i]);
+                main_segment_asm.merge_branch_targets(*segments_asm[i]);
+            }
         }
 
         if(true)
         {
-            // run main segment analyzer after the missions and streams analyzer
+            // run main segment analyzer after the missions and streams branch targets are merged
+            TimeTrace::Scope timer(trace, "Disassembler::run_analyzer", "MAIN");
             main_segment_asm.run_analyzer(opt_header? opt_header->code_offset : 0);
-            main_segment_asm.disassembly(opt_header? opt_header->code_offset : 0);
         }
 
-        for(auto& mission_asm : mission_segments_asm)
-            mission_asm.disassembly();
+        {
+            TimeTrace::Scope timer(trace, "Disassembler::disassembly");
+
+            main_segment_asm.disassembly(opt_header? opt_header->code_offset : 0);
+
+            for(auto& mission_asm : mission_segments_asm)
+                mission_asm.disassembly();
+
+            for(size_t i = 0; i < stream_segments.size(); ++i)
+            {
+                if(i != ignore_stream_id)
+                {
+                    auto& stream_asm = stream_segments_asm[i];
+                    stream_asm.disassembly();
+                }
+            }
+        }
 
-        for(size_t i = 0; i < stream_segments.size(); ++i)
+        if(program.mem_report)
         {
-            if(i != ignore_stream_id)
+            main_segment_asm.report_memory(*program.mem_report, "MAIN");
+
+            for(size_t i = 0; i < mission_segments_asm.size(); ++i)
+                mission_segments_asm[i].report_memory(*program.mem_report, fmt::format("MISSION_{}", i));
+
+            for(size_t i = 0, k = 0; i < stream_segments.size(); ++i)
             {
-                auto& stream_asm = stream_segments_asm[i];
-                stream_asm.disassembly();
+                if(i != ignore_stream_id)
+                    stream_segments_asm[k++].report_memory(*program.mem_report, fmt::format("STREAM_{}", i));
             }
         }
 
         if(program.has_error())
             throw ProgramFailure();
 
+        if(xrefs_output)
+        {
+            std::vector<std::pair<std::string, const Disassembler*>> blocks;
+            blocks.emplace_back("MAIN", &main_segment_asm);
+
+            for(size_t i = 0; i < mission_segments_asm.size(); ++i)
+                blocks.emplace_back(fmt::format("MISSION_{}", i), &mission_segments_asm[i]);
+
+            for(size_t i = 0, k = 0; i < stream_segments.size(); ++i)
+            {
+                if(i != ignore_stream_id)
+                    blocks.emplace_back(fmt::format("STREAM_{}", i), &stream_segments_asm[k++]);
+            }
+
+            emit_xrefs(blocks, *xrefs_output);
+        }
+
+        TimeTrace::Scope output_timer(trace, "write output");
+
+        if(lang == Options::Lang::BIR)
+        {
+            BirWriter bir;
+
+            if(!program.opt.headerless)
+            {
+                std::string temp_string;
+                for(auto& model : opt_header->models)
+                {
+                    temp_string = model;
+                    std::transform(temp_string.begin(), temp_string.end(), temp_string.begin(), toupper_ascii);
+                    bir.add_model(temp_string);
+                }
+
+                for(auto& stream : opt_header->streamed_scripts)
+                {
+                    temp_string = stream.name;
+                    std::transform(temp_string.begin(), temp_string.end(), temp_string.begin(), toupper_ascii);
+                    bir.add_stream(temp_string);
+                }
+            }
+
+            bir.add_block(BirBlockKind::Main, 0, main_segment.size, main_segment_asm.get_data());
+
+            for(size_t i = 0; i < mission_segments_asm.size(); ++i)
+                bir.add_block(BirBlockKind::Mission, i, mission_segments[i].size, mission_segments_asm[i].get_data());
+
+            for(size_t i = 0, k = 0; i < stream_segments.size(); ++i)
+            {
+                if(i != ignore_stream_id)
+                    bir.add_block(BirBlockKind::Stream, i, stream_segments[i].size, stream_segments_asm[k++].get_data());
+            }
+
+            bir.write(output);
+        }
+
         if(lang == Options::Lang::IR2)
         {
             if(!program.opt.headerless)
@@ -172,7 +539,7 @@ bool decompile(const void* bytecode, size_t bytecode_size,
                 {
                     temp_string = opt_header->models[i];
                     std::transform(temp_string.begin(), temp_string.end(), temp_string.begin(), toupper_ascii);
-                    callback(fmt::format("#DEFINE_MODEL {} -{}", temp_string, i+1));
+                    output.line(fmt::format("#DEFINE_MODEL {} -{}", temp_string, i+1));
                 }
             }
 
@@ -183,20 +550,20 @@ bool decompile(const void* bytecode, size_t bytecode_size,
                 {
                     temp_string = opt_header->streamed_scripts[i].name;
                     std::transform(temp_string.begin(), temp_string.end(), temp_string.begin(), toupper_ascii);
-                    callback(fmt::format("#DEFINE_STREAM {} {}", temp_string, i));
+                    output.line(fmt::format("#DEFINE_STREAM {} {}", temp_string, i));
                 }
             }
 
             auto main_ir2 = DecompilerIR2(program.commands, main_segment_asm.get_data(), 0, main_segment.size, "MAIN", true);
-            main_ir2.decompile(callback);
+            main_ir2.decompile(output);
 
             for(size_t i = 0; i < mission_segments_asm.size(); ++i)
             {
                 auto& mission_asm = mission_segments_asm[i];
                 auto script_name = fmt::format("MISSION_{}", i);
-                callback(fmt::format("#MISSION_BLOCK_START {}", (int)(i)));
-                DecompilerIR2(program.commands, mission_asm.get_data(), 0, mission_segments[i].size, std::move(script_name), false, main_ir2).decompile(callback);
-                callback("#MISSION_BLOCK_END");
+                output.line(fmt::format("#MISSION_BLOCK_START {}", (int)(i)));
+                DecompilerIR2(program.commands, mission_asm.get_data(), 0, mission_segments[i].size, std::move(script_name), false, main_ir2).decompile(output);
+                output.line("#MISSION_BLOCK_END");
             }
 
             for(size_t i = 0; i < stream_segments_asm.size(); ++i)
@@ -205,9 +572,9 @@ bool decompile(const void* bytecode, size_t bytecode_size,
                 {
                     auto& stream_asm = stream_segments_asm[i];
                     auto script_name = fmt::format("STREAM_{}", i);
-                    callback(fmt::format("#STREAMED_BLOCK_START {}", (int)(i)));
-                    DecompilerIR2(program.commands, stream_asm.get_data(), 0, stream_segments[i].size, std::move(script_name), false, main_ir2).decompile(callback);
-                    callback("#STREAMED_BLOCK_END");
+                    output.line(fmt::format("#STREAMED_BLOCK_START {}", (int)(i)));
+                    DecompilerIR2(program.commands, stream_asm.get_data(), 0, stream_segments[i].size, std::move(script_name), false, main_ir2).decompile(output);
+                    output.line("#STREAMED_BLOCK_END");
                 }
             }
         }
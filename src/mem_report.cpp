@@ -0,0 +1,109 @@
+#include <stdinc.h>
+#include "mem_report.hpp"
+#include "time_trace.hpp"
+#include "system.hpp"
+
+void MemoryReport::add(const string_view& owner, const char* category, size_t count, size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    auto it_owner = std::find_if(this->owners.begin(), this->owners.end(), [&](const Owner& o) {
+        return o.name == owner;
+    });
+
+    if(it_owner == this->owners.end())
+        it_owner = this->owners.insert(it_owner, Owner { owner.to_string(), {} });
+
+    auto& categories = it_owner->categories;
+    auto it_category = std::find_if(categories.begin(), categories.end(), [&](const auto& pair) {
+        return !strcmp(pair.first, category);
+    });
+
+    if(it_category == categories.end())
+        it_category = categories.insert(it_category, std::make_pair(category, Counter()));
+
+    it_category->second.count += count;
+    it_category->second.bytes += bytes;
+}
+
+void MemoryReport::print(FILE* stream, const TimeTrace* trace) const
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    auto mebibytes = [](size_t bytes) { return double(bytes) / (1024.0 * 1024.0); };
+    auto kibibytes = [](size_t bytes) { return double(bytes) / 1024.0; };
+
+    auto usage = memory_usage();
+
+    fprintf(stream, "===-------------------------------------------------------------------------===\n");
+    fprintf(stream, "                            Memory usage report\n");
+    fprintf(stream, "===-------------------------------------------------------------------------===\n");
+    fprintf(stream, "  Peak resident set size: %.1f MiB\n", mebibytes(usage.peak_rss));
+    fprintf(stream, "  Sizes of the data structures are estimates, which exclude allocator overhead.\n");
+    fprintf(stream, "\n");
+
+    if(trace)
+    {
+        trace->print_memory_report(stream);
+        fprintf(stream, "\n");
+    }
+
+    // Totals of each category, in the order they were first accounted.
+    std::vector<std::pair<const char*, Counter>> totals;
+    size_t total_bytes = 0;
+    for(auto& owner : this->owners)
+    {
+        for(auto& pair : owner.categories)
+        {
+            auto it = std::find_if(totals.begin(), totals.end(), [&](const auto& t) {
+                return !strcmp(t.first, pair.first);
+            });
+            if(it == totals.end())
+                it = totals.insert(it, std::make_pair(pair.first, Counter()));
+            it->second.count += pair.second.count;
+            it->second.bytes += pair.second.bytes;
+            total_bytes += pair.second.bytes;
+        }
+    }
+
+    fprintf(stream, "   ---Size---------------  ---Count---  ---Category---\n");
+    for(auto& pair : totals)
+    {
+        fprintf(stream, "   %10.1f KiB (%5.1f%%)  %11u  %s\n", kibibytes(pair.second.bytes),
+                        total_bytes? 100.0 * double(pair.second.bytes) / double(total_bytes) : 0.0,
+                        unsigned(pair.second.count), pair.first);
+    }
+    fprintf(stream, "   %10.1f KiB            %11s  Total\n", kibibytes(total_bytes), "");
+
+    // Owners from the largest to the smallest.
+    std::vector<std::pair<const Owner*, size_t>> sorted_owners;
+    for(auto& owner : this->owners)
+    {
+        size_t bytes = 0;
+        for(auto& pair : owner.categories)
+            bytes += pair.second.bytes;
+        sorted_owners.emplace_back(&owner, bytes);
+    }
+
+    std::stable_sort(sorted_owners.begin(), sorted_owners.end(), [](const auto& a, const auto& b) {
+        return a.second > b.second;
+    });
+
+    if(!sorted_owners.empty())
+    {
+        fprintf(stream, "\n   ---Size---------------  ---Owner---\n");
+        for(auto& pair : sorted_owners)
+        {
+            fprintf(stream, "   %10.1f KiB (%5.1f%%)  %s\n", kibibytes(pair.second),
+                            total_bytes? 100.0 * double(pair.second) / double(total_bytes) : 0.0,
+                            pair.first->name.c_str());
+            for(auto& category : pair.first->categories)
+            {
+                fprintf(stream, "   %10.1f KiB              %s (%u)\n", kibibytes(category.second.bytes),
+                                category.first, unsigned(category.second.count));
+            }
+        }
+    }
+
+    fprintf(stream, "\n");
+}
@@ -0,0 +1,65 @@
+///
+/// Memory Report
+///
+/// Accounting of the memory taken by the data structures of the compiler and decompiler, for -fmem-report.
+///
+/// The sizes are computed by walking the data structures once they're built, so nothing is paid when the report
+/// isn't asked for. They're an estimate of the heap usage, which doesn't account for allocator overhead.
+///
+#pragma once
+#include <stdinc.h>
+#include <mutex>
+
+class TimeTrace;
+
+class MemoryReport
+{
+public:
+    /// Number of objects of a kind and the bytes they take.
+    struct Counter
+    {
+        size_t count = 0;
+        size_t bytes = 0;
+    };
+
+public:
+    /// Accounts `count` objects of `category` taking `bytes`, on behalf of `owner` (e.g. the name of a script).
+    ///
+    /// This method is thread-safe.
+    void add(const string_view& owner, const char* category, size_t count, size_t bytes);
+
+    /// Prints the peak resident set size of each phase in `trace` (if any), the totals of each category,
+    /// and the breakdown of each owner into `stream`.
+    void print(FILE* stream, const TimeTrace* trace) const;
+
+public:
+    /// Estimated bytes taken by the heap buffer of `s`.
+    static size_t bytes_of(const std::string& s)
+    {
+        return s.capacity() > std::string().capacity()? s.capacity() + 1 : 0;
+    }
+
+    /// Estimated bytes taken by the heap buffer of `v`, not including the heap buffers of its elements.
+    template<typename T>
+    static size_t bytes_of(const std::vector<T>& v)
+    {
+        return v.capacity() * sizeof(T);
+    }
+
+    /// Estimated bytes taken by a node of a node based container (such as `std::map`) holding a `T`.
+    template<typename T>
+    static constexpr size_t node_bytes()
+    {
+        return sizeof(T) + 4 * sizeof(void*);
+    }
+
+private:
+    struct Owner
+    {
+        std::string                                 name;
+        std::vector<std::pair<const char*, Counter>> categories;
+    };
+
+    mutable std::mutex  mutex;
+    std::vector<Owner>  owners;     //< In the order they were first accounted.
+};
@@ -0,0 +1,51 @@
+#include <stdinc.h>
+#include "opt_stats.hpp"
+
+void OptimizationStats::add(const char* pass, const char* counter, size_t n)
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    auto it = std::find_if(this->counters.begin(), this->counters.end(), [&](const Counter& c) {
+        return !strcmp(c.pass, pass) && !strcmp(c.name, counter);
+    });
+
+    if(it == this->counters.end())
+        it = this->counters.insert(it, Counter { pass, counter, 0 });
+
+    it->value += n;
+}
+
+void OptimizationStats::print(FILE* stream) const
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    // Counters of the same pass are printed together, in the order the passes first accounted something.
+    std::vector<const Counter*> sorted;
+    sorted.reserve(this->counters.size());
+    for(auto& counter : this->counters)
+        sorted.emplace_back(&counter);
+
+    std::stable_sort(sorted.begin(), sorted.end(), [&](const Counter* a, const Counter* b) {
+        auto first_of = [&](const char* pass) {
+            return std::find_if(this->counters.begin(), this->counters.end(), [&](const Counter& c) {
+                return !strcmp(c.pass, pass);
+            });
+        };
+        return first_of(a->pass) < first_of(b->pass);
+    });
+
+    fprintf(stream, "===-------------------------------------------------------------------------===\n");
+    fprintf(stream, "                          Optimization statistics\n");
+    fprintf(stream, "===-------------------------------------------------------------------------===\n");
+    fprintf(stream, "\n");
+
+    if(sorted.empty())
+        fprintf(stream, "   No optimization pass changed anything.\n");
+
+    for(auto& counter : sorted)
+    {
+        fprintf(stream, "   %9u  %-28s - %s\n", unsigned(counter->value), counter->pass, counter->name);
+    }
+
+    fprintf(stream, "\n");
+}
@@ -0,0 +1,31 @@
+///
+/// Optimization Statistics
+///
+/// Counters of what each optimization pass did over the whole run, for -fopt-stats.
+///
+#pragma once
+#include <stdinc.h>
+#include <mutex>
+
+class OptimizationStats
+{
+public:
+    /// Accounts `n` events of `counter` done by the pass `pass`.
+    ///
+    /// This method is thread-safe.
+    void add(const char* pass, const char* counter, size_t n);
+
+    /// Prints every counter into `stream`.
+    void print(FILE* stream) const;
+
+private:
+    struct Counter
+    {
+        const char* pass;
+        const char* name;
+        size_t      value;
+    };
+
+    mutable std::mutex      mutex;
+    std::vector<Counter>    counters;   //< In the order they were first accounted.
+};
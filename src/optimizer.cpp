@@ -0,0 +1,236 @@
+#include <stdinc.h>
+#include "optimizer.hpp"
+#include "codegen.hpp"
+#include "program.hpp"
+
+FlowKind flow_kind(const CompiledData& data, const Commands& commands)
+{
+    auto ccmd = get_command(data);
+    if(ccmd == nullptr)
+        return FlowKind::Normal;
+
+    const Command& command = ccmd->command;
+
+    if(commands.equal(command, commands.goto_))
+        return FlowKind::Goto;
+    if(commands.equal(command, commands.gosub) || commands.equal(command, commands.gosub_file)
+    || commands.equal(command, commands.cleo_call))
+        return FlowKind::Call;
+    if(commands.equal(command, commands.return_) || commands.equal(command, commands.cleo_return))
+        return FlowKind::Return;
+    if(commands.equal(command, commands.terminate_this_script)
+    || commands.equal(command, commands.terminate_this_custom_script))
+        return FlowKind::Terminate;
+
+    auto has_label = std::any_of(ccmd->args.begin(), ccmd->args.end(), [](const ArgVariant& arg) {
+        return is<shared_ptr<Label>>(arg);
+    });
+
+    return has_label? FlowKind::Branch : FlowKind::Normal;
+}
+
+ControlFlowGraph::ControlFlowGraph(const std::vector<CompiledData>& ir, const Commands& commands) :
+    ir(ir)
+{
+    std::vector<FlowKind> kinds(ir.size());
+
+    // A block begins at every run of label definitions and right after every control transfer.
+    size_t begin = 0;
+    for(size_t i = 0; i < ir.size(); ++i)
+    {
+        if(auto label = get_label_def(ir[i]))
+        {
+            if(i != begin && !get_label_def(ir[i - 1]))
+            {
+                this->blocks.emplace_back(BasicBlock { begin, i });
+                begin = i;
+            }
+            this->label_blocks.emplace(label->get(), this->blocks.size());
+        }
+        else if((kinds[i] = flow_kind(ir[i], commands)) != FlowKind::Normal)
+        {
+            this->blocks.emplace_back(BasicBlock { begin, i + 1 });
+            begin = i + 1;
+        }
+    }
+
+    if(begin != ir.size() || this->blocks.empty())
+        this->blocks.emplace_back(BasicBlock { begin, ir.size() });
+
+    for(size_t id = 0; id < this->blocks.size(); ++id)
+    {
+        auto& block = this->blocks[id];
+        auto last = this->last_instruction(block);
+        auto kind = last? kinds[*last] : FlowKind::Normal;
+
+        block.leaves_script = false;
+
+        if(kind == FlowKind::Goto || kind == FlowKind::Branch || kind == FlowKind::Call)
+        {
+            for_each_label(ir[*last], [&](const shared_ptr<Label>& label) {
+                auto target = this->find_block(*label);
+                if(kind == FlowKind::Call)
+                {
+                    if(target) block.calls.emplace_back(*target);
+                }
+                else if(target)
+                    block.succs.emplace_back(*target);
+                else
+                    block.leaves_script = true;
+            });
+        }
+
+        if(!is_terminator(kind))
+        {
+            if(id + 1 < this->blocks.size())
+                block.succs.emplace_back(id + 1);
+            else
+                block.leaves_script = true;
+        }
+
+        std::sort(block.succs.begin(), block.succs.end());
+        block.succs.erase(std::unique(block.succs.begin(), block.succs.end()), block.succs.end());
+        std::sort(block.calls.begin(), block.calls.end());
+        block.calls.erase(std::unique(block.calls.begin(), block.calls.end()), block.calls.end());
+    }
+
+    for(size_t id = 0; id < this->blocks.size(); ++id)
+    {
+        for(auto succ : this->blocks[id].succs)
+            this->blocks[succ].preds.emplace_back(id);
+    }
+}
+
+PassManager::PassManager(std::vector<CodeGenerator>& gens, SymTable& symbols, ProgramContext& program) :
+    program(program), commands(program.commands), symbols(symbols), gens(gens)
+{
+}
+
+void PassManager::add_pass(const Pass& pass)
+{
+    this->passes.emplace_back(pass);
+}
+
+void PassManager::add_default_passes()
+{
+    add_pass(Pass { "remove-unreachable-code", &Options::remove_unreachable_code, remove_unreachable_code });
+    add_pass(Pass { "inline-gosub", &Options::inline_gosub, inline_gosubs });
+    add_pass(Pass { "fold-identical-code", &Options::fold_identical_code, fold_identical_code });
+    add_pass(Pass { "thread-jumps", &Options::thread_jumps, thread_jumps });
+    add_pass(Pass { "remove-redundant-goto", &Options::remove_redundant_goto, remove_redundant_gotos });
+    add_pass(Pass { "share-local-vars", &Options::share_local_vars, share_local_vars });
+    add_pass(Pass { "compact-global-vars", &Options::compact_global_vars, compact_global_vars });
+}
+
+void PassManager::run()
+{
+    auto is_enabled = [&](const Pass& pass) { return program.opt.*pass.flag; };
+
+    if(std::none_of(this->passes.begin(), this->passes.end(), is_enabled))
+        return;
+
+    auto compute_size = [&] {
+        return std::accumulate(gens.begin(), gens.end(), size_t(0), [](size_t size, const CodeGenerator& gen) {
+            return size + gen.compute_size();
+        });
+    };
+
+    this->compute_label_refs();
+
+    for(auto& pass : this->passes)
+    {
+        if(!is_enabled(pass))
+            continue;
+
+        TimeTrace::Scope timer(program.time_trace.get(), pass.name);
+
+        auto size_before = program.opt_stats? compute_size() : 0;
+
+        this->current = &pass;
+        pass.run(*this);
+        this->current = nullptr;
+
+        if(program.opt_stats)
+        {
+            auto size_after = compute_size();
+            if(size_after < size_before)
+                program.opt_stats->add(pass.name, "bytes removed", size_before - size_after);
+            else if(size_after > size_before)
+                program.opt_stats->add(pass.name, "bytes added", size_after - size_before);
+        }
+    }
+}
+
+void PassManager::count(const char* counter, size_t n)
+{
+    Expects(this->current != nullptr);
+    if(program.opt_stats && n != 0)
+        program.opt_stats->add(this->current->name, counter, n);
+}
+
+bool PassManager::is_referenced(const Label& label) const
+{
+    return this->label_refs.find(&label) != this->label_refs.end();
+}
+
+void PassManager::compute_label_refs()
+{
+    this->label_refs.clear();
+
+    for(auto& gen : this->gens)
+    {
+        // The entry points of the scripts are referenced by the headers.
+        ++this->label_refs[gen.script->top_label.get()];
+        ++this->label_refs[gen.script->start_label.get()];
+
+        for(auto& data : gen.ir())
+        {
+            for_each_label(data, [&](const shared_ptr<Label>& label) {
+                ++this->label_refs[label.get()];
+            });
+        }
+    }
+}
+
+bool PassManager::may_reference(const Script& script, const Label& label) const
+{
+    return may_reference(script, *label.script.lock());
+}
+
+bool PassManager::may_reference(const Script& script, const Script& label_script) const
+{
+    // Mirrors the rules followed by the code generator when emitting label offsets.
+    if(label_script.uses_local_offsets())
+        return label_script.on_the_same_space_as(script);
+    return !script.uses_local_offsets() || !program.opt.use_local_offsets;
+}
+
+size_t PassManager::remove_unreferenced_labels()
+{
+    size_t num_removed = 0;
+
+    for(auto& gen : this->gens)
+    {
+        auto& ir = gen.ir();
+        auto it = std::remove_if(ir.begin(), ir.end(), [&](const CompiledData& data) {
+            auto label = get_label_def(data);
+            return label && !this->is_referenced(**label);
+        });
+        num_removed += std::distance(it, ir.end());
+        ir.erase(it, ir.end());
+    }
+
+    return num_removed;
+}
+
+void optimize(std::vector<CodeGenerator>& gens, SymTable& symbols, ProgramContext& program)
+{
+    PassManager pm(gens, symbols, program);
+
+    // Before any pass removes code, so the report matches the source.
+    if(program.opt.warn_unused_global_var)
+        warn_unused_global_vars(pm);
+
+    pm.add_default_passes();
+    pm.run();
+}
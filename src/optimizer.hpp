@@ -0,0 +1,251 @@
+///
+/// Optimizer
+///
+/// The optimizer transforms the intermediate representation of every script (see compiler.hpp) into a smaller and/or
+/// faster one. It runs over the whole program once every script has been compiled, and before the headers and label
+/// offsets are computed, so passes are free to add, remove and retarget instructions and labels.
+///
+/// Each pass is enabled by its own flag, and the -O levels are presets of such flags.
+///
+#pragma once
+#include <stdinc.h>
+#include <unordered_map>
+#include "compiler.hpp"
+
+/// How an instruction transfers control.
+enum class FlowKind : uint8_t
+{
+    Normal,     //< Falls through into the next instruction (including label definitions and HEX data).
+    Goto,       //< Unconditionally jumps into its label.
+    Branch,     //< Either jumps into one of its labels or falls through (e.g. GOTO_IF_FALSE, SWITCH_START).
+    Call,       //< Calls the subroutine at its label, then falls through (e.g. GOSUB, GOSUB_FILE, CLEO_CALL).
+    Return,     //< Returns from a subroutine (e.g. RETURN, CLEO_RETURN).
+    Terminate,  //< Ends the script (e.g. TERMINATE_THIS_SCRIPT).
+};
+
+/// \returns how `data` transfers control.
+///
+/// Commands taking labels for any other purpose (e.g. START_NEW_SCRIPT, GOTO_IF_TRUE) are conservatively
+/// seen as branches into such labels.
+extern FlowKind flow_kind(const CompiledData& data, const Commands& commands);
+
+/// \returns whether control never reaches the instruction after `data` by falling through.
+inline bool is_terminator(FlowKind kind)
+{
+    return kind == FlowKind::Goto || kind == FlowKind::Return || kind == FlowKind::Terminate;
+}
+
+/// \returns the command in `data`, or nullptr if it isn't a command.
+inline const CompiledCommand* get_command(const CompiledData& data)
+{
+    return is<CompiledCommand>(data.data)? &get<CompiledCommand>(data.data) : nullptr;
+}
+
+/// \returns the label defined by `data`, or nullptr if it isn't a label definition.
+inline const shared_ptr<Label>* get_label_def(const CompiledData& data)
+{
+    return is<CompiledLabelDef>(data.data)? &get<CompiledLabelDef>(data.data).label : nullptr;
+}
+
+/// Calls `fn` with a reference to each label referenced by the arguments of `data`.
+template<typename TData, typename Functor>
+inline void for_each_label(TData& data, Functor fn)
+{
+    if(is<CompiledCommand>(data.data))
+    {
+        for(auto& arg : get<CompiledCommand>(data.data).args)
+        {
+            if(is<shared_ptr<Label>>(arg))
+                fn(get<shared_ptr<Label>>(arg));
+        }
+    }
+}
+
+/// How an instruction accesses a variable.
+enum class VarAccess : uint8_t
+{
+    Use,        //< Reads the variable.
+    Def,        //< Overwrites the variable without reading it (e.g. outputs, the destination of SET).
+    UseDef,     //< May both read and write the variable (e.g. ADD_VAL_TO_INT_VAR).
+};
+
+/// \returns whether `command` assigns a value into its first argument and does nothing else (e.g. SET_VAR_INT).
+inline bool is_assignment(const Command& command, const Commands& commands)
+{
+    return commands.is_alternator(command, commands.set) || commands.is_alternator(command, commands.cset);
+}
+
+/// Calls `fn(var, access)` for each variable accessed by the arguments of `ccmd`.
+template<typename Functor>
+inline void for_each_var_access(const CompiledCommand& ccmd, const Commands& commands, Functor fn)
+{
+    const Command& command = ccmd.command;
+
+    // Most commands writing into a variable don't mark it as an output in the definitions (e.g. SET_VAR_INT or
+    // ADD_VAL_TO_INT_VAR), so any variable not known to be an output is seen as possibly written as well.
+    const bool is_set = is_assignment(command, commands);
+
+    for(size_t i = 0; i < ccmd.args.size(); ++i)
+    {
+        if(!is<CompiledVar>(ccmd.args[i]))
+            continue;
+
+        auto& cvar = get<CompiledVar>(ccmd.args[i]);
+        auto arg = command.arg(i);
+
+        if(cvar.index && is<shared_ptr<Var>>(*cvar.index))
+            fn(*get<shared_ptr<Var>>(*cvar.index), VarAccess::Use);
+
+        if((arg && arg->is_output) || (is_set && i == 0))
+            fn(*cvar.var, VarAccess::Def);
+        else
+            fn(*cvar.var, VarAccess::UseDef);
+    }
+}
+
+/// A sequence of instructions of a script which is only entered at its beginning and only left at its end.
+struct BasicBlock
+{
+    size_t              begin;          //< Index of the first instruction (or label definition) in the IR.
+    size_t              end;            //< Index past the last instruction in the IR.
+    std::vector<size_t> succs;          //< Blocks of this script which control flows into from this block.
+    std::vector<size_t> preds;          //< Blocks of this script which control flows from into this block.
+    std::vector<size_t> calls;          //< Blocks of this script called as subroutines by this block.
+    bool                leaves_script;  //< Whether control flows from this block into another script (by branching
+                                        //< into one of its labels or by falling off the end of this script).
+};
+
+/// Control flow graph of the intermediate representation of a single script.
+///
+/// The graph is a snapshot. It must be rebuilt after the IR it was built from is changed.
+class ControlFlowGraph
+{
+public:
+    explicit ControlFlowGraph(const std::vector<CompiledData>& ir, const Commands& commands);
+
+    auto begin() const  { return blocks.begin(); }
+    auto end() const    { return blocks.end(); }
+    size_t size() const { return blocks.size(); }
+
+    const BasicBlock& operator[](size_t id) const { return blocks[id]; }
+
+    /// \returns the block defining `label`, or nullopt if it's defined in another script.
+    optional<size_t> find_block(const Label& label) const
+    {
+        auto it = label_blocks.find(&label);
+        if(it != label_blocks.end())
+            return it->second;
+        return nullopt;
+    }
+
+    /// \returns the index of the last instruction of `block` which isn't a label definition, or nullopt if none.
+    optional<size_t> last_instruction(const BasicBlock& block) const
+    {
+        for(size_t i = block.end; i != block.begin; --i)
+        {
+            if(!get_label_def(this->ir[i - 1]))
+                return i - 1;
+        }
+        return nullopt;
+    }
+
+private:
+    const std::vector<CompiledData>&                ir;
+    std::vector<BasicBlock>                         blocks;
+    std::unordered_map<const Label*, size_t>        label_blocks;
+};
+
+/// Runs optimization passes over the intermediate representation of a program.
+class PassManager
+{
+public:
+    /// An optimization pass over the whole program.
+    struct Pass
+    {
+        const char*     name;           //< Name of the pass in the statistics and time report.
+        bool Options::* flag;           //< Option which enables the pass.
+        void          (*run)(PassManager&);
+    };
+
+public:
+    ProgramContext&             program;
+    const Commands&             commands;
+    SymTable&                   symbols;
+    std::vector<CodeGenerator>& gens;   //< The IR of each script, in the same order as the scripts.
+
+public:
+    explicit PassManager(std::vector<CodeGenerator>& gens, SymTable& symbols, ProgramContext& program);
+
+    /// Registers a pass to run after the ones previously registered.
+    void add_pass(const Pass& pass);
+
+    /// Registers every pass, in the order they should run.
+    void add_default_passes();
+
+    /// Runs the passes enabled by the program options.
+    void run();
+
+    /// Accounts `n` events of `counter` into the pass being run.
+    void count(const char* counter, size_t n = 1);
+
+    /// \returns whether `label` is referenced by an instruction (or is the entry of a script).
+    bool is_referenced(const Label& label) const;
+
+    /// Recomputes which labels are referenced. Passes removing or retargeting references should call this afterwards.
+    void compute_label_refs();
+
+    /// \returns whether code in `script` may reference `label` (e.g. after retargeting a branch into it).
+    bool may_reference(const Script& script, const Label& label) const;
+
+    /// \returns whether code in `script` may reference labels defined in `label_script`.
+    bool may_reference(const Script& script, const Script& label_script) const;
+
+    /// Removes the definitions of labels which aren't referenced anymore.
+    /// \returns the number of definitions removed.
+    size_t remove_unreferenced_labels();
+
+private:
+    std::vector<Pass>                       passes;
+    const Pass*                             current = nullptr;
+    std::unordered_map<const Label*, size_t> label_refs;  //< Number of references to each label.
+};
+
+/// Removes the basic blocks which can't be reached from the entry of any script, and warns about the commands written
+/// by the user among them if `warn` is set. See the remove_unreachable_code pass.
+/// \returns the number of instructions removed.
+extern size_t remove_unreachable_blocks(PassManager& pm, bool warn);
+
+/// Warns about the global variables which are never used, or never read, by the program.
+extern void warn_unused_global_vars(PassManager& pm);
+
+/// Runs the default passes enabled by the program options over `gens`.
+extern void optimize(std::vector<CodeGenerator>& gens, SymTable& symbols, ProgramContext& program);
+
+// Passes, see optimizer_*.cpp
+
+/// Removes the instructions which can't be reached from the entry of any script, such as code after a GOTO
+/// or subroutines never called.
+extern void remove_unreachable_code(PassManager& pm);
+
+/// Replaces the calls into small subroutines by a copy of the subroutine (see -finline-gosub), and removes the
+/// subroutines which aren't called anymore.
+extern void inline_gosubs(PassManager& pm);
+
+/// Replaces sequences of instructions ending in a GOTO, RETURN or TERMINATE_THIS_SCRIPT, which are identical to the
+/// end of another such sequence, by a GOTO into the latter.
+extern void fold_identical_code(PassManager& pm);
+
+/// Retargets branches into GOTOs to the final destination, and replaces GOTOs into RETURN or
+/// TERMINATE_THIS_SCRIPT by such instruction.
+extern void thread_jumps(PassManager& pm);
+
+/// Removes GOTOs into the instruction right after them.
+extern void remove_redundant_gotos(PassManager& pm);
+
+/// Assigns the same index to local variables which are never alive at the same time, reducing the local variables
+/// taken by each script.
+extern void share_local_vars(PassManager& pm);
+
+/// Removes the global variables never used or never read (along with any assignment into them), and renumbers the
+/// remaining ones densely, except for the ones given by --expect-var.
+extern void compact_global_vars(PassManager& pm);
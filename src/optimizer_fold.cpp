@@ -0,0 +1,217 @@
+#include <stdinc.h>
+#include <map>
+#include "optimizer.hpp"
+#include "codegen.hpp"
+#include "program.hpp"
+
+/// \returns whether `a` and `b` would generate the same bytecode.
+static bool same_code(const CompiledData& a, const CompiledData& b)
+{
+    auto same_var = [](const Var& a, const Var& b) {
+        return a.global == b.global && a.type == b.type && a.index == b.index;
+    };
+
+    auto same_arg = [&](const ArgVariant& a, const ArgVariant& b) {
+        if(a.which() != b.which())
+            return false;
+
+        if(is<float>(a))
+            return !memcmp(&get<float>(a), &get<float>(b), sizeof(float)); // 0.0 is not -0.0
+        if(is<shared_ptr<Label>>(a))
+            return get<shared_ptr<Label>>(a) == get<shared_ptr<Label>>(b);
+        if(is<CompiledString>(a))
+        {
+            auto& sa = get<CompiledString>(a);
+            auto& sb = get<CompiledString>(b);
+            return sa.type == sb.type && sa.preserve_case == sb.preserve_case && sa.storage == sb.storage;
+        }
+        if(is<CompiledVar>(a))
+        {
+            auto& va = get<CompiledVar>(a);
+            auto& vb = get<CompiledVar>(b);
+            if(!same_var(*va.var, *vb.var) || bool(va.index) != bool(vb.index))
+                return false;
+            if(!va.index)
+                return true;
+            if(is<int32_t>(*va.index) || is<int32_t>(*vb.index))
+                return *va.index == *vb.index;
+            return same_var(*get<shared_ptr<Var>>(*va.index), *get<shared_ptr<Var>>(*vb.index));
+        }
+
+        if(is<int8_t>(a))
+            return get<int8_t>(a) == get<int8_t>(b);
+        if(is<int16_t>(a))
+            return get<int16_t>(a) == get<int16_t>(b);
+        if(is<int32_t>(a))
+            return get<int32_t>(a) == get<int32_t>(b);
+        return true; // EOAL
+    };
+
+    auto ca = get_command(a);
+    auto cb = get_command(b);
+    if(ca == nullptr || cb == nullptr)
+        return false;
+
+    return ca->not_flag == cb->not_flag
+        && &ca->command.get() == &cb->command.get()
+        && std::equal(ca->args.begin(), ca->args.end(), cb->args.begin(), cb->args.end(), same_arg);
+}
+
+/// \returns a hash of the command in `data`, such that `same_code` commands have the same hash.
+static size_t hash_code(const CompiledData& data)
+{
+    auto command = get_command(data);
+    auto hash = std::hash<const Command*>()(&command->command.get()) ^ (command->not_flag? 1 : 0);
+    for(auto& arg : command->args)
+    {
+        hash = hash * 31 + arg.which();
+        if(is<int8_t>(arg))       hash = hash * 31 + get<int8_t>(arg);
+        else if(is<int16_t>(arg)) hash = hash * 31 + get<int16_t>(arg);
+        else if(is<int32_t>(arg)) hash = hash * 31 + get<int32_t>(arg);
+        else if(is<shared_ptr<Label>>(arg)) hash = hash * 31 + std::hash<const Label*>()(get<shared_ptr<Label>>(arg).get());
+    }
+    return hash;
+}
+
+void fold_identical_code(PassManager& pm)
+{
+    auto& gens = pm.gens;
+
+    // A sequence of instructions ending in a GOTO, RETURN or TERMINATE_THIS_SCRIPT.
+    // Since control never falls through out of it, any copy of its tail may be replaced by a GOTO into the tail.
+    struct Tail
+    {
+        size_t g;       //< Index of the script.
+        size_t begin;   //< First instruction, past the label definitions.
+        size_t end;     //< Past the terminator.
+    };
+
+    struct Fold
+    {
+        size_t              end;    //< Past the last instruction replaced.
+        shared_ptr<Label>   target;
+    };
+
+    std::unordered_map<size_t, std::vector<Tail>> tails; // by hash of the terminator
+    std::vector<std::map<size_t, shared_ptr<Label>>> new_labels(gens.size()); // label definitions to insert
+    std::vector<std::map<size_t, Fold>> folds(gens.size());                   // instructions to replace by a GOTO
+
+    const auto goto_size = [&] {
+        CompiledCommand goto_cmd { false, *pm.commands.goto_, { shared_ptr<Label>() } };
+        return gens.empty()? 0 : gens[0].compute_size(CompiledData(std::move(goto_cmd)));
+    }();
+
+    // \returns the label at the instruction `i` of the script `g`, defining a new one if necessary.
+    auto label_at = [&](size_t g, size_t i) -> shared_ptr<Label> {
+        auto& ir = gens[g].ir();
+        if(i > 0 && get_label_def(ir[i - 1]))
+            return *get_label_def(ir[i - 1]);
+
+        auto& label = new_labels[g][i];
+        if(label == nullptr)
+            label = std::make_shared<Label>(nullptr, gens[g].script);
+        return label;
+    };
+
+    size_t num_folded = 0;
+
+    for(size_t g = 0; g < gens.size(); ++g)
+    {
+        auto& gen = gens[g];
+        auto& ir = gen.ir();
+        ControlFlowGraph cfg(ir, pm.commands);
+
+        for(auto& block : cfg)
+        {
+            auto last = cfg.last_instruction(block);
+            if(!last || !is_terminator(flow_kind(ir[*last], pm.commands)))
+                continue;
+
+            auto begin = block.begin;
+            while(get_label_def(ir[begin]))
+                ++begin;
+
+            if(std::any_of(ir.begin() + begin, ir.begin() + block.end, [](const CompiledData& data) {
+                return !is<CompiledCommand>(data.data);
+            }))
+            {
+                continue;
+            }
+
+            Tail tail { g, begin, block.end };
+
+            // Looks for the previous tail sharing the longest suffix with this one.
+            auto& candidates = tails[hash_code(ir[*last])];
+            optional<Tail> best;
+            size_t best_length = 0, best_size = 0;
+
+            for(auto& other : candidates)
+            {
+                auto& other_ir = gens[other.g].ir();
+                // Only within the same root script, so a mission never jumps into main or another mission.
+                if(gen.script->root_script() != gens[other.g].script->root_script())
+                    continue;
+
+                size_t length = 0, size = 0;
+                while(length < tail.end - tail.begin && length < other.end - other.begin
+                   && same_code(ir[tail.end - length - 1], other_ir[other.end - length - 1]))
+                {
+                    size += gen.compute_size(ir[tail.end - length - 1]);
+                    ++length;
+                }
+
+                if(size > best_size)
+                {
+                    best = other;
+                    best_length = length;
+                    best_size = size;
+                }
+            }
+
+            if(best && best_size > goto_size)
+            {
+                auto target = label_at(best->g, best->end - best_length);
+                folds[g].emplace(tail.end - best_length, Fold { tail.end, std::move(target) });
+                ++num_folded;
+            }
+            else
+            {
+                candidates.emplace_back(tail);
+            }
+        }
+    }
+
+    for(size_t g = 0; g < gens.size(); ++g)
+    {
+        if(new_labels[g].empty() && folds[g].empty())
+            continue;
+
+        auto& ir = gens[g].ir();
+        std::vector<CompiledData> new_ir;
+        new_ir.reserve(ir.size() + new_labels[g].size());
+
+        for(size_t i = 0; i < ir.size(); )
+        {
+            auto label_it = new_labels[g].find(i);
+            if(label_it != new_labels[g].end())
+                new_ir.emplace_back(label_it->second);
+
+            auto fold_it = folds[g].find(i);
+            if(fold_it != folds[g].end())
+            {
+                new_ir.emplace_back(CompiledCommand { false, *pm.commands.goto_, { fold_it->second.target } });
+                i = fold_it->second.end;
+            }
+            else
+            {
+                new_ir.emplace_back(std::move(ir[i++]));
+            }
+        }
+
+        ir = std::move(new_ir);
+    }
+
+    pm.compute_label_refs();
+
+    pm.count("identical tails folded", num_folded);
+}
@@ -0,0 +1,200 @@
+#include <stdinc.h>
+#include <unordered_set>
+#include "optimizer.hpp"
+#include "codegen.hpp"
+#include "program.hpp"
+#include "symtable.hpp"
+
+/// How a global variable is accessed by the whole program.
+struct GlobalVarUsage
+{
+    size_t  reads = 0;          //< Number of instructions which may read the variable.
+    size_t  writes = 0;         //< Number of instructions which may write into the variable.
+    bool    only_assigned = true; //< Whether every write is a plain assignment (e.g. SET_VAR_INT), which can be removed.
+};
+
+/// \returns how each global variable is accessed by the IR in `gens`.
+static auto find_global_var_usage(const PassManager& pm) -> std::unordered_map<const Var*, GlobalVarUsage>
+{
+    std::unordered_map<const Var*, GlobalVarUsage> usage;
+
+    for(auto& gen : pm.gens)
+    {
+        for(auto& data : gen.ir())
+        {
+            auto ccmd = get_command(data);
+            if(ccmd == nullptr)
+                continue;
+
+            const bool is_set = is_assignment(ccmd->command, pm.commands);
+
+            for_each_var_access(*ccmd, pm.commands, [&](const Var& var, VarAccess access) {
+                if(!var.global)
+                    return;
+
+                auto& u = usage[&var];
+                if(access != VarAccess::Def)
+                    ++u.reads;
+                if(access != VarAccess::Use)
+                {
+                    ++u.writes;
+                    u.only_assigned = u.only_assigned && is_set && access == VarAccess::Def;
+                }
+            });
+
+            // Variables taken by reference may be read by the game at any time.
+            for(size_t i = 0; i < ccmd->args.size(); ++i)
+            {
+                auto arg = ccmd->command.get().arg(i);
+                if(arg && arg->is_ref && is<CompiledVar>(ccmd->args[i]))
+                    ++usage[get<CompiledVar>(ccmd->args[i]).var.get()].reads;
+            }
+        }
+    }
+
+    return usage;
+}
+
+/// \returns the global variables which must stay in place, i.e. the ones given by --expect-var.
+static auto find_pinned_global_vars(const PassManager& pm) -> std::unordered_set<const Var*>
+{
+    std::unordered_set<const Var*> pinned;
+    for(auto& expect : pm.program.opt.expect_vars)
+    {
+        for(auto& name : expect.first)
+        {
+            if(auto var = pm.symbols.find_var(name, nullptr))
+            {
+                pinned.emplace(var->get());
+                break;
+            }
+        }
+    }
+    return pinned;
+}
+
+/// \returns the global variables of `symbols` sorted by index.
+static auto sorted_global_vars(const SymTable& symbols) -> std::vector<std::pair<const std::string*, shared_ptr<Var>>>
+{
+    std::vector<std::pair<const std::string*, shared_ptr<Var>>> vars;
+    vars.reserve(symbols.global_vars.size());
+    for(auto& pair : symbols.global_vars)
+        vars.emplace_back(&pair.first, pair.second);
+
+    std::sort(vars.begin(), vars.end(), [](const auto& a, const auto& b) {
+        return a.second->index < b.second->index;
+    });
+    return vars;
+}
+
+void warn_unused_global_vars(PassManager& pm)
+{
+    auto usage = find_global_var_usage(pm);
+    auto pinned = find_pinned_global_vars(pm);
+
+    for(auto& pair : sorted_global_vars(pm.symbols))
+    {
+        auto& var = *pair.second;
+        if(pinned.count(&var))
+            continue;
+
+        auto it = usage.find(&var);
+        if(it == usage.end())
+            pm.program.warning(var.where, "global variable {} is never used [-Wunused-global-var]", *pair.first);
+        else if(it->second.reads == 0)
+            pm.program.warning(var.where, "global variable {} is never read [-Wunused-global-var]", *pair.first);
+    }
+}
+
+void compact_global_vars(PassManager& pm)
+{
+    auto& symbols = pm.symbols;
+
+    // HEX may reference any variable by its offset.
+    for(auto& gen : pm.gens)
+    {
+        if(std::any_of(gen.ir().begin(), gen.ir().end(), [](const CompiledData& data) {
+            return is<CompiledHex>(data.data);
+        }))
+        {
+            return;
+        }
+    }
+
+    auto usage = find_global_var_usage(pm);
+    auto pinned = find_pinned_global_vars(pm);
+
+    // Variables never used, or only ever assigned into, are removed along with their assignments.
+    auto is_dead = [&](const Var& var) {
+        if(pinned.count(&var))
+            return false;
+        auto it = usage.find(&var);
+        return it == usage.end() || (it->second.reads == 0 && it->second.only_assigned);
+    };
+
+    size_t num_assignments = 0;
+    for(auto& gen : pm.gens)
+    {
+        auto& ir = gen.ir();
+        auto it = std::remove_if(ir.begin(), ir.end(), [&](const CompiledData& data) {
+            auto ccmd = get_command(data);
+            return ccmd && is_assignment(ccmd->command, pm.commands) && !ccmd->args.empty()
+                && is<CompiledVar>(ccmd->args[0]) && get<CompiledVar>(ccmd->args[0]).var->global
+                && is_dead(*get<CompiledVar>(ccmd->args[0]).var);
+        });
+        num_assignments += std::distance(it, ir.end());
+        ir.erase(it, ir.end());
+    }
+
+    const auto size_before = symbols.size_global_vars();
+
+    size_t num_removed = 0;
+    for(auto it = symbols.global_vars.begin(); it != symbols.global_vars.end(); )
+    {
+        if(is_dead(*it->second))
+        {
+            it = symbols.global_vars.erase(it);
+            ++num_removed;
+        }
+        else
+            ++it;
+    }
+
+    // Renumbers the remaining variables densely, in their original order, around the pinned ones. Since the
+    // variables are visited in order, no variable ever moves up.
+    std::vector<std::pair<uint32_t, uint32_t>> pinned_ranges;
+    for(auto& pair : symbols.global_vars)
+    {
+        auto& var = *pair.second;
+        if(pinned.count(&var))
+            pinned_ranges.emplace_back(var.index, var.index + var.space_taken());
+    }
+
+    uint32_t next_index = symbols.offset_global_vars / 4;
+    for(auto& pair : sorted_global_vars(symbols))
+    {
+        auto& var = *pair.second;
+        if(pinned.count(&var))
+            continue;
+
+        for(bool overlaps = true; overlaps; )
+        {
+            overlaps = false;
+            for(auto& range : pinned_ranges)
+            {
+                if(next_index < range.second && next_index + var.space_taken() > range.first)
+                {
+                    next_index = range.second;
+                    overlaps = true;
+                }
+            }
+        }
+
+        var.index = next_index;
+        next_index += var.space_taken();
+    }
+
+    pm.count("global variables removed", num_removed);
+    pm.count("assignments into removed variables removed", num_assignments);
+    pm.count("global variable bytes reclaimed", size_before - symbols.size_global_vars());
+}
@@ -0,0 +1,262 @@
+#include <stdinc.h>
+#include <map>
+#include <unordered_set>
+#include "optimizer.hpp"
+#include "codegen.hpp"
+#include "program.hpp"
+
+/// A subroutine which can be copied into its call sites.
+struct Subroutine
+{
+    size_t  begin;      //< First label definition of the subroutine.
+    size_t  end;        //< Past its RETURN.
+    uint32_t size;      //< Bytes taken by the body, not counting the RETURN.
+};
+
+/// Each script may grow by inlining by at most 1/`max_growth_ratio` of its size (or by `-finline-gosub` bytes, if
+/// more), so that scripts calling into subroutines from many places don't blow up.
+static constexpr uint32_t max_growth_ratio = 4;
+
+/// \returns the subroutine starting at the label definitions at `begin`, or nullopt if it can't be inlined.
+///
+/// Only subroutines taking at most `max_size` bytes (not counting the RETURN), calling no other subroutine (thus never
+/// recursive), only branching into their own labels, and never leaving by GOTO or TERMINATE_THIS_SCRIPT can be inlined.
+/// Such a subroutine always ends at its RETURN.
+static optional<Subroutine> find_inline_candidate(const PassManager& pm, const CodeGenerator& gen,
+                                                  size_t begin, uint32_t max_size)
+{
+    auto& ir = gen.ir();
+    std::unordered_set<const Label*> defined;
+    std::vector<const Label*> referenced;
+    uint32_t size = 0;
+
+    for(size_t i = begin; i < ir.size(); ++i)
+    {
+        if(auto label = get_label_def(ir[i]))
+        {
+            defined.emplace(label->get());
+            continue;
+        }
+
+        if(!is<CompiledCommand>(ir[i].data))
+            return nullopt;
+
+        // The code after a GOTO or TERMINATE_THIS_SCRIPT may not belong to this subroutine at all.
+        auto kind = flow_kind(ir[i], pm.commands);
+        if(kind == FlowKind::Call || kind == FlowKind::Goto || kind == FlowKind::Terminate)
+            return nullopt;
+        if(kind == FlowKind::Return)
+        {
+            if(!pm.commands.equal(get_command(ir[i])->command, pm.commands.return_))
+                return nullopt;
+            if(!std::all_of(referenced.begin(), referenced.end(), [&](const Label* label) {
+                return defined.count(label) != 0;
+            }))
+            {
+                return nullopt;
+            }
+            return Subroutine { begin, i + 1, size };
+        }
+
+        size += gen.compute_size(ir[i]);
+        if(size > max_size)
+            return nullopt;
+
+        for_each_label(ir[i], [&](const shared_ptr<Label>& label) {
+            referenced.emplace_back(label.get());
+        });
+    }
+
+    return nullopt;
+}
+
+void inline_gosubs(PassManager& pm)
+{
+    auto& gens = pm.gens;
+    const auto max_size = pm.program.opt.inline_gosub_max_size;
+
+    size_t num_inlined = 0;
+    size_t num_removed = 0;
+
+    // The subroutines inlined into any call site, by their position in the new IR of each script.
+    std::vector<std::vector<Subroutine>> inlined(gens.size());
+
+    for(size_t g = 0; g < gens.size(); ++g)
+    {
+        auto& gen = gens[g];
+        auto& ir = gen.ir();
+
+        // The subroutine starting at each label, if any. Subroutines only call into their own script.
+        std::unordered_map<const Label*, size_t> label_begins;
+        std::map<size_t, optional<Subroutine>> candidates;
+
+        for(size_t i = 0, begin = 0; i < ir.size(); ++i)
+        {
+            if(auto label = get_label_def(ir[i]))
+            {
+                if(i == 0 || !get_label_def(ir[i - 1]))
+                    begin = i;
+                label_begins.emplace(label->get(), begin);
+            }
+        }
+
+        auto find_callee = [&](const CompiledData& data) -> optional<Subroutine> {
+            auto ccmd = get_command(data);
+            if(ccmd == nullptr || !pm.commands.equal(ccmd->command, pm.commands.gosub)
+            || ccmd->args.empty() || !is<shared_ptr<Label>>(ccmd->args[0]))
+                return nullopt;
+
+            auto it = label_begins.find(get<shared_ptr<Label>>(ccmd->args[0]).get());
+            if(it == label_begins.end())
+                return nullopt;
+
+            auto cit = candidates.find(it->second);
+            if(cit == candidates.end())
+                cit = candidates.emplace(it->second, find_inline_candidate(pm, gen, it->second, max_size)).first;
+            return cit->second;
+        };
+
+        if(std::none_of(ir.begin(), ir.end(), [&](const CompiledData& data) { return bool(find_callee(data)); }))
+            continue;
+
+        std::vector<CompiledData> new_ir;
+        new_ir.reserve(ir.size());
+
+        const auto script_size = gen.compute_size();
+        int64_t budget = std::max(script_size / max_growth_ratio, max_size);
+
+        std::map<size_t, size_t> new_begins; // position of each inlined subroutine in the new IR
+
+        for(size_t i = 0; i < ir.size(); ++i)
+        {
+            auto callee = find_callee(ir[i]);
+            if(callee)
+            {
+                // The call itself is replaced, so subroutines smaller than a GOSUB don't take from the budget.
+                auto growth = int64_t(callee->size) - int64_t(gen.compute_size(ir[i]));
+                if(growth > budget)
+                    callee = nullopt;
+                else if(growth > 0)
+                    budget -= growth;
+            }
+
+            if(!callee)
+            {
+                if(candidates.count(i) && candidates[i] && !new_begins.count(i))
+                    new_begins.emplace(i, new_ir.size());
+                new_ir.emplace_back(ir[i]);
+                continue;
+            }
+
+            // Copies the body of the subroutine (without its RETURN), giving the copy its own labels.
+            std::unordered_map<const Label*, shared_ptr<Label>> clones;
+            for(size_t k = callee->begin; k + 1 < callee->end; ++k)
+            {
+                for_each_label(ir[k], [&](const shared_ptr<Label>& label) {
+                    auto& clone = clones[label.get()];
+                    if(clone == nullptr)
+                        clone = std::make_shared<Label>(label->scope, label->script.lock());
+                });
+            }
+
+            for(size_t k = callee->begin; k + 1 < callee->end; ++k)
+            {
+                if(auto label = get_label_def(ir[k]))
+                {
+                    auto it = clones.find(label->get());
+                    if(it != clones.end())
+                        new_ir.emplace_back(it->second);
+                    continue;
+                }
+
+                CompiledCommand ccmd = *get_command(ir[k]);
+                for(auto& arg : ccmd.args)
+                {
+                    if(is<shared_ptr<Label>>(arg))
+                        arg = clones.at(get<shared_ptr<Label>>(arg).get());
+                }
+                new_ir.emplace_back(std::move(ccmd));
+            }
+
+            ++num_inlined;
+        }
+
+        for(auto& pair : new_begins)
+        {
+            auto& callee = *candidates[pair.first];
+            inlined[g].emplace_back(Subroutine { pair.second, pair.second + (callee.end - callee.begin), callee.size });
+        }
+
+        ir = std::move(new_ir);
+    }
+
+    // Subroutines never entered anymore (i.e. all of their calls were inlined) are removed.
+    std::unordered_map<const Label*, size_t> label_refs;
+    for(auto& gen : gens)
+    {
+        ++label_refs[gen.script->top_label.get()];
+        ++label_refs[gen.script->start_label.get()];
+
+        for(auto& data : gen.ir())
+        {
+            for_each_label(data, [&](const shared_ptr<Label>& label) {
+                ++label_refs[label.get()];
+            });
+        }
+    }
+
+    for(size_t g = 0; g < gens.size(); ++g)
+    {
+        auto& ir = gens[g].ir();
+        std::vector<bool> dead(ir.size());
+
+        for(auto& sub : inlined[g])
+        {
+            // Control must not fall into the subroutine.
+            if(sub.begin == 0 || get_label_def(ir[sub.begin - 1])
+            || !is_terminator(flow_kind(ir[sub.begin - 1], pm.commands)))
+                continue;
+
+            std::unordered_map<const Label*, size_t> inner_refs;
+            for(size_t k = sub.begin; k < sub.end; ++k)
+            {
+                for_each_label(ir[k], [&](const shared_ptr<Label>& label) {
+                    ++inner_refs[label.get()];
+                });
+            }
+
+            bool entered = false;
+            for(size_t k = sub.begin; k < sub.end && !entered; ++k)
+            {
+                if(auto label = get_label_def(ir[k]))
+                {
+                    auto it = label_refs.find(label->get());
+                    entered = it != label_refs.end() && it->second != inner_refs[label->get()];
+                }
+            }
+
+            if(!entered)
+            {
+                std::fill(dead.begin() + sub.begin, dead.begin() + sub.end, true);
+                ++num_removed;
+            }
+        }
+
+        if(std::find(dead.begin(), dead.end(), true) == dead.end())
+            continue;
+
+        std::vector<CompiledData> new_ir;
+        new_ir.reserve(ir.size());
+        for(size_t k = 0; k < ir.size(); ++k)
+        {
+            if(!dead[k])
+                new_ir.emplace_back(std::move(ir[k]));
+        }
+        ir = std::move(new_ir);
+    }
+
+    pm.compute_label_refs();
+
+    pm.count("calls inlined", num_inlined);
+    pm.count("subroutines removed", num_removed);
+}
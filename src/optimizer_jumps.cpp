@@ -0,0 +1,162 @@
+#include <stdinc.h>
+#include "optimizer.hpp"
+#include "codegen.hpp"
+#include "program.hpp"
+
+void thread_jumps(PassManager& pm)
+{
+    auto& commands = pm.commands;
+
+    // Where each label is defined.
+    std::unordered_map<const Label*, std::pair<size_t, size_t>> label_defs;
+    for(size_t g = 0; g < pm.gens.size(); ++g)
+    {
+        auto& ir = pm.gens[g].ir();
+        for(size_t i = 0; i < ir.size(); ++i)
+        {
+            if(auto label = get_label_def(ir[i]))
+                label_defs.emplace(label->get(), std::make_pair(g, i));
+        }
+    }
+
+    // The instruction executed after branching into `label`, or nullptr if it falls into another script.
+    auto instruction_at = [&](const Label& label) -> const CompiledData* {
+        auto it = label_defs.find(&label);
+        if(it == label_defs.end())
+            return nullptr;
+        auto& ir = pm.gens[it->second.first].ir();
+        for(size_t i = it->second.second; i < ir.size(); ++i)
+        {
+            if(!get_label_def(ir[i]))
+                return &ir[i];
+        }
+        return nullptr;
+    };
+
+    // The label a GOTO at `data` branches into, if it is one.
+    auto goto_target = [&](const CompiledData* data) -> const shared_ptr<Label>* {
+        if(data == nullptr || flow_kind(*data, commands) != FlowKind::Goto)
+            return nullptr;
+        auto& args = get_command(*data)->args;
+        if(args.empty() || !is<shared_ptr<Label>>(args[0]))
+            return nullptr;
+        return &get<shared_ptr<Label>>(args[0]);
+    };
+
+    // Follows the chain of GOTOs starting at `label`, while the destination may be referenced from `script`.
+    auto final_destination = [&](const Script& script, const shared_ptr<Label>& label) {
+        shared_ptr<Label> dest = label;
+        std::vector<const Label*> visited;
+        while(auto next = goto_target(instruction_at(*dest)))
+        {
+            visited.emplace_back(dest.get());
+            if(std::find(visited.begin(), visited.end(), next->get()) != visited.end())
+                break; // an infinite loop of GOTOs
+            if(!pm.may_reference(script, **next))
+                break;
+            dest = *next;
+        }
+        return dest;
+    };
+
+    auto is_threadable = [&](const Command& command) {
+        return commands.equal(command, commands.goto_) || commands.equal(command, commands.goto_if_false)
+            || commands.equal(command, commands.gosub) || commands.equal(command, commands.switch_start)
+            || commands.equal(command, commands.switch_continued);
+    };
+
+    auto is_exit = [&](const CompiledData* data) {
+        auto kind = data? flow_kind(*data, commands) : FlowKind::Normal;
+        return (kind == FlowKind::Return || kind == FlowKind::Terminate) && get_command(*data)->args.empty();
+    };
+
+    size_t num_threaded = 0, num_exits = 0;
+
+    for(auto& gen : pm.gens)
+    {
+        for(auto& data : gen.ir())
+        {
+            if(!is<CompiledCommand>(data.data) || !is_threadable(get<CompiledCommand>(data.data).command))
+                continue;
+
+            for(auto& arg : get<CompiledCommand>(data.data).args)
+            {
+                if(!is<shared_ptr<Label>>(arg))
+                    continue;
+
+                auto& label = get<shared_ptr<Label>>(arg);
+                auto dest = final_destination(*gen.script, label);
+                if(dest != label)
+                {
+                    label = std::move(dest);
+                    ++num_threaded;
+                }
+            }
+
+            // A GOTO into a RETURN (or such) is the same as that RETURN, which is also smaller.
+            if(auto target = goto_target(&data))
+            {
+                auto exit = instruction_at(**target);
+                if(is_exit(exit))
+                {
+                    data = CompiledData(get<CompiledCommand>(exit->data));
+                    ++num_exits;
+                }
+            }
+        }
+    }
+
+    pm.compute_label_refs();
+
+    pm.count("branches threaded", num_threaded);
+    pm.count("gotos replaced by their destination", num_exits);
+    pm.count("unreferenced labels removed", pm.remove_unreferenced_labels());
+
+    // Threading leaves dead code behind (e.g. the GOTO at a label not referenced anymore). It was reachable in the
+    // source, so don't warn about it.
+    if(pm.program.opt.remove_unreachable_code)
+        pm.count("unreachable instructions removed", remove_unreachable_blocks(pm, false));
+}
+
+void remove_redundant_gotos(PassManager& pm)
+{
+    for(auto& gen : pm.gens)
+    {
+        auto& ir = gen.ir();
+        std::vector<bool> is_redundant(ir.size(), false);
+
+        for(size_t i = 0; i < ir.size(); ++i)
+        {
+            if(flow_kind(ir[i], pm.commands) != FlowKind::Goto)
+                continue;
+
+            auto& args = get_command(ir[i])->args;
+            if(args.empty() || !is<shared_ptr<Label>>(args[0]))
+                continue;
+
+            // Only label definitions may be between the GOTO and its target.
+            auto& target = get<shared_ptr<Label>>(args[0]);
+            for(size_t k = i + 1; k < ir.size() && get_label_def(ir[k]); ++k)
+            {
+                if(*get_label_def(ir[k]) == target)
+                {
+                    is_redundant[i] = true;
+                    break;
+                }
+            }
+        }
+
+        auto num_redundant = std::count(is_redundant.begin(), is_redundant.end(), true);
+        if(num_redundant == 0)
+            continue;
+
+        size_t i = 0;
+        ir.erase(std::remove_if(ir.begin(), ir.end(), [&](const CompiledData&) {
+            return is_redundant[i++];
+        }), ir.end());
+
+        pm.count("redundant gotos removed", size_t(num_redundant));
+    }
+
+    pm.compute_label_refs();
+}
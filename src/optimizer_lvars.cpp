@@ -0,0 +1,397 @@
+#include <stdinc.h>
+#include <map>
+#include <set>
+#include "optimizer.hpp"
+#include "codegen.hpp"
+#include "program.hpp"
+
+/// A set of units (see share_local_vars below).
+class UnitSet
+{
+public:
+    explicit UnitSet(size_t size) : words((size + 63) / 64, 0)
+    {}
+
+    bool test(size_t u) const   { return (words[u / 64] >> (u % 64)) & 1; }
+    void set(size_t u)          { words[u / 64] |= uint64_t(1) << (u % 64); }
+    void reset(size_t u)        { words[u / 64] &= ~(uint64_t(1) << (u % 64)); }
+
+    /// Adds the units in `other` into this set. \returns whether this set changed.
+    bool merge(const UnitSet& other)
+    {
+        return merge_difference(other, nullptr);
+    }
+
+    /// Adds the units in `other` but not in `except` into this set. \returns whether this set changed.
+    bool merge_difference(const UnitSet& other, const UnitSet& except)
+    {
+        return merge_difference(other, &except);
+    }
+
+    /// Calls `fn(u)` for each unit `u` in this set.
+    template<typename Functor>
+    void for_each(Functor fn) const
+    {
+        for(size_t w = 0; w < words.size(); ++w)
+        {
+            for(auto word = words[w]; word != 0; word &= word - 1)
+            {
+                size_t bit = 0;
+                while(!((word >> bit) & 1))
+                    ++bit;
+                fn(w * 64 + bit);
+            }
+        }
+    }
+
+private:
+    bool merge_difference(const UnitSet& other, const UnitSet* except)
+    {
+        bool changed = false;
+        for(size_t w = 0; w < words.size(); ++w)
+        {
+            auto word = words[w] | (other.words[w] & (except? ~except->words[w] : ~uint64_t(0)));
+            changed |= (word != words[w]);
+            words[w] = word;
+        }
+        return changed;
+    }
+
+    std::vector<uint64_t> words;
+};
+
+/// \returns whether `command` starts a new script (which gets its own copy of the local variables).
+static bool is_script_start(const Command& command, const Commands& commands)
+{
+    return commands.equal(command, commands.start_new_script) || commands.equal(command, commands.launch_mission);
+}
+
+/// Shares the slots of the local variables of the script `gens[g]`, given `entries` are the labels of the script
+/// entered from other scripts. \returns the number of slots saved.
+static size_t share_local_vars(PassManager& pm, size_t g, const std::set<const Label*>& entries)
+{
+    auto& gen = pm.gens[g];
+    auto& ir = gen.ir();
+    auto& script = *gen.script;
+    auto& opt = pm.program.opt;
+    auto& commands = pm.commands;
+
+    auto is_timer = [&](uint32_t slot) {
+        return slot == uint32_t(opt.timer_index) || slot == uint32_t(opt.timer_index + 1);
+    };
+
+    // Variables taken by reference may be accessed by the game at any time.
+    std::set<const Var*> refs;
+    for(auto& data : ir)
+    {
+        if(auto ccmd = get_command(data))
+        {
+            for(size_t i = 0; i < ccmd->args.size(); ++i)
+            {
+                auto arg = ccmd->command.get().arg(i);
+                if(arg && arg->is_ref && is<CompiledVar>(ccmd->args[i]))
+                    refs.emplace(get<CompiledVar>(ccmd->args[i]).var.get());
+            }
+        }
+    }
+
+    // The variables of different scopes may share a slot, and the slot is what's live, so the unit of allocation is
+    // the original slot of the variables. Arrays and text labels (and anything sharing their slots) stay in place.
+    // Call scopes have their own storage, so they are left alone.
+    std::map<uint32_t, std::vector<Var*>> slot_vars;
+    std::set<uint32_t> fixed_slots;
+    uint32_t end_before = 0;
+
+    for(auto& scope : script.scopes)
+    {
+        if(scope->is_call_scope())
+            continue;
+
+        for(auto& pair : scope->vars)
+        {
+            auto& var = *pair.second;
+            if(is_timer(var.index))
+                continue;
+
+            end_before = std::max(end_before, var.index + var.space_taken());
+
+            if((var.type == VarType::Int || var.type == VarType::Float) && !var.count && !refs.count(&var))
+            {
+                slot_vars[var.index].emplace_back(&var);
+            }
+            else
+            {
+                for(uint32_t slot = var.index; slot != var.index + var.space_taken(); ++slot)
+                    fixed_slots.emplace(slot);
+            }
+        }
+    }
+
+    std::vector<uint32_t> unit_slots;
+    std::unordered_map<const Var*, size_t> unit_of;
+    for(auto& pair : slot_vars)
+    {
+        if(fixed_slots.count(pair.first))
+            continue;
+        for(auto var : pair.second)
+            unit_of.emplace(var, unit_slots.size());
+        unit_slots.emplace_back(pair.first);
+    }
+
+    const size_t num_units = unit_slots.size();
+    if(num_units == 0)
+        return 0;
+
+    // The units accessed by each instruction.
+    std::vector<std::vector<std::pair<size_t, VarAccess>>> accesses(ir.size());
+    for(size_t i = 0; i < ir.size(); ++i)
+    {
+        if(auto ccmd = get_command(ir[i]))
+        {
+            for_each_var_access(*ccmd, commands, [&](const Var& var, VarAccess access) {
+                auto it = unit_of.find(&var);
+                if(it != unit_of.end())
+                    accesses[i].emplace_back(it->second, access);
+            });
+        }
+    }
+
+    // Steps `live` backwards over the instruction `i`, calling `on_def(u)` for each unit it writes into while
+    // `live` holds the units live after it.
+    auto step = [&](UnitSet& live, size_t i, auto on_def) {
+        for(auto& access : accesses[i])
+        {
+            if(access.second != VarAccess::Use)
+                on_def(access.first);
+        }
+        for(auto& access : accesses[i])
+        {
+            if(access.second == VarAccess::Def)
+                live.reset(access.first);
+        }
+        for(auto& access : accesses[i])
+        {
+            if(access.second != VarAccess::Def)
+                live.set(access.first);
+        }
+    };
+
+    // Backward liveness of the units over the control flow graph.
+    ControlFlowGraph cfg(ir, commands);
+    std::vector<UnitSet> uses(cfg.size(), UnitSet(num_units)), kills(cfg.size(), UnitSet(num_units));
+    std::vector<UnitSet> live_in(cfg.size(), UnitSet(num_units)), live_out(cfg.size(), UnitSet(num_units));
+    std::vector<std::vector<size_t>> succs(cfg.size());
+    std::vector<size_t> continuations; // where subroutines return into
+    std::vector<size_t> starts;        // where scripts started by this one are entered
+    std::vector<bool> is_return(cfg.size(), false);
+
+    for(size_t id = 0; id < cfg.size(); ++id)
+    {
+        auto& block = cfg[id];
+        for(size_t i = block.end; i != block.begin; --i)
+        {
+            step(uses[id], i - 1, [](size_t) {});
+            for(auto& access : accesses[i - 1])
+            {
+                if(access.second == VarAccess::Def)
+                    kills[id].set(access.first);
+            }
+        }
+
+        auto last = cfg.last_instruction(block);
+        auto kind = last? flow_kind(ir[*last], commands) : FlowKind::Normal;
+        is_return[id] = (kind == FlowKind::Return);
+
+        // The started script runs with its own local variables, so it doesn't continue the flow of this one.
+        auto ccmd = last? get_command(ir[*last]) : nullptr;
+        if(ccmd && is_script_start(ccmd->command, commands))
+        {
+            for_each_label(ir[*last], [&](const shared_ptr<Label>& label) {
+                if(auto target = cfg.find_block(*label))
+                    starts.emplace_back(*target);
+            });
+            if(id + 1 < cfg.size())
+                succs[id].emplace_back(id + 1);
+        }
+        else
+        {
+            succs[id] = block.succs;
+        }
+        if(!block.calls.empty() && id + 1 < cfg.size())
+            continuations.emplace_back(id + 1);
+    }
+
+    for(bool changed = true; changed; )
+    {
+        changed = false;
+
+        UnitSet live_at_returns(num_units);
+        for(auto cont : continuations)
+            live_at_returns.merge(live_in[cont]);
+
+        for(size_t id = cfg.size(); id-- != 0; )
+        {
+            auto& block = cfg[id];
+            auto& out = live_out[id];
+            for(auto succ : succs[id])
+                out.merge(live_in[succ]);
+            for(auto callee : block.calls)
+                out.merge(live_in[callee]);
+            if(is_return[id])
+                out.merge(live_at_returns);
+
+            changed |= live_in[id].merge(uses[id]);
+            changed |= live_in[id].merge_difference(out, kills[id]);
+        }
+    }
+
+    // A unit written while another is live can't share its slot.
+    std::vector<UnitSet> interferes(num_units, UnitSet(num_units));
+    for(size_t id = 0; id < cfg.size(); ++id)
+    {
+        auto& block = cfg[id];
+        UnitSet live = live_out[id];
+        for(size_t i = block.end; i != block.begin; --i)
+        {
+            step(live, i - 1, [&](size_t d) {
+                live.for_each([&](size_t u) {
+                    if(u != d)
+                    {
+                        interferes[d].set(u);
+                        interferes[u].set(d);
+                    }
+                });
+            });
+        }
+    }
+
+    // Units live when entering the script hold values given by the script starting it (or zero), so they keep
+    // their slots.
+    std::vector<bool> pinned(num_units, false);
+    auto pin_block = [&](size_t id) {
+        for(size_t u = 0; u < num_units; ++u)
+            if(live_in[id].test(u)) pinned[u] = true;
+    };
+
+    pin_block(0);
+    if(auto id = cfg.find_block(*script.top_label)) pin_block(*id);
+    if(auto id = cfg.find_block(*script.start_label)) pin_block(*id);
+    for(auto label : entries)
+    {
+        if(auto id = cfg.find_block(*label))
+            pin_block(*id);
+    }
+    for(auto id : starts)
+        pin_block(id);
+
+    // Greedily assigns the lowest available slot, in the order of the original slots. Since every unit colored
+    // before another had a lower original slot, which it doesn't exceed, the original slot of a unit is always
+    // available to it, and no variable ever moves up.
+    const uint32_t base = script.is_child_of_mission()? opt.mission_var_begin : 0;
+    std::vector<uint32_t> new_slots(unit_slots);
+
+    for(size_t u = 0; u < num_units; ++u)
+    {
+        if(pinned[u])
+            continue;
+
+        for(uint32_t slot = base; slot < unit_slots[u]; ++slot)
+        {
+            if(fixed_slots.count(slot) || is_timer(slot))
+                continue;
+
+            bool taken = false;
+            for(size_t v = 0; v < num_units && !taken; ++v)
+                taken = (new_slots[v] == slot && interferes[u].test(v));
+
+            if(!taken)
+            {
+                new_slots[u] = slot;
+                break;
+            }
+        }
+    }
+
+    for(auto& pair : slot_vars)
+    {
+        for(auto var : pair.second)
+        {
+            auto it = unit_of.find(var);
+            if(it != unit_of.end())
+                var->index = new_slots[it->second];
+        }
+    }
+
+    uint32_t end_after = 0;
+    for(auto& scope : script.scopes)
+    {
+        if(scope->is_call_scope())
+            continue;
+        for(auto& pair : scope->vars)
+        {
+            if(!is_timer(pair.second->index))
+                end_after = std::max(end_after, pair.second->index + pair.second->space_taken());
+        }
+    }
+
+    return end_before - end_after;
+}
+
+void share_local_vars(PassManager& pm)
+{
+    auto& gens = pm.gens;
+    auto& commands = pm.commands;
+
+    std::unordered_map<const Label*, size_t> label_gens; // the script defining each label
+    for(size_t g = 0; g < gens.size(); ++g)
+    {
+        for(auto& data : gens[g].ir())
+        {
+            if(auto label = get_label_def(data))
+                label_gens.emplace(label->get(), g);
+        }
+    }
+
+    // Scripts sharing their local variables with code in other scripts (i.e. by running on the same thread) can't
+    // be analyzed on their own. Such as required scripts, or scripts branching into each other.
+    std::vector<bool> is_shared(gens.size(), false);
+    std::vector<std::set<const Label*>> entries(gens.size());
+
+    for(size_t g = 0; g < gens.size(); ++g)
+    {
+        auto& ir = gens[g].ir();
+
+        if(gens[g].script->type == ScriptType::Required)
+            is_shared[g] = true;
+
+        // Falls off the end into the next script.
+        auto last = std::find_if(ir.rbegin(), ir.rend(), [](const CompiledData& data) { return !get_label_def(data); });
+        if(last != ir.rend() && !is_terminator(flow_kind(*last, commands)))
+            is_shared[g] = true;
+
+        for(auto& data : ir)
+        {
+            if(is<CompiledHex>(data.data))
+                is_shared[g] = true; // may access any variable
+
+            for_each_label(data, [&](const shared_ptr<Label>& label) {
+                auto it = label_gens.find(label.get());
+                if(it == label_gens.end() || it->second == g)
+                    return;
+
+                entries[it->second].emplace(label.get());
+                if(!is_script_start(get_command(data)->command, commands))
+                    is_shared[g] = is_shared[it->second] = true;
+            });
+        }
+    }
+
+    size_t num_saved = 0;
+    for(size_t g = 0; g < gens.size(); ++g)
+    {
+        if(!is_shared[g])
+            num_saved += share_local_vars(pm, g, entries[g]);
+    }
+
+    pm.count("local variable slots saved", num_saved);
+}
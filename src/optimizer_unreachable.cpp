@@ -0,0 +1,142 @@
+#include <stdinc.h>
+#include "optimizer.hpp"
+#include "codegen.hpp"
+#include "program.hpp"
+
+size_t remove_unreachable_blocks(PassManager& pm, bool warn)
+{
+    auto& gens = pm.gens;
+
+    std::vector<ControlFlowGraph> cfgs;
+    std::unordered_map<const Label*, size_t> label_gens; // the script defining each label
+    cfgs.reserve(gens.size());
+
+    for(size_t g = 0; g < gens.size(); ++g)
+    {
+        cfgs.emplace_back(gens[g].ir(), pm.commands);
+        for(auto& data : gens[g].ir())
+        {
+            if(auto label = get_label_def(data))
+                label_gens.emplace(label->get(), g);
+        }
+    }
+
+    std::vector<std::vector<bool>> reachable(gens.size());
+    std::vector<std::pair<size_t, size_t>> worklist;
+
+    auto mark = [&](size_t g, size_t id) {
+        if(!reachable[g][id])
+        {
+            reachable[g][id] = true;
+            worklist.emplace_back(g, id);
+        }
+    };
+
+    auto mark_label = [&](const Label& label) {
+        auto it = label_gens.find(&label);
+        if(it != label_gens.end())
+        {
+            if(auto id = cfgs[it->second].find_block(label))
+                mark(it->second, *id);
+        }
+    };
+
+    // Scripts are entered at their top (by the headers, or by falling off the end of the previous one).
+    // HEX may hide references to anywhere, so it's always kept.
+    for(size_t g = 0; g < gens.size(); ++g)
+    {
+        auto& ir = gens[g].ir();
+        auto& cfg = cfgs[g];
+
+        reachable[g].resize(cfg.size(), false);
+        mark(g, 0);
+        mark_label(*gens[g].script->top_label);
+        mark_label(*gens[g].script->start_label);
+
+        for(size_t id = 0; id < cfg.size(); ++id)
+        {
+            if(std::any_of(ir.begin() + cfg[id].begin, ir.begin() + cfg[id].end, [](const CompiledData& data) {
+                return is<CompiledHex>(data.data);
+            }))
+            {
+                mark(g, id);
+            }
+        }
+    }
+
+    while(!worklist.empty())
+    {
+        size_t g, id;
+        std::tie(g, id) = worklist.back();
+        worklist.pop_back();
+
+        auto& cfg = cfgs[g];
+        auto& block = cfg[id];
+
+        for(auto succ : block.succs)
+            mark(g, succ);
+        for(auto callee : block.calls)
+            mark(g, callee);
+
+        // e.g. GOSUB_FILE, LAUNCH_MISSION or START_NEW_SCRIPT into a label of another script.
+        auto& ir = gens[g].ir();
+        for(size_t i = block.begin; i < block.end; ++i)
+        {
+            for_each_label(ir[i], [&](const shared_ptr<Label>& label) {
+                if(!cfg.find_block(*label))
+                    mark_label(*label);
+            });
+        }
+    }
+
+    size_t num_removed = 0;
+
+    for(size_t g = 0; g < gens.size(); ++g)
+    {
+        auto& ir = gens[g].ir();
+        auto& cfg = cfgs[g];
+
+        std::vector<bool> is_dead(ir.size(), false);
+        bool warned = false; // only once per sequence of unreachable blocks
+
+        for(size_t id = 0; id < cfg.size(); ++id)
+        {
+            if(reachable[g][id])
+            {
+                warned = false;
+                continue;
+            }
+
+            for(size_t i = cfg[id].begin; i < cfg[id].end; ++i)
+            {
+                is_dead[i] = true;
+
+                auto command = get_command(ir[i]);
+                if(command == nullptr)
+                    continue;
+
+                if(warn && !warned && command->where)
+                {
+                    pm.program.warning(*command->where, "code will never be executed [-Wunreachable-code]");
+                    warned = true;
+                }
+
+                ++num_removed;
+            }
+        }
+
+        size_t i = 0;
+        ir.erase(std::remove_if(ir.begin(), ir.end(), [&](const CompiledData&) {
+            return is_dead[i++];
+        }), ir.end());
+    }
+
+    pm.compute_label_refs();
+
+    return num_removed;
+}
+
+void remove_unreachable_code(PassManager& pm)
+{
+    pm.count("unreachable instructions removed", remove_unreachable_blocks(pm, pm.program.opt.warn_unreachable_code));
+}
@@ -8,60 +8,104 @@ enum class Section
     SomeUnreadable,
 };
 
-static bool nextline(const char*& line, char* output, size_t output_size)
+/// Whether `c` separates tokens in a IDE/DAT line.
+static bool is_data_separator(char c)
 {
-    const char* output_beg = output;
-    const char* output_max = (output + output_size) - 1;
-
-    while(*line == ' ' || *line == '\t' || *line == '\r' || *line == '\n')
-        ++line;
+    return (c >= 0 && c <= ' ') || c == ',';
+}
 
-    if(*line == '#')
+/// Fetches the next non-empty, non-comment line from the buffer `[it, end)`, without allocating memory.
+///
+/// The output line has its surrounding separators trimmed and points into the buffer.
+static bool nextline(const char*& it, const char* end, string_view& line)
+{
+    while(it != end)
     {
-        while(*line != 0 && *line != '\n')
-            ++line;
-    }
+        auto line_begin = it;
+        auto line_end = std::find(it, end, '\n');
+        it = (line_end != end? line_end + 1 : end);
 
-    for(; output < output_max; )
-    {
-        if(*line == 0 || *line == '\n')
-            break;
+        while(line_begin != line_end && is_data_separator(*line_begin))
+            ++line_begin;
+        while(line_end != line_begin && is_data_separator(*(line_end - 1)))
+            --line_end;
 
-        if(*line < ' ' || *line == ',')
-        {
-            *output++ = ' ';
-            ++line;
-        }
-        else
+        if(line_begin != line_end && *line_begin != '#')
         {
-            *output++ = *line++;
+            line = string_view(line_begin, line_end - line_begin);
+            return true;
         }
     }
+    return false;
+}
 
-    *output = '\0';
+/// Consumes the next token in `line`, or returns an empty view if there's none.
+static string_view nexttoken(string_view& line)
+{
+    auto begin = std::find_if_not(line.begin(), line.end(), is_data_separator);
+    auto end   = std::find_if(begin, line.end(), is_data_separator);
+    auto token = string_view(begin, end - begin);
+    line = string_view(end, line.end() - end);
+    return token;
+}
 
-    if(output != output_beg)
-    {
-        for(--output; output != output_beg; --output)
-        {
-            if(*output == ' ')
-                *output = '\0';
-            else
-                break;
-        }
+/// Consumes the rest of `line`, without the leading separators.
+static string_view resttoken(string_view& line)
+{
+    auto begin = std::find_if_not(line.begin(), line.end(), is_data_separator);
+    auto rest = string_view(begin, line.end() - begin);
+    line = string_view(line.end(), 0);
+    return rest;
+}
+
+static optional<int64_t> token_to_int(const string_view& token)
+{
+    bool negative = (!token.empty() && token.front() == '-');
+    auto digits = token.substr(negative? 1 : 0);
 
+    if(digits.empty())
+        return nullopt;
 
+    int64_t value = 0;
+    for(auto c : digits)
+    {
+        if(c < '0' || c > '9')
+            return nullopt;
+        value = value * 10 + (c - '0');
     }
+    return negative? -value : value;
+}
 
-    if(output != output_beg)
-        return true;
-    else if(*line == 0)
-        return false;
-    else // empty line but not EOF, try next line then
-        return nextline(line, output, output_size);
+static bool starts_with(const string_view& line, const char* prefix)
+{
+    return line.compare(0, strlen(prefix), prefix) == 0;
+}
+
+ModelTable::ModelTable(std::vector<value_type> models_) :
+    models(std::move(models_))
+{
+    std::stable_sort(models.begin(), models.end(), [](const value_type& a, const value_type& b) {
+        return iless()(a.first, b.first);
+    });
+
+    auto last = std::unique(models.begin(), models.end(), [](const value_type& a, const value_type& b) {
+        return iequal_to()(a.first, b.first);
+    });
+
+    models.erase(last, models.end());
+}
+
+optional<uint32_t> ModelTable::find(const string_view& name) const
+{
+    auto it = std::lower_bound(models.begin(), models.end(), name, [](const value_type& a, const string_view& b) {
+        return iless()(a.first, b);
+    });
+    if(it != models.end() && iequal_to()(it->first, name))
+        return it->second;
+    return nullopt;
 }
 
-void load_ide(const fs::path& filepath, bool is_default_ide, std::map<std::string, uint32_t, iless>& output)
+void load_ide(const fs::path& filepath, bool is_default_ide, std::vector<ModelTable::value_type>& output)
 {
     std::string file_data;
 
@@ -74,17 +118,19 @@ void load_ide(const fs::path& filepath, bool is_default_ide, std::map<std::strin
         throw ConfigError("Failed to read IDE file '{}'.", filepath.generic_u8string());
     }
 
-    char buffer[512];
+    string_view line;
     Section section = Section::None;
 
-    for(const char* it = file_data.c_str();
-        nextline(it, buffer, std::size(buffer)); )
+    const char* it = file_data.data();
+    const char* end = file_data.data() + file_data.size();
+
+    while(nextline(it, end, line))
     {
         switch(section)
         {
             case Section::None:
             {
-                if(is_default_ide || !strncmp(buffer, "objs", 4) || !strncmp(buffer, "tobj", 4) || !strncmp(buffer, "anim", 4))
+                if(is_default_ide || starts_with(line, "objs") || starts_with(line, "tobj") || starts_with(line, "anim"))
                     section = Section::SomeReadable;
                 else
                     section = Section::SomeUnreadable;
@@ -93,29 +139,23 @@ void load_ide(const fs::path& filepath, bool is_default_ide, std::map<std::strin
 
             case Section::SomeReadable:
             {
-                char model_name[64];
-                unsigned int id;
-
-                if(!strncmp(buffer, "end", 3))
+                if(starts_with(line, "end"))
                 {
                     section = Section::None;
                     break;
                 }
 
-                if(sscanf(buffer, "%u %63s", &id, model_name) != EOF)
-                {
-                    output.emplace(model_name, id);
-                }
-                else
-                {
-                    __debugbreak();
-                }
+                auto id = token_to_int(nexttoken(line));
+                auto model_name = nexttoken(line);
+
+                if(id && *id >= 0 && !model_name.empty())
+                    output.emplace_back(model_name.to_string(), static_cast<uint32_t>(*id));
                 break;
             }
 
             case Section::SomeUnreadable:
             {
-                if(!strncmp(buffer, "end", 3))
+                if(starts_with(line, "end"))
                 {
                     section = Section::None;
                     break;
@@ -129,51 +169,194 @@ void load_ide(const fs::path& filepath, bool is_default_ide, std::map<std::strin
     }
 }
 
-auto load_dat(const fs::path& filepath, bool is_default_dat) -> std::map<std::string, uint32_t, iless>
+/// Reads the models of the IDE files referenced by the DAT file at `filepath`.
+/// Pushes the path of every file read into `files_read`.
+static auto read_dat(const fs::path& filepath, bool is_default_dat, std::vector<fs::path>& files_read)
+    -> std::vector<ModelTable::value_type>
 {
     std::string file_data;
-    std::map<std::string, uint32_t, iless> output;
+    std::vector<ModelTable::value_type> output;
 
     try
     {
         file_data = read_file_utf8(filepath).value();
+        files_read.emplace_back(filepath);
     }
     catch(const bad_optional_access&)
     {
         throw ConfigError("Failed to read DAT file '{}'.", filepath.generic_u8string());
     }
 
-    char buffer[512];
+    string_view line;
 
     fs::path gamedir = filepath;
     gamedir.remove_filename(); // remove gta.dat
     gamedir.remove_filename(); // remove data/
 
-    for(const char* it = file_data.c_str();
-        nextline(it, buffer, std::size(buffer)); )
+    const char* it = file_data.data();
+    const char* end = file_data.data() + file_data.size();
+
+    while(nextline(it, end, line))
     {
-        if(!strncmp(buffer, "IDE", 3))
+        if(starts_with(line, "IDE"))
         {
-            load_ide(gamedir / (buffer+4), is_default_dat, output);
+            line.remove_prefix(3);
+            auto ide_path = gamedir / resttoken(line).to_string();
+            load_ide(ide_path, is_default_dat, output);
+            files_read.emplace_back(std::move(ide_path));
         }
     }
 
     return output;
 }
 
-bool ProgramContext::is_model_from_ide(const string_view& name) const
+auto load_dat(const fs::path& filepath, bool is_default_dat) -> ModelTable
 {
-    if(!this->default_models.empty() || !this->level_models.empty())
+    std::vector<fs::path> files_read;
+    return ModelTable(read_dat(filepath, is_default_dat, files_read));
+}
+
+/// Size and modification time of a file, used to validate the models cache.
+struct DataFileStamp
+{
+    uintmax_t size;
+    int64_t   mtime;
+
+    static optional<DataFileStamp> from_file(const fs::path& path)
     {
-        auto it = this->default_models.find(name);
-        if(it != default_models.end())
-            return true;
+        std::error_code ec;
 
-        it = this->level_models.find(name);
-        if(it != level_models.end())
-            return true;
+        auto size = fs::file_size(path, ec);
+        if(ec) return nullopt;
 
-        return false;
+        auto mtime = fs::last_write_time(path, ec);
+        if(ec) return nullopt;
+
+        return DataFileStamp { size, static_cast<int64_t>(mtime.time_since_epoch().count()) };
+    }
+
+    bool operator==(const DataFileStamp& rhs) const
+    {
+        return this->size == rhs.size && this->mtime == rhs.mtime;
+    }
+};
+
+/// The models cache is a text file in the following format:
+///
+///     GTA3SC-MODELS 1
+///     F <size> <mtime> <path>     (for each DAT/IDE file the models came from)
+///     D <id> <name>               (for each default model)
+///     L <id> <name>               (for each level model)
+///
+static const char* models_cache_magic = "GTA3SC-MODELS 1";
+
+static auto read_models_cache(const fs::path& cache_path, const std::vector<fs::path>& expected_files)
+    -> optional<std::pair<ModelTable, ModelTable>>
+{
+    auto opt_data = read_file_utf8(cache_path);
+    if(!opt_data)
+        return nullopt;
+
+    std::vector<ModelTable::value_type> default_models;
+    std::vector<ModelTable::value_type> level_models;
+    size_t num_expected_found = 0;
+
+    string_view line;
+    const char* it = opt_data->data();
+    const char* end = opt_data->data() + opt_data->size();
+
+    if(!nextline(it, end, line) || line != models_cache_magic)
+        return nullopt;
+
+    while(nextline(it, end, line))
+    {
+        auto kind = nexttoken(line);
+        auto num1 = token_to_int(nexttoken(line));
+
+        if(kind == "F")
+        {
+            auto mtime = token_to_int(nexttoken(line));
+            auto path  = fs::path(resttoken(line).to_string());
+            auto stamp = DataFileStamp::from_file(path);
+
+            if(!num1 || !mtime || !stamp || !(*stamp == DataFileStamp { uintmax_t(*num1), *mtime }))
+                return nullopt;
+
+            if(std::find(expected_files.begin(), expected_files.end(), path) != expected_files.end())
+                ++num_expected_found;
+        }
+        else if(kind == "D" || kind == "L")
+        {
+            auto name = nexttoken(line);
+            if(!num1 || name.empty())
+                return nullopt;
+
+            auto& output = (kind == "D"? default_models : level_models);
+            output.emplace_back(name.to_string(), static_cast<uint32_t>(*num1));
+        }
+        else
+        {
+            return nullopt;
+        }
+    }
+
+    if(num_expected_found != expected_files.size())
+        return nullopt;
+
+    return std::make_pair(ModelTable(std::move(default_models)), ModelTable(std::move(level_models)));
+}
+
+static void write_models_cache(const fs::path& cache_path, const std::vector<fs::path>& files_read,
+                               const ModelTable& default_models, const ModelTable& level_models)
+{
+    fmt::MemoryWriter w;
+    w << models_cache_magic << '\n';
+
+    for(auto& path : files_read)
+    {
+        if(auto stamp = DataFileStamp::from_file(path))
+            w << "F " << stamp->size << ' ' << stamp->mtime << ' ' << path.u8string() << '\n';
+        else
+            return; // can't validate this cache later on, so don't write it.
+    }
+
+    for(auto& model : default_models)
+        w << "D " << model.second << ' ' << model.first << '\n';
+
+    for(auto& model : level_models)
+        w << "L " << model.second << ' ' << model.first << '\n';
+
+    // Failing to write the cache is not an error, the models are going to be parsed once again next time.
+    write_file(cache_path, w.data(), w.size());
+}
+
+auto load_models(const fs::path& datadir, const std::string& levelfile,
+                 const fs::path& cache_path) -> std::pair<ModelTable, ModelTable>
+{
+    auto default_dat = datadir / "default.dat";
+    auto level_dat   = datadir / levelfile;
+
+    if(!cache_path.empty())
+    {
+        if(auto opt_cached = read_models_cache(cache_path, { default_dat, level_dat }))
+            return std::move(*opt_cached);
+    }
+
+    std::vector<fs::path> files_read;
+    auto default_models = ModelTable(read_dat(default_dat, true, files_read));
+    auto level_models   = ModelTable(read_dat(level_dat, false, files_read));
+
+    if(!cache_path.empty())
+        write_models_cache(cache_path, files_read, default_models, level_models);
+
+    return { std::move(default_models), std::move(level_models) };
+}
+
+bool ProgramContext::is_model_from_ide(const string_view& name) const
+{
+    if(!this->default_models->empty() || !this->level_models->empty())
+    {
+        return this->default_models->find(name) || this->level_models->find(name);
     }
     else
     {
@@ -191,6 +374,28 @@ bool ProgramContext::is_model_from_ide(const string_view& name) const
 }
 
 
+bool Options::set_optimize_level(const string_view& level)
+{
+    if(level != "" && level != "0" && level != "1" && level != "2" && level != "s")
+        return false;
+
+    const bool o1 = (level != "0");
+
+    this->optimize_andor = o1;
+    this->optimize_zero_floats = o1;
+    this->rotate_loops = (level == "2");
+    this->switch_tree = (level == "2");
+    this->short_circuit = (level == "2");
+    this->inline_gosub = (level == "2");
+    this->remove_unreachable_code = o1;
+    this->fold_identical_code = (level == "s");
+    this->thread_jumps = o1;
+    this->remove_redundant_goto = o1;
+    this->share_local_vars = o1;
+
+    return true;
+}
+
 bool Options::push_expect_var(const string_view& info)
 {
     std::vector<std::string> names;
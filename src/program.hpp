@@ -8,6 +8,9 @@
 #include "parser.hpp"
 #include "symtable.hpp"
 #include "commands.hpp"
+#include "time_trace.hpp"
+#include "mem_report.hpp"
+#include "opt_stats.hpp"
 
 class Options;
 
@@ -40,11 +43,48 @@ inline std::string format_error(const Options&, const char* type, const weak_ptr
 template<typename T, typename... Args>
 inline std::string format_error(const Options&, const char* type, const shared_ptr<T>& context_, const char* msg, Args&&... args);
 
+/// Flat table of model names to model ids, sorted case insensitively by name.
+class ModelTable
+{
+public:
+    using value_type = std::pair<std::string, uint32_t>;
+
+public:
+    explicit ModelTable() = default;
+
+    /// Builds the table from an unsorted list of models.
+    /// If a model name appears more than once, the first occurrence is kept.
+    explicit ModelTable(std::vector<value_type> models);
+
+    /// Finds the id of the model `name`.
+    optional<uint32_t> find(const string_view& name) const;
+
+    bool empty() const  { return models.empty(); }
+    size_t size() const { return models.size(); }
+
+    auto begin() const  { return models.begin(); }
+    auto end() const    { return models.end(); }
+
+private:
+    std::vector<value_type> models;
+};
+
+/// Appends the models in the IDE file at `filepath` into `output`.
 /// \throws ConfigError on failure.
-extern void load_ide(const fs::path& filepath, bool is_default_ide, insensitive_map<std::string, uint32_t>& output);
+extern void load_ide(const fs::path& filepath, bool is_default_ide, std::vector<ModelTable::value_type>& output);
 
 /// \throws ConfigError on failure.
-extern auto load_dat(const fs::path& filepath, bool is_default_dat) -> insensitive_map<std::string, uint32_t>;
+extern auto load_dat(const fs::path& filepath, bool is_default_dat) -> ModelTable;
+
+/// Loads the models of the `default.dat` and `levelfile` files in `datadir`.
+///
+/// If `cache_path` is not empty, the models are read from such cache file when none of the DAT and IDE files
+/// it was built from changed (by size and modification time). Otherwise the files are parsed and the cache rebuilt.
+///
+/// \returns the default models and the level models, respectively.
+/// \throws ConfigError on failure.
+extern auto load_models(const fs::path& datadir, const std::string& levelfile,
+                        const fs::path& cache_path) -> std::pair<ModelTable, ModelTable>;
 
 /////////////////////////
 
@@ -56,6 +96,7 @@ public:
     {
         IR2,
         GTA3Script,
+        BIR,
     };
 
     enum class HeaderVersion : uint8_t
@@ -75,6 +116,7 @@ public:
     /// General
     bool help = false;
     bool version = false;
+    bool batch = false;
 
     /// Boolean flags
     bool headerless = false;
@@ -98,6 +140,11 @@ public:
     bool skip_cutscene = false;
     bool fsyntax_only = false;
     bool emit_ir2 = false;
+    bool emit_bir = false;
+    bool time_report = false;
+    bool mem_report = false;
+    bool opt_stats = false;
+    bool emit_xrefs = false;
     bool linear_sweep = true;
     bool relax_not = false;
     bool output_cleo = false;
@@ -106,10 +153,25 @@ public:
     bool allow_underscore_identifiers = false;
     bool constant_checks = true;
 
+    // Optimization flags (see -O)
+    bool rotate_loops = false;
+    bool switch_tree = false;
+    bool short_circuit = false;
+    bool inline_gosub = false;
+    uint32_t inline_gosub_max_size = 32; //< Bytes, see -finline-gosub.
+    bool remove_unreachable_code = false;
+    bool fold_identical_code = false;
+    bool thread_jumps = false;
+    bool remove_redundant_goto = false;
+    bool share_local_vars = false;
+    bool compact_global_vars = false;
+
     // Warning flags
     bool warning_is_error = false;
     bool warn_conflict_text_label_var = false;
     bool warn_expect_var = true;
+    bool warn_unreachable_code = true;
+    bool warn_unused_global_var = false;
 
     // 8 bit stuff
     HeaderVersion header = HeaderVersion::None;
@@ -118,12 +180,24 @@ public:
 
     // 32 bit stuff
     int32_t            timer_index = 0;
+    uint32_t           num_jobs = 0;          //< Number of batch workers (0 means one per hardware thread).
     uint32_t           local_var_limit = 0;
     uint32_t           mission_var_begin = 0;
     optional<uint32_t> mission_var_limit;
     optional<uint32_t> switch_case_limit;
     optional<uint32_t> array_elem_limit;
 
+    // Decompiler segment selection
+    optional<uint32_t>                      only_mission;   //< Decompiles only this mission.
+    optional<std::string>                   only_stream;    //< Decompiles only the streamed script of this name.
+    optional<std::pair<uint32_t, uint32_t>> only_range;     //< Decompiles only this range of local offsets.
+
+    optional<fs::path> time_trace;  //< File to write the Chrome trace events into.
+
+    /// Sets the optimization flags to the preset of the -O`level` option (where `level` is empty, 0, 1, 2 or s).
+    /// \returns false if the level is invalid.
+    bool set_optimize_level(const string_view& level);
+
     /// Parses and pushes a --expect-var entry.
     bool push_expect_var(const string_view& info);
 
@@ -170,14 +244,42 @@ public:
 
 class ProgramContext
 {
+private:
+    shared_ptr<const Commands> shared_commands;
+
 public:
     const Options opt;          ///< Compiler options / flags.
-    const Commands commands;    ///< Commands, Entities and Enums
+    const Commands& commands;   ///< Commands, Entities and Enums
+    const shared_ptr<TimeTrace> time_trace; ///< Phase timer, or nullptr if no timing was asked for.
+    const shared_ptr<MemoryReport> mem_report; ///< Memory accounting, or nullptr if no report was asked for.
+    const shared_ptr<OptimizationStats> opt_stats; ///< Optimization counters, or nullptr if no statistics were asked for.
 
 public:
     /// If `logstream` is `nullptr`, does not perform logging.
     explicit ProgramContext(Options opt, Commands commands, FILE* logstream = stderr) :
-        opt(std::move(opt)), commands(std::move(commands)), logstream(logstream)
+        shared_commands(std::make_shared<const Commands>(std::move(commands))),
+        opt(std::move(opt)), commands(*shared_commands),
+        time_trace(this->opt.time_report || this->opt.time_trace || this->opt.mem_report?
+                    std::make_shared<TimeTrace>(this->opt.mem_report) : nullptr),
+        mem_report(this->opt.mem_report? std::make_shared<MemoryReport>() : nullptr),
+        opt_stats(this->opt.opt_stats? std::make_shared<OptimizationStats>() : nullptr)
+    {
+        if(logstream)
+        {
+            this->logsink = [logstream](const std::string& msg) {
+                std::fprintf(logstream, "%s\n", msg.c_str());
+            };
+        }
+    }
+
+    /// Constructs a context sharing the commands, models, time trace, memory report and optimization statistics of `parent`,
+    /// but with its own options and error counters.
+    ///
+    /// Every message is sent to `logsink` (without a trailing new line). If it's empty, does not perform logging.
+    /// This is useful to run many independent jobs at the same time.
+    explicit ProgramContext(const ProgramContext& parent, Options opt, std::function<void(const std::string&)> logsink) :
+        shared_commands(parent.shared_commands), opt(std::move(opt)), commands(*shared_commands),
+        time_trace(parent.time_trace), mem_report(parent.mem_report), opt_stats(parent.opt_stats), logsink(std::move(logsink)), default_models(parent.default_models), level_models(parent.level_models)
     {
     }
 
@@ -188,11 +290,10 @@ public:
     bool is_model_from_ide(const string_view& name) const;
 
     /// Assigns IDE file information read with `load_ide` or `load_dat`.
-    void setup_models(insensitive_map<std::string, uint32_t> default_models,
-                      insensitive_map<std::string, uint32_t> level_models)
+    void setup_models(ModelTable default_models, ModelTable level_models)
     {
-        this->default_models = std::move(default_models);
-        this->level_models   = std::move(level_models);
+        this->default_models = std::make_shared<const ModelTable>(std::move(default_models));
+        this->level_models   = std::make_shared<const ModelTable>(std::move(level_models));
     }
 
     /// Sets the maximum errors the program can give.
@@ -209,6 +310,25 @@ public:
         error_count += n;
     }
 
+    /// Logs the `messages` which `child` (a context constructed from this one) sent to its log sink, and
+    /// accounts its errors and warnings into this context.
+    ///
+    /// This is useful to keep the order of messages deterministic when running jobs concurrently.
+    void merge_diagnostics(const ProgramContext& child, const std::vector<std::string>& messages)
+    {
+        if(logsink)
+        {
+            for(auto& msg : messages)
+                this->puts(msg);
+        }
+
+        this->warn_count  += child.warn_count;
+        this->fatal_count += child.fatal_count;
+
+        if((this->error_count += child.error_count) >= max_error && child.error_count)
+            this->fatal_error(nocontext, "too many errors");
+    }
+
     /// Whether the program has any errors.
     bool has_error() const
     {
@@ -218,7 +338,7 @@ public:
     template<typename Context, typename... Args>
     void error(const Context& context, const char* msg, Args&&... args)
     {
-        if(logstream) this->puts(format_error(this->opt, "error", context, msg, std::forward<Args>(args)...));
+        if(logsink) this->puts(format_error(this->opt, "error", context, msg, std::forward<Args>(args)...));
 
         if(++error_count >= max_error)
             this->fatal_error(nocontext, "too many errors");
@@ -227,7 +347,7 @@ public:
     template<typename Context, typename... Args>
     void note(const Context& context, const char* msg, Args&&... args)
     {
-        if(logstream) this->puts(format_error(this->opt, "note", context, msg, std::forward<Args>(args)...));
+        if(logsink) this->puts(format_error(this->opt, "note", context, msg, std::forward<Args>(args)...));
     }
 
     template<typename Context, typename... Args>
@@ -240,7 +360,7 @@ public:
         else
         {
             ++warn_count;
-            if(logstream) this->puts(format_error(this->opt, "warning", context, msg, std::forward<Args>(args)...));
+            if(logsink) this->puts(format_error(this->opt, "warning", context, msg, std::forward<Args>(args)...));
         }
     }
 
@@ -248,7 +368,7 @@ public:
     void fatal_error [[noreturn]] (const Context& context, const char* msg, Args&&... args)
     {
         ++fatal_count;
-        if(logstream) this->puts(format_error(this->opt, "fatal error", context, msg, std::forward<Args>(args)...));
+        if(logsink) this->puts(format_error(this->opt, "fatal error", context, msg, std::forward<Args>(args)...));
         throw ProgramFailure();
     }
 
@@ -285,7 +405,7 @@ public:
 private:
     void puts(const std::string& msg)
     {
-        std::fprintf(logstream, "%s\n", msg.c_str());
+        this->logsink(msg);
     }
 
 private:
@@ -293,15 +413,15 @@ private:
     std::atomic<uint32_t> fatal_count {0};
     std::atomic<uint32_t> warn_count  {0};
 
-    FILE*     logstream {nullptr};
-    uint32_t  max_error {UINT_MAX};
+    std::function<void(const std::string&)> logsink;
+    uint32_t max_error {UINT_MAX};
 
 
 protected:
     friend class Commands;
     friend int main(int argc, char** argv);
-    insensitive_map<std::string, uint32_t> default_models;
-    insensitive_map<std::string, uint32_t> level_models;
+    shared_ptr<const ModelTable> default_models = std::make_shared<const ModelTable>(); //< Shared with child contexts.
+    shared_ptr<const ModelTable> level_models   = std::make_shared<const ModelTable>(); //< Shared with child contexts.
 };
 
 ////////////////////////////////////////////////////////////
@@ -311,10 +431,23 @@ protected:
 extern int compile(fs::path input, fs::path output, ProgramContext&);
 extern int decompile(fs::path input, fs::path output, ProgramContext&);
 
+/// Same as `compile` but doesn't report the failure of the compilation as a whole.
+/// \returns whether the compilation succeeded.
+extern bool compile_file(fs::path input, fs::path output, ProgramContext&);
+
+/// \returns the output `compile_file` writes into when no output is given.
+extern fs::path default_compile_output(const fs::path& input, const Options& options);
+
+/// Same as `decompile` but doesn't report the failure of the decompilation as a whole.
+/// \returns whether the decompilation succeeded.
+extern bool decompile_file(fs::path input, fs::path output, ProgramContext&);
+
+/// Decompiles the bytecode, writing the output into `output`.
+/// If `xrefs_output` is set, the cross reference listing is written into it.
 extern bool decompile(const void* bytecode, size_t bytecode_size,
                       const void* script_img, size_t script_img_size,
                       ProgramContext& program, Options::Lang lang,
-                      std::function<void(const std::string&)> callback);
+                      text_sink& output, text_sink* xrefs_output = nullptr);
 
 ////////////////////////////////////////////////////////////
 
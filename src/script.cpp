@@ -941,3 +941,46 @@ void Script::fix_call_scope_variables(ProgramContext& program)
 }
 
 // Script::annotate_tree is within symtable.cpp
+
+void Script::report_memory(MemoryReport& report) const
+{
+    auto owner = this->path.filename().u8string();
+
+    if(this->tstream)
+    {
+        auto& text = this->tstream->text;
+        report.add(owner, "source text", 1, MemoryReport::bytes_of(text.data) + MemoryReport::bytes_of(text.line_offset));
+        report.add(owner, "tokens", this->tstream->tokens.size(), MemoryReport::bytes_of(this->tstream->tokens));
+    }
+
+    if(this->tree)
+    {
+        size_t num_nodes = 0, tree_bytes = 0;
+        std::vector<const SyntaxTree*> to_visit = { this->tree.get() };
+        while(!to_visit.empty())
+        {
+            auto node = to_visit.back();
+            to_visit.pop_back();
+
+            ++num_nodes;
+            tree_bytes += sizeof(SyntaxTree) + node->child_count() * sizeof(shared_ptr<SyntaxTree>);
+
+            for(auto& child : *node)
+                to_visit.emplace_back(child.get());
+        }
+        report.add(owner, "syntax tree nodes", num_nodes, tree_bytes);
+    }
+
+    size_t num_vars = 0, vars_bytes = 0;
+    for(auto& scope : this->scopes)
+    {
+        num_vars += scope->vars.size();
+        for(auto& pair : scope->vars)
+        {
+            vars_bytes += MemoryReport::node_bytes<decltype(pair)>() + MemoryReport::bytes_of(pair.first) + sizeof(Var);
+        }
+    }
+
+    report.add(owner, "scopes", this->scopes.size(), this->scopes.size() * sizeof(Scope));
+    report.add(owner, "local variables", num_vars, vars_bytes);
+}
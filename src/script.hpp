@@ -95,6 +95,9 @@ public:
     /// \note if the last local index used was e.g. 0+, then this returns 1+. If no local was used, returns 0.
     std::pair<uint32_t, uint32_t> find_maximum_locals() const;
 
+    /// Accounts the memory taken by the source text, tokens, syntax tree and scopes of this script into `report`.
+    void report_memory(MemoryReport& report) const;
+
     /// \returns the size of the headers in this script.
     uint32_t header_size() const
     {
@@ -212,7 +215,7 @@ struct Var
     static uint32_t space_taken(VarType type, size_t count = 1);
 
     /// \returns the byte offset (index*4) on which this variable is in memory.
-    uint32_t offset() {
+    uint32_t offset() const {
         return index * 4;
     }
 
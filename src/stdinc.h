@@ -29,9 +29,11 @@
 #include "cpp/scope_guard.hpp"
 #include "cpp/string_view.hpp"
 #include "cpp/small_vector.hpp"
+#include "cpp/dynamic_bitset.hpp"
 #include "cpp/icompare.hpp"
 #include "cpp/contracts.hpp"
 #include "cpp/file.hpp"
+#include "cpp/text_sink.hpp"
 
 #pragma warning(push)
 #pragma warning(disable : 4814) // warning: in C++14 'constexpr' will not imply 'const'; consider explicitly specifying 'const'
@@ -40,7 +42,6 @@
 
 using std::shared_ptr;
 using std::weak_ptr;
-using dynamic_bitset = std::vector<bool>;
 
 template<typename Value>
 using transparent_set = std::set<Value, std::less<>>;
@@ -70,6 +71,8 @@ class SymTable;
 struct CompiledScmHeader;
 class MultiFileHeaderList;
 struct Label;
+class ModelTable;
+class MemoryReport;
 
 #ifndef _MSC_VER
 #   define __debugbreak()
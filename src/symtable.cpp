@@ -1098,7 +1098,7 @@ void Script::annotate_tree(const SymTable& symbols, ProgramContext& program)
                                 exp_case.error().emit(program);
                             }
 
-                            if(!commands.switch_start)
+                            if(!commands.has_switch_op())
                             {
                                 auto& alt_is_thing_equal_to_thing = program.supported_or_fatal(node, commands.is_thing_equal_to_thing,
                                                                                                 "IS_THING_EQUAL_TO_THING");
@@ -1172,7 +1172,20 @@ void Script::annotate_tree(const SymTable& symbols, ProgramContext& program)
                         program.error(node, "SWITCH contains more than {} cases [-fswitch-case-limit]", *switch_case_limit);
                 }
 
-                node.set_annotation(SwitchAnnotation { case_values.size(), had_default });
+                // Lowering into a decision tree needs a greater than comparison, in addition to the equality ones.
+                const Command* is_var_gt_int = nullptr;
+                if(program.opt.switch_tree && !commands.has_switch_op() && commands.is_thing_greater_than_thing)
+                {
+                    auto exp_is_var_gt_int = commands.match(*commands.is_thing_greater_than_thing, node, { &var, Commands::MatchArgument(0) },
+                                                            symbols, current_scope, program.opt);
+                    if(exp_is_var_gt_int)
+                    {
+                        commands.annotate({ &var, nullopt }, **exp_is_var_gt_int, symbols, current_scope, *this, program);
+                        is_var_gt_int = *exp_is_var_gt_int;
+                    }
+                }
+
+                node.set_annotation(SwitchAnnotation { case_values.size(), had_default, is_var_gt_int });
                 return false;
             }
 
@@ -1378,3 +1391,17 @@ void Script::annotate_tree(const SymTable& symbols, ProgramContext& program)
         program.error(*this, "missing SKIP_CUTSCENE_END");
     }
 }
+
+void SymTable::report_memory(MemoryReport& report) const
+{
+    auto map_bytes = [](const auto& map, size_t value_bytes) {
+        size_t bytes = 0;
+        for(auto& pair : map)
+            bytes += MemoryReport::node_bytes<decltype(pair)>() + MemoryReport::bytes_of(pair.first) + value_bytes;
+        return bytes;
+    };
+
+    report.add("(global)", "global variables", this->global_vars.size(), map_bytes(this->global_vars, sizeof(Var)));
+    report.add("(global)", "labels", this->labels.size(), map_bytes(this->labels, sizeof(Label)));
+    report.add("(global)", "constants", this->constants.size(), map_bytes(this->constants, 0));
+}
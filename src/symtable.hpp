@@ -103,6 +103,9 @@ public:
     /// Checks whether variables collides with string constants.
     void check_constant_collisions(ProgramContext& program) const;
 
+    /// Accounts the memory taken by the global symbols of this table into `report`.
+    void report_memory(MemoryReport& report) const;
+
 protected:
     friend class Script;
 
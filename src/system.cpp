@@ -4,10 +4,14 @@
 
 #if defined(_WIN32)
 #include <windows.h>
+#include <psapi.h>
 #include <io.h>
 #elif defined(__unix__)
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
 #endif
 
 static fs::path find_config_path()
@@ -102,3 +106,105 @@ bool allocate_file(FILE* f, uint64_t size)
 #   error allocate_file not implemented for this platform.
 #endif
 }
+
+MemoryUsage memory_usage()
+{
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if(!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return MemoryUsage { 0, 0 };
+    return MemoryUsage { counters.WorkingSetSize, counters.PeakWorkingSetSize };
+
+#elif defined(__unix__)
+    MemoryUsage usage { 0, 0 };
+
+    struct rusage ru;
+    if(getrusage(RUSAGE_SELF, &ru) == 0)
+        usage.peak_rss = size_t(ru.ru_maxrss) * 1024; // in kilobytes
+
+    // The second field of statm is the resident set size, in pages.
+    if(FILE* f = fopen("/proc/self/statm", "r"))
+    {
+        unsigned long size, resident;
+        if(fscanf(f, "%lu %lu", &size, &resident) == 2)
+            usage.current_rss = size_t(resident) * size_t(sysconf(_SC_PAGESIZE));
+        fclose(f);
+    }
+
+    return usage;
+#else
+#   error memory_usage not implemented for this platform.
+#endif
+}
+
+optional<MappedFile> MappedFile::open(const fs::path& path)
+{
+#if defined(_WIN32)
+    HANDLE hFile = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(hFile == INVALID_HANDLE_VALUE)
+        return nullopt;
+
+    auto guard = make_scope_guard([&] {
+        CloseHandle(hFile);
+    });
+
+    LARGE_INTEGER ll;
+    if(!GetFileSizeEx(hFile, &ll))
+        return nullopt;
+
+    if(ll.QuadPart == 0)
+        return MappedFile(nullptr, 0);
+
+    // The view keeps a reference to the mapping object, so it can be closed right away.
+    HANDLE hMapping = CreateFileMappingW(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    if(hMapping == NULL)
+        return nullopt;
+
+    void* view = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(hMapping);
+
+    if(view == NULL)
+        return nullopt;
+
+    return MappedFile(reinterpret_cast<const uint8_t*>(view), static_cast<size_t>(ll.QuadPart));
+
+#elif defined(__unix__)
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd == -1)
+        return nullopt;
+
+    auto guard = make_scope_guard([&] {
+        close(fd);
+    });
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+        return nullopt;
+
+    if(st.st_size == 0)
+        return MappedFile(nullptr, 0);
+
+    // The mapping stays valid after the descriptor is closed.
+    void* addr = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    if(addr == MAP_FAILED)
+        return nullopt;
+
+    return MappedFile(reinterpret_cast<const uint8_t*>(addr), static_cast<size_t>(st.st_size));
+#else
+#   error MappedFile::open not implemented for this platform.
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+    if(this->bytes == nullptr)
+        return;
+
+#if defined(_WIN32)
+    UnmapViewOfFile(this->bytes);
+#elif defined(__unix__)
+    munmap(const_cast<uint8_t*>(this->bytes), this->length);
+#else
+#   error MappedFile::~MappedFile not implemented for this platform.
+#endif
+}
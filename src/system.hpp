@@ -3,6 +3,7 @@
 ///
 #pragma once
 #include "cpp/filesystem.hpp"
+#include "cpp/optional.hpp"
 
 /// Returns the path that static configuration is in.
 extern const fs::path& config_path();
@@ -11,3 +12,55 @@ extern const fs::path& config_path();
 /// \warning the behaviour is undefined if the file isn't empty.
 /// \note the file offset after this call is at the top of the file.
 extern bool allocate_file(FILE*, uint64_t);
+
+/// Memory used by this process, in bytes.
+struct MemoryUsage
+{
+    size_t current_rss;     //< Resident set size.
+    size_t peak_rss;        //< Highest resident set size since the process started.
+};
+
+/// \returns the memory used by this process, or zeros if it could not be queried.
+extern MemoryUsage memory_usage();
+
+/// Read-only mapping of a whole file into memory.
+///
+/// The pages of the file are only loaded when they're first accessed.
+class MappedFile
+{
+public:
+    /// Maps the file at `path` into memory.
+    /// \returns nullopt if the file could not be mapped.
+    static optional<MappedFile> open(const fs::path& path);
+
+    MappedFile(MappedFile&& rhs) noexcept :
+        bytes(rhs.bytes), length(rhs.length)
+    {
+        rhs.bytes = nullptr;
+        rhs.length = 0;
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    MappedFile& operator=(MappedFile&& rhs) noexcept
+    {
+        std::swap(this->bytes, rhs.bytes);
+        std::swap(this->length, rhs.length);
+        return *this;
+    }
+
+    ~MappedFile();
+
+    const uint8_t* data() const { return this->bytes; }
+    size_t size() const         { return this->length; }
+
+private:
+    explicit MappedFile(const uint8_t* bytes, size_t length) :
+        bytes(bytes), length(length)
+    {}
+
+private:
+    const uint8_t* bytes;   //< May be null for empty files.
+    size_t         length;
+};
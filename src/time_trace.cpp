@@ -0,0 +1,272 @@
+#include <stdinc.h>
+#include "time_trace.hpp"
+#include "system.hpp"
+
+static thread_local const TimeTrace::Scope* innermost_scope = nullptr;
+
+TimeTrace::Scope::Scope(TimeTrace* trace, const char* name, string_view detail, const Scope* parent) :
+    trace(trace), event(0), previous(innermost_scope)
+{
+    if(this->trace)
+    {
+        this->event = trace->begin_event(name, detail, (parent && parent->trace == trace)? parent : nullptr);
+        innermost_scope = this;
+    }
+}
+
+TimeTrace::Scope::~Scope()
+{
+    if(this->trace)
+    {
+        this->trace->end_event(this->event);
+        innermost_scope = this->previous;
+    }
+}
+
+const TimeTrace::Scope* TimeTrace::Scope::current()
+{
+    return innermost_scope;
+}
+
+TimeTrace::TimeTrace(bool track_memory) :
+    track_memory(track_memory), start(std::chrono::steady_clock::now())
+{
+}
+
+uint64_t TimeTrace::now() const
+{
+    auto elapsed = std::chrono::steady_clock::now() - this->start;
+    return std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+}
+
+size_t TimeTrace::begin_event(const char* name, string_view detail, const Scope* parent)
+{
+    auto begin = this->now();
+    auto peak_rss = this->track_memory? memory_usage().peak_rss : 0;
+    auto thread_id = std::this_thread::get_id();
+
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    auto it = std::find(this->threads.begin(), this->threads.end(), thread_id);
+    if(it == this->threads.end())
+        it = this->threads.insert(it, thread_id);
+
+    this->events.push_back(Event {
+        name, detail.to_string(), parent? parent->event : no_parent,
+        uint32_t(it - this->threads.begin()), begin, begin, peak_rss, peak_rss
+    });
+
+    return this->events.size() - 1;
+}
+
+void TimeTrace::end_event(size_t event)
+{
+    auto end = this->now();
+    auto peak_rss = this->track_memory? memory_usage().peak_rss : 0;
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->events[event].end = end;
+    this->events[event].peak_rss_end = peak_rss;
+}
+
+auto TimeTrace::make_nodes() const -> std::vector<Node>
+{
+    std::vector<Node> nodes;
+    std::vector<size_t> roots;
+    std::vector<size_t> node_of_event(this->events.size());
+
+    // Parents are always before their children in the events vector.
+    for(size_t i = 0; i < this->events.size(); ++i)
+    {
+        auto& event = this->events[i];
+        auto parent_node = (event.parent != no_parent? node_of_event[event.parent] : no_parent);
+        auto get_siblings = [&]() -> std::vector<size_t>& {
+            return parent_node != no_parent? nodes[parent_node].children : roots;
+        };
+
+        auto it = std::find_if(get_siblings().begin(), get_siblings().end(), [&](size_t n) {
+            return !strcmp(nodes[n].name, event.name);
+        });
+
+        size_t node_id;
+        if(it != get_siblings().end())
+        {
+            node_id = *it;
+        }
+        else
+        {
+            node_id = nodes.size();
+            nodes.emplace_back(Node { event.name, parent_node != no_parent? nodes[parent_node].depth + 1 : 0 });
+            get_siblings().emplace_back(node_id); // only after emplacing, which may invalidate the siblings
+        }
+
+        auto& node = nodes[node_id];
+        node_of_event[i] = node_id;
+        node.count += 1;
+        node.time += event.end - event.begin;
+        node.peak_rss = std::max(node.peak_rss, event.peak_rss_end);
+        node.rss_growth += event.peak_rss_end - event.peak_rss_begin;
+    }
+
+    // Sorts the nodes in depth-first order.
+    std::vector<Node> sorted_nodes;
+    sorted_nodes.reserve(nodes.size());
+
+    std::vector<size_t> to_visit(roots.rbegin(), roots.rend());
+    while(!to_visit.empty())
+    {
+        auto& node = nodes[to_visit.back()];
+        to_visit.pop_back();
+        to_visit.insert(to_visit.end(), node.children.rbegin(), node.children.rend());
+        sorted_nodes.emplace_back(std::move(node));
+    }
+
+    return sorted_nodes;
+}
+
+void TimeTrace::print_report(FILE* stream) const
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    auto total = this->now();
+    auto percent = [&](uint64_t time) { return total? 100.0 * double(time) / double(total) : 0.0; };
+    auto seconds = [](uint64_t time) { return double(time) / 1000000.0; };
+
+    fprintf(stream, "===-------------------------------------------------------------------------===\n");
+    fprintf(stream, "                             Phase time report\n");
+    fprintf(stream, "===-------------------------------------------------------------------------===\n");
+    fprintf(stream, "  Total execution time: %.4f seconds\n", seconds(total));
+    if(this->threads.size() > 1)
+        fprintf(stream, "  Times are summed across the %u threads which ran concurrently.\n", unsigned(this->threads.size()));
+    fprintf(stream, "\n");
+    fprintf(stream, "   ---Wall Time---  ---Count---  ---Name---\n");
+
+    for(auto& node : this->make_nodes())
+    {
+        fprintf(stream, "   %8.4f (%5.1f%%)  %11u  %*s%s\n", seconds(node.time), percent(node.time),
+                        unsigned(node.count), int(node.depth * 2), "", node.name);
+    }
+
+    // Events containing the work on other scripts (e.g. the whole compilation) aren't accounted, neither are
+    // the ones nested in an event on the same script, so that no time is counted twice.
+    std::vector<char> has_script_children(this->events.size(), false);
+    for(auto& event : this->events)
+    {
+        if(!event.detail.empty() && event.parent != no_parent)
+            has_script_children[event.parent] = true;
+    }
+
+    std::map<std::string, uint64_t> script_times;
+    for(size_t i = 0; i < this->events.size(); ++i)
+    {
+        auto& event = this->events[i];
+        if(event.detail.empty() || has_script_children[i])
+            continue;
+
+        bool is_nested = false;
+        for(auto p = event.parent; p != no_parent && !is_nested; p = this->events[p].parent)
+            is_nested = (!has_script_children[p] && this->events[p].detail == event.detail);
+
+        if(!is_nested)
+            script_times[event.detail] += event.end - event.begin;
+    }
+
+    if(!script_times.empty())
+    {
+        std::vector<std::pair<std::string, uint64_t>> sorted_times(script_times.begin(), script_times.end());
+        std::stable_sort(sorted_times.begin(), sorted_times.end(), [](const auto& a, const auto& b) {
+            return a.second > b.second;
+        });
+
+        fprintf(stream, "\n   ---Wall Time---  ---Script---\n");
+        for(auto& pair : sorted_times)
+        {
+            fprintf(stream, "   %8.4f (%5.1f%%)  %s\n", seconds(pair.second), percent(pair.second), pair.first.c_str());
+        }
+    }
+
+    fprintf(stream, "\n");
+}
+
+void TimeTrace::print_memory_report(FILE* stream) const
+{
+    Expects(this->track_memory);
+
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    auto mebibytes = [](size_t bytes) { return double(bytes) / (1024.0 * 1024.0); };
+
+    fprintf(stream, "   ---Peak RSS---  ---Growth---  ---Name---\n");
+    for(auto& node : this->make_nodes())
+    {
+        fprintf(stream, "   %10.1f MiB  %8.1f MiB  %*s%s\n", mebibytes(node.peak_rss), mebibytes(node.rss_growth),
+                        int(node.depth * 2), "", node.name);
+    }
+}
+
+std::pair<uint64_t, size_t> TimeTrace::total_time(const char* name) const
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    uint64_t time = 0;
+    size_t count = 0;
+    for(auto& event : this->events)
+    {
+        if(strcmp(event.name, name) != 0)
+            continue;
+
+        bool is_nested = false;
+        for(auto p = event.parent; p != no_parent && !is_nested; p = this->events[p].parent)
+            is_nested = !strcmp(this->events[p].name, name);
+
+        if(!is_nested)
+        {
+            time += event.end - event.begin;
+            ++count;
+        }
+    }
+
+    return std::make_pair(time, count);
+}
+
+bool TimeTrace::write_chrome_trace(const fs::path& path) const
+{
+    FILE* stream = u8fopen(path, "wb");
+    if(!stream)
+        return false;
+
+    auto guard = make_scope_guard([&] {
+        fclose(stream);
+    });
+
+    auto json_string = [](const string_view& s)
+    {
+        std::string result = "\"";
+        for(char c : s)
+        {
+            if(c == '"' || c == '\\')
+                (result += '\\') += c;
+            else if(static_cast<unsigned char>(c) < 0x20)
+                result += fmt::format("\\u{:04x}", unsigned(c));
+            else
+                result += c;
+        }
+        return result += '"';
+    };
+
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    text_sink sink(stream);
+    sink.line("{\"traceEvents\": [");
+
+    for(size_t i = 0; i < this->events.size(); ++i)
+    {
+        auto& event = this->events[i];
+        sink.line(fmt::format("{{\"name\": {}, \"cat\": \"gta3sc\", \"ph\": \"X\", \"pid\": 1, \"tid\": {}, "
+                              "\"ts\": {}, \"dur\": {}, \"args\": {{\"detail\": {}}}}}{}",
+                              json_string(event.name), event.thread, event.begin, event.end - event.begin,
+                              json_string(event.detail), i + 1 != this->events.size()? "," : ""));
+    }
+
+    sink.line("], \"displayTimeUnit\": \"ms\"}");
+    return sink.flush();
+}
@@ -0,0 +1,107 @@
+///
+/// Time Trace
+///
+/// Hierarchical timing of the phases of the compiler and decompiler, for -ftime-report and -ftime-trace.
+///
+#pragma once
+#include <stdinc.h>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+class TimeTrace
+{
+public:
+    /// Times the lifetime of this object as an event named `name`.
+    ///
+    /// If the trace is a null pointer, nothing is timed. The `detail` of an event usually names the script
+    /// it works on, and is used to group the events in the report.
+    class Scope
+    {
+    public:
+        /// The event is nested in `parent`, which by default is the innermost scope of the calling thread.
+        /// Scopes running in worker threads should give their parent explicitly.
+        explicit Scope(TimeTrace* trace, const char* name, string_view detail = string_view(),
+                       const Scope* parent = Scope::current());
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        ~Scope();
+
+        /// \returns the innermost scope alive in the calling thread, or nullptr if none.
+        static const Scope* current();
+
+    private:
+        friend class TimeTrace;
+
+        TimeTrace*   trace;
+        size_t       event;
+        const Scope* previous;  //< Innermost scope of this thread before this one.
+    };
+
+public:
+    /// If `track_memory` is true, the peak resident set size is also recorded at the boundaries of each event.
+    explicit TimeTrace(bool track_memory = false);
+
+    TimeTrace(const TimeTrace&) = delete;
+    TimeTrace& operator=(const TimeTrace&) = delete;
+
+    /// Prints the time taken by each phase, and the time taken by each script, into `stream`.
+    void print_report(FILE* stream) const;
+
+    /// Prints the peak resident set size after each phase, and how much each phase raised it, into `stream`.
+    ///
+    /// The trace must have been constructed with `track_memory`.
+    void print_memory_report(FILE* stream) const;
+
+    /// \returns the time taken by the events named `name` (in microseconds), and how many of them there were.
+    /// Events nested in another of the same name aren't accounted again.
+    std::pair<uint64_t, size_t> total_time(const char* name) const;
+
+    /// Writes the events in the Chrome trace event format, which can be loaded by `chrome://tracing`.
+    /// \returns false if the file could not be written.
+    bool write_chrome_trace(const fs::path& path) const;
+
+private:
+    struct Event
+    {
+        const char* name;
+        std::string detail;
+        size_t      parent;     //< Index of the enclosing event, or `no_parent`.
+        uint32_t    thread;     //< Index of the thread in `threads`.
+        uint64_t    begin;      //< Microseconds since the construction of the trace.
+        uint64_t    end;
+        size_t      peak_rss_begin; //< Peak resident set size at the beginning of the event, if tracking memory.
+        size_t      peak_rss_end;
+    };
+
+    /// Events of the same name under the same parent node are merged into a single node.
+    struct Node
+    {
+        const char*         name;
+        size_t              depth;
+        size_t              count = 0;
+        uint64_t            time = 0;
+        size_t              peak_rss = 0;       //< Highest peak resident set size by the end of the events.
+        size_t              rss_growth = 0;     //< How much the events raised the peak resident set size.
+        std::vector<size_t> children;
+    };
+
+    static constexpr size_t no_parent = SIZE_MAX;
+
+    size_t begin_event(const char* name, string_view detail, const Scope* parent);
+    void end_event(size_t event);
+    uint64_t now() const;
+
+    /// Merges the events into a tree of nodes, in the order they're printed.
+    /// The mutex must be held by the caller.
+    std::vector<Node> make_nodes() const;
+
+private:
+    const bool                            track_memory;
+    std::chrono::steady_clock::time_point start;
+    mutable std::mutex                    mutex;
+    std::vector<Event>                    events;
+    std::vector<std::thread::id>          threads;
+};
@@ -0,0 +1,27 @@
+// RUN: %gta3sc %s --config=gtavc -fcompact-global-vars --expect-var=pinned:4 -emit-ir2 -o - | %FileCheck %s
+
+VAR_INT unused assigned pinned output
+VAR_INT x
+VAR_FLOAT f
+
+// Assignments into variables never read are removed along with the variables.
+// CHECK-NEXT-L: GENERATE_RANDOM_INT_IN_RANGE 0i8 10i8 &8
+assigned = 1
+GENERATE_RANDOM_INT_IN_RANGE 0 10 output
+
+// The other variables are moved down, around the variable given by --expect-var.
+// CHECK-NEXT-L: SET_VAR_INT &16 2i8
+// CHECK-NEXT-L: ADD_VAL_TO_INT_VAR &12 1i8
+// CHECK-NEXT-L: SET_VAR_FLOAT &20 0x1.000000p+0f
+// CHECK-NEXT-L: WAIT &12
+// CHECK-NEXT-L: WAIT &16
+// CHECK-NEXT-L: SET_TIME_SCALE &20
+pinned = 2
+x += 1
+f = 1.0
+WAIT x
+WAIT pinned
+SET_TIME_SCALE f
+
+// CHECK-NEXT-L: TERMINATE_THIS_SCRIPT
+TERMINATE_THIS_SCRIPT
@@ -0,0 +1,67 @@
+// RUN: %gta3sc %s --config=gtavc -ffold-identical-code -emit-ir2 -o - | %FileCheck %s
+
+VAR_INT x y
+
+// CHECK-NEXT-L: ANDOR 0i8
+// CHECK-NEXT-L: IS_INT_VAR_EQUAL_TO_NUMBER &8 1i8
+// CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_3
+// CHECK-NEXT-L: WAIT 10i8
+// CHECK-NEXT-L: MAIN_1:
+// CHECK-NEXT-L: PRINT_HELP 'HELP1'
+// CHECK-NEXT-L: MAIN_2:
+// CHECK-NEXT-L: SET_VAR_INT &12 5i8
+// CHECK-NEXT-L: RETURN
+IF x = 1
+    WAIT 10
+    PRINT_HELP HELP1
+    y = 5
+    RETURN
+ENDIF
+
+// CHECK-NEXT-L: MAIN_3:
+// CHECK-NEXT-L: ANDOR 0i8
+// CHECK-NEXT-L: IS_INT_VAR_EQUAL_TO_NUMBER &8 2i8
+// CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_4
+// CHECK-NEXT-L: WAIT 20i8
+// CHECK-NEXT-L: GOTO @MAIN_1
+IF x = 2
+    WAIT 20
+    PRINT_HELP HELP1
+    y = 5
+    RETURN
+ENDIF
+
+// CHECK-NEXT-L: MAIN_4:
+// CHECK-NEXT-L: ANDOR 0i8
+// CHECK-NEXT-L: IS_INT_VAR_EQUAL_TO_NUMBER &8 3i8
+// CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_5
+// CHECK-NEXT-L: GOTO @MAIN_1
+IF x = 3
+    PRINT_HELP HELP1
+    y = 5
+    RETURN
+ENDIF
+
+// CHECK-NEXT-L: MAIN_5:
+// CHECK-NEXT-L: ANDOR 0i8
+// CHECK-NEXT-L: IS_INT_VAR_EQUAL_TO_NUMBER &8 4i8
+// CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_6
+// CHECK-NEXT-L: GOTO @MAIN_2
+IF x = 4
+    y = 5
+    RETURN
+ENDIF
+
+// Too short to be worth a GOTO.
+// CHECK-NEXT-L: MAIN_6:
+// CHECK-NEXT-L: ANDOR 0i8
+// CHECK-NEXT-L: IS_INT_VAR_EQUAL_TO_NUMBER &8 5i8
+// CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_7
+// CHECK-NEXT-L: RETURN
+IF x = 5
+    RETURN
+ENDIF
+
+// CHECK-NEXT-L: MAIN_7:
+// CHECK-NEXT-L: TERMINATE_THIS_SCRIPT
+TERMINATE_THIS_SCRIPT
@@ -0,0 +1,33 @@
+// RUN: %gta3sc %s --config=gta3 -ffold-identical-code -emit-ir2 -o - | %FileCheck %s
+// Tails are only shared within a mission, never with main or another mission.
+
+// CHECK-NEXT-L: LOAD_AND_LAUNCH_MISSION_INTERNAL 0i8
+// CHECK-NEXT-L: LOAD_AND_LAUNCH_MISSION_INTERNAL 1i8
+// CHECK-NEXT-L: WAIT 10i8
+// CHECK-NEXT-L: WAIT 20i8
+// CHECK-NEXT-L: WAIT 30i8
+// CHECK-NEXT-L: TERMINATE_THIS_SCRIPT
+// CHECK-NEXT-L: #MISSION_BLOCK_START 0
+// CHECK-NEXT-L: ANDOR 0i8
+// CHECK-NEXT-L: IS_INT_VAR_EQUAL_TO_NUMBER &8 0i8
+// CHECK-NEXT-L: GOTO_IF_FALSE %MISSION_0_2
+// CHECK-NEXT-L: MISSION_0_1:
+// CHECK-NEXT-L: WAIT 10i8
+// CHECK-NEXT-L: WAIT 20i8
+// CHECK-NEXT-L: WAIT 30i8
+// CHECK-NEXT-L: TERMINATE_THIS_SCRIPT
+// CHECK-NEXT-L: MISSION_0_2:
+// CHECK-NEXT-L: GOTO %MISSION_0_1
+// CHECK-NEXT-L: #MISSION_BLOCK_END
+// CHECK-NEXT-L: #MISSION_BLOCK_START 1
+// CHECK-NEXT-L: WAIT 10i8
+// CHECK-NEXT-L: WAIT 20i8
+// CHECK-NEXT-L: WAIT 30i8
+// CHECK-NEXT-L: TERMINATE_THIS_SCRIPT
+// CHECK-NEXT-L: #MISSION_BLOCK_END
+LOAD_AND_LAUNCH_MISSION mission1.sc
+LOAD_AND_LAUNCH_MISSION mission2.sc
+WAIT 10
+WAIT 20
+WAIT 30
+TERMINATE_THIS_SCRIPT
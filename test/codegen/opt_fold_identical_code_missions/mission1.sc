@@ -0,0 +1,12 @@
+MISSION_START
+VAR_INT m
+IF m = 0
+    WAIT 10
+    WAIT 20
+    WAIT 30
+    TERMINATE_THIS_SCRIPT
+ENDIF
+WAIT 10
+WAIT 20
+WAIT 30
+MISSION_END
@@ -0,0 +1,5 @@
+MISSION_START
+WAIT 10
+WAIT 20
+WAIT 30
+MISSION_END
@@ -0,0 +1,85 @@
+// RUN: %gta3sc %s --config=gtavc -finline-gosub=32 -emit-ir2 -o - | %FileCheck %s
+
+// CHECK-NEXT-L: MAIN_1:
+// CHECK-NEXT-L: ANDOR 0i8
+// CHECK-NEXT-L: IS_INT_VAR_GREATER_OR_EQUAL_TO_NUMBER &8 0i8
+// CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_4
+// CHECK-NEXT-L: WAIT 0i8
+// CHECK-NEXT-L: ADD_VAL_TO_INT_VAR &8 1i8
+// CHECK-NEXT-L: ANDOR 0i8
+// CHECK-NEXT-L: IS_INT_VAR_GREATER_THAN_NUMBER &8 10i8
+// CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_2
+// CHECK-NEXT-L: SET_VAR_INT &8 0i8
+// CHECK-NEXT-L: MAIN_2:
+// CHECK-NEXT-L: GOSUB @MAIN_5
+// CHECK-NEXT-L: ADD_VAL_TO_INT_VAR &8 1i8
+// CHECK-NEXT-L: GOSUB @MAIN_6
+// CHECK-NEXT-L: ANDOR 0i8
+// CHECK-NEXT-L: IS_INT_VAR_GREATER_THAN_NUMBER &8 10i8
+// CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_3
+// CHECK-NEXT-L: SET_VAR_INT &8 0i8
+// CHECK-NEXT-L: MAIN_3:
+// CHECK-NEXT-L: GOSUB @MAIN_7
+// CHECK-NEXT-L: GOTO @MAIN_1
+// CHECK-NEXT-L: MAIN_4:
+// CHECK-NEXT-L: TERMINATE_THIS_SCRIPT
+// CHECK-NEXT-L: MAIN_5:
+// CHECK-NEXT-L: SET_VAR_INT &12 1i8
+// CHECK-NEXT-L: SET_VAR_INT &12 2i8
+// CHECK-NEXT-L: SET_VAR_INT &12 3i8
+// CHECK-NEXT-L: SET_VAR_INT &12 4i8
+// CHECK-NEXT-L: SET_VAR_INT &12 5i8
+// CHECK-NEXT-L: RETURN
+// CHECK-NEXT-L: MAIN_6:
+// CHECK-NEXT-L: ADD_VAL_TO_INT_VAR &8 1i8
+// CHECK-NEXT-L: RETURN
+// CHECK-NEXT-L: MAIN_7:
+// CHECK-NEXT-L: TERMINATE_THIS_SCRIPT
+// CHECK-NEXT-L: SET_VAR_INT &8 2i8
+// CHECK-NEXT-L: RETURN
+VAR_INT x y
+
+WHILE x >= 0
+    WAIT 0
+    GOSUB inc_x
+    GOSUB clamp_x
+    GOSUB set_y
+    GOSUB inc_x
+    GOSUB outer
+    GOSUB clamp_x
+    GOSUB term
+ENDWHILE
+TERMINATE_THIS_SCRIPT
+
+// Inlined into every call site and removed.
+inc_x:
+x += 1
+RETURN
+
+// Each copy gets its own labels.
+clamp_x:
+IF x > 10
+    x = 0
+ENDIF
+RETURN
+
+// Too big, kept.
+set_y:
+y = 1
+y = 2
+y = 3
+y = 4
+y = 5
+RETURN
+
+// Calls another subroutine, kept.
+outer:
+GOSUB inc_x
+RETURN
+
+// Never returns, kept (and the code after it isn't copied).
+term:
+TERMINATE_THIS_SCRIPT
+after_term:
+x = 2
+RETURN
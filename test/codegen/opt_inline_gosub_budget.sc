@@ -0,0 +1,30 @@
+// RUN: %gta3sc %s --config=gtavc -finline-gosub=25 -emit-ir2 -o - | %FileCheck %s
+
+// CHECK-NEXT-L: ANDOR 0i8
+// CHECK-NEXT-L: IS_INT_VAR_GREATER_THAN_NUMBER &8 10i8
+// CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_1
+// CHECK-NEXT-L: SET_VAR_INT &8 0i8
+// CHECK-NEXT-L: MAIN_1:
+// CHECK-NEXT-L: GOSUB @MAIN_2
+// CHECK-NEXT-L: GOSUB @MAIN_2
+// CHECK-NEXT-L: TERMINATE_THIS_SCRIPT
+// CHECK-NEXT-L: MAIN_2:
+// CHECK-NEXT-L: ANDOR 0i8
+// CHECK-NEXT-L: IS_INT_VAR_GREATER_THAN_NUMBER &8 10i8
+// CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_3
+// CHECK-NEXT-L: SET_VAR_INT &8 0i8
+// CHECK-NEXT-L: MAIN_3:
+// CHECK-NEXT-L: RETURN
+VAR_INT x
+
+// Only the first call fits in the growth budget of the script.
+GOSUB clamp_x
+GOSUB clamp_x
+GOSUB clamp_x
+TERMINATE_THIS_SCRIPT
+
+clamp_x:
+IF x > 10
+    x = 0
+ENDIF
+RETURN
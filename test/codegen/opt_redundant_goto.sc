@@ -0,0 +1,32 @@
+// RUN: %gta3sc %s --config=gtavc -fswitch --guesser -fbreak-continue -fremove-redundant-goto -emit-ir2 -o - | %FileCheck %s
+
+VAR_INT x
+
+// CHECK-NEXT-L: ANDOR 0i8
+// CHECK-NEXT-L: IS_INT_VAR_EQUAL_TO_NUMBER &8 0i8
+// CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_1
+// CHECK-NEXT-L: WAIT 2i8
+// CHECK-NEXT-L: MAIN_1:
+IF x = 0
+    WAIT 2
+ELSE
+ENDIF
+
+// CHECK-NEXT-L: IS_INT_VAR_EQUAL_TO_NUMBER &8 1i8
+// CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_2
+// CHECK-NEXT-L: WAIT 1i8
+// CHECK-NEXT-L: GOTO @MAIN_3
+// CHECK-NEXT-L: MAIN_2:
+// CHECK-NEXT-L: WAIT 3i8
+// CHECK-NEXT-L: MAIN_3:
+SWITCH x
+CASE 1
+    WAIT 1
+    BREAK
+DEFAULT
+    WAIT 3
+    BREAK
+ENDSWITCH
+
+// CHECK-NEXT-L: TERMINATE_THIS_SCRIPT
+TERMINATE_THIS_SCRIPT
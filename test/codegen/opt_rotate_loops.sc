@@ -0,0 +1,60 @@
+// RUN: %gta3sc %s --config=gtavc -fbreak-continue -frotate-loops -emit-ir2 -o - | %FileCheck %s
+
+VAR_INT x y
+
+// CHECK-NEXT-L: GOTO @MAIN_4
+// CHECK-NEXT-L: MAIN_1:
+// CHECK-NEXT-L: ANDOR 0i8
+// CHECK-NEXT-L: IS_INT_VAR_EQUAL_TO_NUMBER &12 1i8
+// CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_2
+// CHECK-NEXT-L: GOTO @MAIN_4
+// CHECK-NEXT-L: MAIN_2:
+// CHECK-NEXT-L: ANDOR 0i8
+// CHECK-NEXT-L: IS_INT_VAR_EQUAL_TO_NUMBER &12 2i8
+// CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_3
+// CHECK-NEXT-L: GOTO @MAIN_5
+// CHECK-NEXT-L: MAIN_3:
+// CHECK-NEXT-L: WAIT 1i8
+// CHECK-NEXT-L: MAIN_4:
+// CHECK-NEXT-L: ANDOR 0i8
+// CHECK-NEXT-L: NOT IS_INT_VAR_GREATER_THAN_NUMBER &8 0i8
+// CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_1
+// CHECK-NEXT-L: MAIN_5:
+WHILE x > 0
+    IF y = 1
+        CONTINUE
+    ENDIF
+    IF y = 2
+        BREAK
+    ENDIF
+    WAIT 1
+ENDWHILE
+
+// CHECK-NEXT-L: GOTO @MAIN_7
+// CHECK-NEXT-L: MAIN_6:
+// CHECK-NEXT-L: WAIT 0i8
+// CHECK-NEXT-L: MAIN_7:
+// CHECK-NEXT-L: ANDOR 21i8
+// CHECK-NEXT-L: NOT IS_INT_VAR_GREATER_THAN_NUMBER &8 0i8
+// CHECK-NEXT-L: IS_INT_VAR_EQUAL_TO_NUMBER &12 1i8
+// CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_6
+WHILE x > 0
+AND NOT y = 1
+    WAIT 0
+ENDWHILE
+
+// CHECK-NEXT-L: GOTO @MAIN_9
+// CHECK-NEXT-L: MAIN_8:
+// CHECK-NEXT-L: WAIT 0i8
+// CHECK-NEXT-L: MAIN_9:
+// CHECK-NEXT-L: ANDOR 1i8
+// CHECK-NEXT-L: NOT IS_INT_VAR_EQUAL_TO_NUMBER &8 1i8
+// CHECK-NEXT-L: NOT IS_INT_VAR_GREATER_THAN_INT_VAR &8 &12
+// CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_8
+WHILE x = 1
+OR y < x
+    WAIT 0
+ENDWHILE
+
+// CHECK-NEXT-L: TERMINATE_THIS_SCRIPT
+TERMINATE_THIS_SCRIPT
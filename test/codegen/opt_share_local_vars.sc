@@ -0,0 +1,52 @@
+// RUN: %gta3sc %s --config=gtavc --guesser -farrays -fshare-local-vars -emit-ir2 -o - | %FileCheck %s
+
+// CHECK-NEXT-L: START_NEW_SCRIPT @MAIN_1 10i8 20i8
+// CHECK-NEXT-L: TERMINATE_THIS_SCRIPT
+START_NEW_SCRIPT worker 10 20
+TERMINATE_THIS_SCRIPT
+
+{
+worker:
+    LVAR_INT p q arr[2] r s t
+    LVAR_FLOAT f
+
+    // The parameters keep their indices, arrays stay in place, and r reuses the index of p.
+    // CHECK-NEXT-L: MAIN_1:
+    // CHECK-NEXT-L: WAIT 0@
+    // CHECK-NEXT-L: SET_LVAR_INT_TO_LVAR_INT 0@ 1@
+    // CHECK-NEXT-L: ADD_VAL_TO_INT_LVAR 0@ 1i8
+    // CHECK-NEXT-L: SET_LVAR_INT_TO_LVAR_INT 2@ 0@
+    WAIT p
+    r = q + 1
+    arr[0] = r
+
+    // r is alive during the whole loop, so s can't share its index.
+    // CHECK-NEXT-L: MAIN_2:
+    // CHECK-NEXT-L: ANDOR 0i8
+    // CHECK-NEXT-L: IS_INT_LVAR_GREATER_THAN_NUMBER 0@ 0i8
+    // CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_3
+    // CHECK-NEXT-L: SET_LVAR_INT_TO_LVAR_INT 1@ 0@
+    // CHECK-NEXT-L: MULT_INT_LVAR_BY_VAL 1@ 2i8
+    // CHECK-NEXT-L: WAIT 1@
+    // CHECK-NEXT-L: SUB_VAL_FROM_INT_LVAR 0@ 1i8
+    // CHECK-NEXT-L: GOTO @MAIN_2
+    WHILE r > 0
+        s = r * 2
+        WAIT s
+        r -= 1
+    ENDWHILE
+
+    // CHECK-NEXT-L: MAIN_3:
+    // CHECK-NEXT-L: SET_LVAR_FLOAT 0@ 0x1.000000p+0f
+    // CHECK-NEXT-L: SET_TIME_SCALE 0@
+    f = 1.0
+    SET_TIME_SCALE f
+
+    // t is read before ever being written, so it keeps its index.
+    // CHECK-NEXT-L: WAIT 6@
+    // CHECK-NEXT-L: WAIT 2@
+    WAIT t
+    WAIT arr[0]
+}
+// CHECK-NEXT-L: TERMINATE_THIS_SCRIPT
+TERMINATE_THIS_SCRIPT
@@ -0,0 +1,78 @@
+// RUN: %gta3sc %s --config=gtavc -fshort-circuit -emit-ir2 -o - | %FileCheck %s
+
+// CHECK-NEXT-L: CREATE_PLAYER 0i8 0x0.000000p+0f 0x0.000000p+0f 0x0.000000p+0f &16
+// CHECK-NEXT-L: ANDOR 0i8
+// CHECK-NEXT-L: IS_INT_VAR_EQUAL_TO_NUMBER &8 1i8
+// CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_1
+// CHECK-NEXT-L: ANDOR 0i8
+// CHECK-NEXT-L: IS_INT_VAR_GREATER_THAN_NUMBER &12 2i8
+// CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_1
+// CHECK-NEXT-L: ANDOR 0i8
+// CHECK-NEXT-L: IS_PLAYER_PLAYING &16
+// CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_1
+// CHECK-NEXT-L: WAIT 0i8
+// CHECK-NEXT-L: MAIN_1:
+// CHECK-NEXT-L: ANDOR 0i8
+// CHECK-NEXT-L: NOT IS_INT_VAR_EQUAL_TO_NUMBER &8 2i8
+// CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_2
+// CHECK-NEXT-L: ANDOR 0i8
+// CHECK-NEXT-L: IS_PLAYER_PLAYING &16
+// CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_3
+// CHECK-NEXT-L: MAIN_2:
+// CHECK-NEXT-L: WAIT 1i8
+// CHECK-NEXT-L: MAIN_3:
+// CHECK-NEXT-L: ANDOR 0i8
+// CHECK-NEXT-L: IS_INT_VAR_EQUAL_TO_NUMBER &8 3i8
+// CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_4
+// CHECK-NEXT-L: ANDOR 0i8
+// CHECK-NEXT-L: NOT IS_PLAYER_PLAYING &16
+// CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_4
+// CHECK-NEXT-L: WAIT 2i8
+// CHECK-NEXT-L: GOTO @MAIN_3
+// CHECK-NEXT-L: MAIN_4:
+// CHECK-NEXT-L: ANDOR 1i8
+// CHECK-NEXT-L: IS_INT_VAR_EQUAL_TO_NUMBER &8 1i8
+// CHECK-NEXT-L: IS_INT_VAR_EQUAL_TO_NUMBER &12 2i8
+// CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_5
+// CHECK-NEXT-L: WAIT 3i8
+// CHECK-NEXT-L: MAIN_5:
+// CHECK-NEXT-L: ANDOR 1i8
+// CHECK-NEXT-L: IS_INT_VAR_EQUAL_TO_NUMBER &8 1i8
+// CHECK-NEXT-L: LOCATE_PLAYER_ANY_MEANS_2D &16 0x0.000000p+0f 0x0.000000p+0f 0x1.000000p+0f 0x1.000000p+0f 1i8
+// CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_6
+// CHECK-NEXT-L: WAIT 4i8
+// CHECK-NEXT-L: MAIN_6:
+// CHECK-NEXT-L: TERMINATE_THIS_SCRIPT
+VAR_INT x y player
+CREATE_PLAYER 0 0.0 0.0 0.0 player
+
+// Cheap variable tests are moved before the command, which is skipped once the outcome is known.
+IF IS_PLAYER_PLAYING player
+AND x = 1
+AND y > 2
+    WAIT 0
+ENDIF
+
+IF IS_PLAYER_PLAYING player
+OR x = 2
+    WAIT 1
+ENDIF
+
+WHILE NOT IS_PLAYER_PLAYING player
+AND x = 3
+    WAIT 2
+ENDWHILE
+
+// Nothing to skip.
+IF x = 1
+AND y = 2
+    WAIT 3
+ENDIF
+
+// May have side effects.
+IF x = 1
+AND LOCATE_PLAYER_ANY_MEANS_2D player 0.0 0.0 1.0 1.0 TRUE
+    WAIT 4
+ENDIF
+
+TERMINATE_THIS_SCRIPT
@@ -0,0 +1,84 @@
+// RUN: %gta3sc %s --config=gtavc --guesser -fswitch -fswitch-tree -moptimize-andor -emit-ir2 -o - | %FileCheck %s
+
+VAR_INT x
+
+// CHECK-NEXT-L: IS_INT_VAR_GREATER_THAN_NUMBER &8 30i8
+// CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_1
+// CHECK-NEXT-L: NOT IS_INT_VAR_EQUAL_TO_NUMBER &8 40i8
+// CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_2
+// CHECK-NEXT-L: NOT IS_INT_VAR_EQUAL_TO_NUMBER &8 50i8
+// CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_5
+// CHECK-NEXT-L: NOT IS_INT_VAR_EQUAL_TO_NUMBER &8 60i8
+// CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_6
+// CHECK-NEXT-L: GOTO @MAIN_7
+// CHECK-NEXT-L: MAIN_1:
+// CHECK-NEXT-L: NOT IS_INT_VAR_EQUAL_TO_NUMBER &8 10i8
+// CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_3
+// CHECK-NEXT-L: NOT IS_INT_VAR_EQUAL_TO_NUMBER &8 20i8
+// CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_4
+// CHECK-NEXT-L: NOT IS_INT_VAR_EQUAL_TO_NUMBER &8 30i8
+// CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_4
+// CHECK-NEXT-L: GOTO @MAIN_7
+// CHECK-NEXT-L: MAIN_2:
+// CHECK-NEXT-L: WAIT 40i8
+// CHECK-NEXT-L: GOTO @MAIN_8
+// CHECK-NEXT-L: MAIN_3:
+// CHECK-NEXT-L: WAIT 10i8
+// CHECK-NEXT-L: GOTO @MAIN_8
+// CHECK-NEXT-L: MAIN_4:
+// CHECK-NEXT-L: WAIT 20i8
+// CHECK-NEXT-L: GOTO @MAIN_8
+// CHECK-NEXT-L: MAIN_5:
+// CHECK-NEXT-L: WAIT 50i8
+// CHECK-NEXT-L: GOTO @MAIN_8
+// CHECK-NEXT-L: MAIN_6:
+// CHECK-NEXT-L: WAIT 60i8
+// CHECK-NEXT-L: GOTO @MAIN_8
+// CHECK-NEXT-L: MAIN_7:
+// CHECK-NEXT-L: WAIT 0i8
+// CHECK-NEXT-L: GOTO @MAIN_8
+// CHECK-NEXT-L: MAIN_8:
+SWITCH x
+CASE 40
+    WAIT 40
+    BREAK
+CASE 10
+    WAIT 10
+    BREAK
+CASE 30
+CASE 20
+    WAIT 20
+    BREAK
+CASE 50
+    WAIT 50
+    BREAK
+CASE 60
+    WAIT 60
+    BREAK
+DEFAULT
+    WAIT 0
+    BREAK
+ENDSWITCH
+
+// Too few cases for a decision tree.
+// CHECK-NEXT-L: IS_INT_VAR_EQUAL_TO_NUMBER &8 1i8
+// CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_9
+// CHECK-NEXT-L: WAIT 1i8
+// CHECK-NEXT-L: GOTO @MAIN_10
+// CHECK-NEXT-L: MAIN_9:
+// CHECK-NEXT-L: IS_INT_VAR_EQUAL_TO_NUMBER &8 2i8
+// CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_10
+// CHECK-NEXT-L: WAIT 2i8
+// CHECK-NEXT-L: GOTO @MAIN_10
+// CHECK-NEXT-L: MAIN_10:
+SWITCH x
+CASE 1
+    WAIT 1
+    BREAK
+CASE 2
+    WAIT 2
+    BREAK
+ENDSWITCH
+
+// CHECK-NEXT-L: TERMINATE_THIS_SCRIPT
+TERMINATE_THIS_SCRIPT
@@ -0,0 +1,20 @@
+// RUN: %dis %gta3sc %s --config=gta3 -fswitch --guesser -fswitch-tree -emit-ir2 -o - 2>&1 | %verify %s
+// RUN: %dis %gta3sc %s --config=gtavc -fswitch --guesser -O2 -emit-ir2 -o - 2>&1 | %verify %s
+// The decision tree accepts the same SWITCHes as the if-chain (see switch_3vc_fail.sc).
+VAR_INT n
+
+SWITCH n // expected-error {{more than 8 cases}}
+	CASE 1
+	CASE 2
+	CASE 3
+	CASE 4
+	CASE 5
+	CASE 6
+	CASE 7
+	CASE 8
+	CASE 9
+		WAIT 1
+		BREAK
+ENDSWITCH
+
+TERMINATE_THIS_SCRIPT
@@ -0,0 +1,94 @@
+// RUN: %gta3sc %s --config=gta3 -fthread-jumps -emit-ir2 -o - | %FileCheck %s
+// RUN: %gta3sc %s --config=gta3 -fthread-jumps -mlocal-offsets -emit-ir2 -o - | %FileCheck %s --check-prefix=LOCAL
+
+VAR_INT x y
+
+// CHECK-NEXT-L: MAIN_1:
+// CHECK-NEXT-L: ANDOR 0i8
+// CHECK-NEXT-L: IS_INT_VAR_GREATER_THAN_NUMBER &8 0i8
+// CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_3
+// CHECK-NEXT-L: ANDOR 0i8
+// CHECK-NEXT-L: IS_INT_VAR_EQUAL_TO_NUMBER &12 1i8
+// CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_2
+// CHECK-NEXT-L: WAIT 1i8
+// CHECK-NEXT-L: GOTO @MAIN_1
+// CHECK-NEXT-L: MAIN_2:
+// CHECK-NEXT-L: WAIT 2i8
+// CHECK-NEXT-L: GOTO @MAIN_1
+// CHECK-NEXT-L: MAIN_3:
+WHILE x > 0
+    IF y = 1
+        WAIT 1
+    ELSE
+        WAIT 2
+    ENDIF
+ENDWHILE
+
+// CHECK-NEXT-L: GOSUB @MAIN_4
+// CHECK-NEXT-L: TERMINATE_THIS_SCRIPT
+GOSUB sub
+GOTO fin
+
+// CHECK-NEXT-L: MAIN_4:
+// CHECK-NEXT-L: ANDOR 0i8
+// CHECK-NEXT-L: IS_INT_VAR_EQUAL_TO_NUMBER &8 2i8
+// CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_5
+// CHECK-NEXT-L: WAIT 3i8
+// CHECK-NEXT-L: MAIN_5:
+// CHECK-NEXT-L: RETURN
+sub:
+IF x = 2
+    WAIT 3
+ENDIF
+RETURN
+
+// CHECK-NEXT-L: TERMINATE_THIS_SCRIPT
+// CHECK-NEXT-L: TERMINATE_THIS_SCRIPT
+fin:
+GOTO ender
+ender:
+TERMINATE_THIS_SCRIPT
+
+// The targets of GOSUB_FILE and START_NEW_SCRIPT are never threaded, even if they begin with a GOTO.
+// Chains are followed across the files of the same block, but never out of it [-mlocal-offsets].
+// CHECK-NEXT-L: GOSUB_FILE @MAIN_6 @MAIN_6
+// CHECK-NEXT-L: START_NEW_SCRIPT @MAIN_7
+// CHECK-NEXT-L: LOAD_AND_LAUNCH_MISSION_INTERNAL 0i8
+// CHECK-NEXT-L: MAIN_6:
+// CHECK-NEXT-L: GOTO @MAIN_8
+// CHECK-NEXT-L: MAIN_7:
+// CHECK-NEXT-L: GOTO @MAIN_8
+// CHECK-NEXT-L: MAIN_8:
+// CHECK-NEXT-L: ANDOR 0i8
+// CHECK-NEXT-L: IS_INT_VAR_EQUAL_TO_NUMBER &8 3i8
+// CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_9
+// CHECK-NEXT-L: GOTO @MAIN_8
+// CHECK-NEXT-L: MAIN_9:
+// CHECK-NEXT-L: RETURN
+// CHECK-NEXT-L: GOTO @MAIN_8
+// CHECK-NEXT-L: #MISSION_BLOCK_START 0
+// CHECK-NEXT-L: SCRIPT_NAME 'TMISS'
+// CHECK-NEXT-L: MISSION_0_1:
+// CHECK-NEXT-L: ANDOR 0i8
+// CHECK-NEXT-L: IS_INT_VAR_EQUAL_TO_NUMBER &12 4i8
+// CHECK-NEXT-L: GOTO_IF_FALSE %MISSION_0_2
+// CHECK-NEXT-L: GOTO %MISSION_0_1
+// CHECK-NEXT-L: MISSION_0_2:
+// CHECK-NEXT-L: GOSUB %MISSION_0_3
+// CHECK-NEXT-L: GOTO %MISSION_0_1
+
+// LOCAL-L: GOSUB_FILE %MAIN_6 %MAIN_6
+// LOCAL-NEXT-L: START_NEW_SCRIPT %MAIN_7
+// LOCAL-NEXT-L: LOAD_AND_LAUNCH_MISSION_INTERNAL 0i8
+// LOCAL-NEXT-L: MAIN_6:
+// LOCAL-NEXT-L: GOTO %MAIN_8
+// LOCAL-NEXT-L: MAIN_7:
+// LOCAL-NEXT-L: GOTO %MAIN_8
+// LOCAL-L: GOTO_IF_FALSE %MAIN_9
+// LOCAL-NEXT-L: GOTO %MAIN_8
+// LOCAL-L: #MISSION_BLOCK_START 0
+// LOCAL-L: GOTO_IF_FALSE %MISSION_0_2
+// LOCAL-NEXT-L: GOTO %MISSION_0_1
+GOSUB_FILE ext_entry thread_ext.sc
+START_NEW_SCRIPT ext_script
+LOAD_AND_LAUNCH_MISSION thread_miss.sc
@@ -0,0 +1,13 @@
+ext_entry:
+GOTO ext_body
+ext_script:
+{
+GOTO ext_body
+}
+ext_body:
+IF x = 3
+    GOTO ext_hop
+ENDIF
+RETURN
+ext_hop:
+GOTO ext_body
@@ -0,0 +1,12 @@
+MISSION_START
+REQUIRE thread_req.sc
+SCRIPT_NAME tmiss
+miss_loop:
+IF y = 4
+    GOTO miss_hop
+ENDIF
+GOSUB req_entry
+GOTO miss_loop
+miss_hop:
+GOTO req_hop
+MISSION_END
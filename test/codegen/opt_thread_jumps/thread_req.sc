@@ -0,0 +1,4 @@
+req_entry:
+RETURN
+req_hop:
+GOTO miss_loop
@@ -0,0 +1,33 @@
+// RUN: %gta3sc %s --config=gta3 -fremove-unreachable-code -Wno-unreachable-code -emit-ir2 -o - | %FileCheck %s
+
+VAR_INT x
+
+// CHECK-NEXT-L: GOSUB @MAIN_2
+// CHECK-NEXT-L: GOTO @MAIN_1
+// CHECK-NEXT-L: MAIN_1:
+GOSUB used
+GOTO skip
+WAIT 1
+skip:
+
+// CHECK-NEXT-L: GOSUB_FILE @MAIN_3 @MAIN_3
+// CHECK-NEXT-L: TERMINATE_THIS_SCRIPT
+GOSUB_FILE sub sub.sc
+TERMINATE_THIS_SCRIPT
+WAIT 2
+
+// CHECK-NEXT-L: MAIN_2:
+// CHECK-NEXT-L: WAIT 3i8
+// CHECK-NEXT-L: RETURN
+used:
+WAIT 3
+RETURN
+
+unused:
+WAIT 4
+GOSUB used
+RETURN
+
+// CHECK-NEXT-L: MAIN_3:
+// CHECK-NEXT-L: PRINT_HELP 'SUB'
+// CHECK-NEXT-L: RETURN
@@ -0,0 +1,8 @@
+sub:
+PRINT_HELP SUB
+RETURN
+PRINT_HELP DEAD
+
+unused_sub:
+PRINT_HELP DEAD
+RETURN
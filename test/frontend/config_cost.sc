@@ -0,0 +1,4 @@
+// Tests the range of the Cost attribute of commands.
+// RUN: %not %gta3sc %s --config=gta3 -fsyntax-only --add-config=./Inputs/bad_cost.xml 2>&1 | grep "must be between 0 and 255"
+
+TERMINATE_THIS_SCRIPT
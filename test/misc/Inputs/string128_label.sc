@@ -0,0 +1,7 @@
+SCRIPT_START
+NOP
+TEST_STRING128_LABEL "hello" target
+WAIT 0
+target:
+TERMINATE_THIS_CUSTOM_SCRIPT
+SCRIPT_END
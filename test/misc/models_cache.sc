@@ -0,0 +1,36 @@
+// RUN: rm -rf "%/T/models" && mkdir "%/T/models"
+// RUN: cp -R "%/S/../semantics/Inputs/data" "%/T/models/data"
+//
+// Builds the cache.
+// RUN: %gta3sc %s --config=gtasa --guesser --datadir="%/T/models/data" --models-cache="%/T/models/cache.txt" -emit-ir2 -o - | %FileCheck %s
+// RUN: cat "%/T/models/cache.txt" | %FileCheck %s --check-prefix=CACHE
+//
+// Reuses the cache, which is seen by changing a model in it.
+// RUN: sed "s/D 402 BANSHEE/D 403 BANSHEE/" "%/T/models/cache.txt" > "%/T/models/cache.tmp"
+// RUN: mv "%/T/models/cache.tmp" "%/T/models/cache.txt"
+// RUN: %gta3sc %s --config=gtasa --guesser --datadir="%/T/models/data" --models-cache="%/T/models/cache.txt" -emit-ir2 -o - | %FileCheck %s --check-prefix=REUSE
+//
+// Rebuilds the cache when a IDE file changes size.
+// RUN: sed "s/402, BANSHEE,/402, BANSHEE, ./" "%/T/models/data/default.ide" > "%/T/models/default.tmp"
+// RUN: mv "%/T/models/default.tmp" "%/T/models/data/default.ide"
+// RUN: %gta3sc %s --config=gtasa --guesser --datadir="%/T/models/data" --models-cache="%/T/models/cache.txt" -emit-ir2 -o - | %FileCheck %s
+//
+// Rebuilds the cache when a IDE file changes modification time.
+// RUN: sed "s/D 402 BANSHEE/D 403 BANSHEE/" "%/T/models/cache.txt" > "%/T/models/cache.tmp"
+// RUN: mv "%/T/models/cache.tmp" "%/T/models/cache.txt"
+// RUN: touch -t 200101010000 "%/T/models/data/default.ide"
+// RUN: %gta3sc %s --config=gtasa --guesser --datadir="%/T/models/data" --models-cache="%/T/models/cache.txt" -emit-ir2 -o - | %FileCheck %s
+
+// CACHE-NEXT-L: GTA3SC-MODELS 1
+// CACHE-L: default.dat
+// CACHE-L: default.ide
+// CACHE-L: gta.dat
+// CACHE-L: level.ide
+// CACHE-L: D 402 BANSHEE
+// CACHE-L: L 1002 lv_stuff
+
+// REUSE-L: REQUEST_MODEL 403i16
+
+// CHECK-L: REQUEST_MODEL 402i16
+REQUEST_MODEL BANSHEE
+TERMINATE_THIS_SCRIPT
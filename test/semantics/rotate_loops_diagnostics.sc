@@ -0,0 +1,12 @@
+// RUN: %dis %gta3sc %s --config=gtasa --guesser -fsyntax-only -frotate-loops 2>&1 | %verify %s
+// The conditions of a rotated loop are compiled once.
+
+VAR_INT int x
+VAR_TEXT_LABEL text8
+
+WHILE x = 0
+AND text8 = INT	// expected-warning {{text label collides with some variable name}}
+    WAIT 0
+ENDWHILE
+
+TERMINATE_THIS_SCRIPT
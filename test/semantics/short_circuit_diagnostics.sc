@@ -0,0 +1,18 @@
+// RUN: %dis %gta3sc %s --config=gtasa --guesser -fsyntax-only -fshort-circuit 2>&1 | %verify %s
+// Conditions are compiled once, whether or not the list gets split.
+
+VAR_INT int x
+VAR_TEXT_LABEL text8
+
+IF x = 0
+AND text8 = INT	// expected-warning {{text label collides with some variable name}}
+    WAIT 0
+ENDIF
+
+IF x = 0
+AND IS_BUTTON_PRESSED 0 16
+AND text8 = INT	// expected-warning {{text label collides with some variable name}}
+    WAIT 0
+ENDIF
+
+TERMINATE_THIS_SCRIPT
@@ -0,0 +1,30 @@
+// RUN: %dis %gta3sc %s --config=gta3 -fremove-unreachable-code -Wno-expect-var -o "%/T/warn_unreachable_code.scm" 2>&1 | %verify %s
+// RUN: %gta3sc %s --config=gta3 -fremove-unreachable-code -Wno-unreachable-code -Wno-expect-var -Werror -o "%/T/warn_unreachable_code.scm"
+
+VAR_INT x
+
+GOSUB used
+GOTO skip
+WAIT 1      // expected-warning {{code will never be executed}}
+x = 2
+skip:
+
+// No warning for the GOTO generated after the first branch.
+IF x = 1
+    GOTO fin
+ELSE
+    GOTO fin
+ENDIF
+
+fin:
+TERMINATE_THIS_SCRIPT
+WAIT 2      // expected-warning {{code will never be executed}}
+
+used:
+WAIT 3
+RETURN
+
+unused:
+x = 4       // expected-warning {{code will never be executed}}
+GOSUB used
+RETURN
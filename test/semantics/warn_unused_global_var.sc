@@ -0,0 +1,17 @@
+// RUN: %dis %gta3sc %s --config=gta3 -Wunused-global-var -o "%/T/warn_unused_global_var.scm" 2>&1 | %verify %s
+// RUN: %gta3sc %s --config=gta3 -Werror -o "%/T/warn_unused_global_var.scm"
+
+VAR_INT used
+VAR_INT unused          // expected-warning {{global variable unused is never used}}
+VAR_INT assigned        // expected-warning {{global variable assigned is never read}}
+VAR_INT output          // expected-warning {{global variable output is never read}}
+VAR_INT incremented
+VAR_FLOAT copy          // expected-warning {{global variable copy is never read}}
+VAR_FLOAT source
+
+assigned = 1
+GENERATE_RANDOM_INT_IN_RANGE 0 10 output
+incremented += 1
+copy = source
+WAIT used
+TERMINATE_THIS_SCRIPT
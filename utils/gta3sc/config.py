@@ -66,6 +66,8 @@ class Command:
         self.supported = False
         self.internal = False
         self.extension = False
+        self.pure = False
+        self.cost = 1
         self.args = []
 
     def __eq__(self, other):
@@ -101,6 +103,8 @@ class Command:
         init.supported = _str2bool(node.get("Supported", "true"))
         init.internal = _str2bool(node.get("Internal", "false"))
         init.extension = _str2bool(node.get("Extension", "false"))
+        init.pure = _str2bool(node.get("Pure", "false"))
+        init.cost = int(node.get("Cost", "1"), 0)
         init.args = []
         node_args = node.find("Args")
         if node_args is not None:
@@ -121,6 +125,10 @@ class Command:
             node.set("Internal", _bool2str(self.internal))
         if self.extension == True:
             node.set("Extension", _bool2str(self.extension))
+        if self.pure == True:
+            node.set("Pure", _bool2str(self.pure))
+        if self.cost != 1:
+            node.set("Cost", str(self.cost))
         if len(self.args) > 0:
             node_args = etree.SubElement(node, "Args")
             for a in self.args: